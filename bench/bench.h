@@ -0,0 +1,149 @@
+/*  bench.h - A minimal header-only microbenchmark harness.
+
+    Benchmarks register themselves with a name and a function. The function does
+    its setup and then hands the operation to measure to Run::loop, which doubles
+    the number of iterations until a sample takes long enough to time reliably,
+    then takes a number of samples of that many iterations. Results are reported
+    as nanoseconds per operation (minimum, median, mean and standard deviation
+    over the samples).
+
+    This file has no dependencies besides the standard library and may be copied
+    as is.
+*/
+
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/** Keeps the compiler from optimizing away a value that is computed but not used */
+template<typename T>
+inline void doNotOptimizeAway(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/** Settings for a benchmark run */
+struct Config {
+    // Minimum time a single sample should take
+    std::chrono::nanoseconds minSampleTime = std::chrono::milliseconds(10);
+
+    // Number of samples taken per benchmark
+    size_t samples = 11;
+};
+
+/** The measurements of a single benchmark */
+struct Result {
+    std::string name;
+
+    // Number of iterations per sample
+    uint64_t iterations = 0;
+
+    // Nanoseconds per operation of each sample
+    std::vector<double> samples;
+    double minNs = 0;
+    double medianNs = 0;
+    double meanNs = 0;
+    double stddevNs = 0;
+
+    // Bytes and items processed per operation, 0 if not set
+    double bytesPerOp = 0;
+    double itemsPerOp = 0;
+};
+
+/** Passed to a benchmark function to measure its operation */
+class Run {
+public:
+    Run(const Config& config, Result& result) : config(config), result(result) {}
+
+    /** Sets the bytes processed by one operation, to report throughput */
+    void setBytesPerOp(double bytes) { result.bytesPerOp = bytes; }
+
+    /** Sets the items processed by one operation, to report the time per item */
+    void setItemsPerOp(double items) { result.itemsPerOp = items; }
+
+    /** Measures op, which is called with the iteration number */
+    template<typename Op>
+    void loop(Op op) {
+        uint64_t iterations = 1;
+        for(;;) {
+            std::chrono::nanoseconds elapsed = time(op, iterations);
+            if(elapsed >= config.minSampleTime || iterations >= (UINT64_C(1) << 40)) break;
+            iterations *= 2;
+        }
+
+        result.iterations = iterations;
+        result.samples.clear();
+        for(size_t i = 0; i < std::max<size_t>(config.samples, 1); i++) {
+            result.samples.push_back((double)time(op, iterations).count() / iterations);
+        }
+
+        std::vector<double> sorted(result.samples);
+        std::sort(sorted.begin(), sorted.end());
+        result.minNs = sorted.front();
+        result.medianNs = sorted.size() % 2 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+        double sum = 0;
+        for(double sample : sorted) sum += sample;
+        result.meanNs = sum / sorted.size();
+        double variance = 0;
+        for(double sample : sorted) variance += (sample - result.meanNs) * (sample - result.meanNs);
+        result.stddevNs = sorted.size() > 1 ? std::sqrt(variance / (sorted.size() - 1)) : 0;
+    }
+
+private:
+    template<typename Op>
+    static std::chrono::nanoseconds time(Op& op, uint64_t iterations) {
+        auto start = std::chrono::steady_clock::now();
+        for(uint64_t i = 0; i < iterations; i++) {
+            op(i);
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    const Config& config;
+    Result& result;
+};
+
+/** A registered benchmark */
+struct Benchmark {
+    std::string name;
+    std::function<void(Run&)> function;
+};
+
+/** All benchmarks registered in the program, in registration order */
+inline std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+/** Registers a benchmark when constructed, meant for static objects */
+struct Registrar {
+    Registrar(const std::string& name, std::function<void(Run&)> function) {
+        registry().push_back({ name, function });
+    }
+};
+
+/** Runs a single benchmark */
+inline Result run(const Benchmark& benchmark, const Config& config) {
+    Result result;
+    result.name = benchmark.name;
+    Run run(config, result);
+    benchmark.function(run);
+    return result;
+}
+
+}
+
+#endif // BENCH_H_INCLUDED
@@ -0,0 +1,46 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bench.h"
+#include "fixtures.h"
+
+using namespace std;
+
+namespace
+{
+    // One benchmark per built-in transaction. The transactions are built when the
+    // benchmark runs, not during static initialization.
+    bench::Registrar readTransaction(const string& name) {
+        return bench::Registrar("blockreader/readTransaction/" + name, [name](bench::Run& run) {
+            for(const fixtures::Transaction& transaction : fixtures::transactions()) {
+                if(transaction.name == name) {
+                    fixtures::readTransactions({ transaction.raw })(run);
+                }
+            }
+        });
+    }
+
+    bench::Registrar genesisCoinbase = readTransaction("genesisCoinbase");
+    bench::Registrar pubKeyHash = readTransaction("p2pkh1in2out");
+    bench::Registrar witnessPubKeyHash = readTransaction("p2wpkh2in2out");
+    bench::Registrar coinbaseSegwit = readTransaction("coinbaseSegwit");
+    bench::Registrar consolidation = readTransaction("consolidation50in1out");
+    bench::Registrar batchPayout = readTransaction("batchPayout1in100out");
+}
@@ -0,0 +1,79 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+#include <random>
+#include "bench.h"
+#include "../src/filereader.h"
+#include "../src/byte_array_buffer.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t valueCount = 1024;
+
+    // Appends value as a varint of the given size (1, 3, 5 or 9 bytes)
+    void writeVarInt(vector<unsigned char>& out, uint64_t value, int size) {
+        if(size == 3) out.push_back(0xfd);
+        if(size == 5) out.push_back(0xfe);
+        if(size == 9) out.push_back(0xff);
+        for(int i = 0; i < (size == 1 ? 1 : size - 1); i++) out.push_back((value >> (8 * i)) & 0xff);
+    }
+
+    bench::Registrar readVarInt("filereader/readVarInt", [](bench::Run& run) {
+        // Mostly single byte varints (counts, script lengths), some larger ones
+        mt19937 rng(1);
+        vector<unsigned char> buffer;
+        for(size_t i = 0; i < valueCount; i++) {
+            uint32_t kind = rng() % 16;
+            writeVarInt(buffer, rng() % 0xfc, kind < 13 ? 1 : (kind < 15 ? 3 : (kind < 16 ? 5 : 9)));
+        }
+        run.setItemsPerOp(valueCount);
+        run.setBytesPerOp(buffer.size());
+        run.loop([&](uint64_t) {
+            byte_array_buffer streambuf(buffer.data(), buffer.size());
+            istream stream(&streambuf);
+            for(size_t i = 0; i < valueCount; i++) {
+                bench::doNotOptimizeAway(VtcBlockIndexer::FileReader::readVarInt(stream));
+            }
+        });
+    });
+
+    bench::Registrar readString("filereader/readString", [](bench::Run& run) {
+        // Output script sized strings
+        mt19937 rng(2);
+        vector<unsigned char> buffer;
+        for(size_t i = 0; i < valueCount; i++) {
+            size_t size = 22 + rng() % 48;
+            writeVarInt(buffer, size, 1);
+            for(size_t j = 0; j < size; j++) buffer.push_back(rng());
+        }
+        run.setItemsPerOp(valueCount);
+        run.setBytesPerOp(buffer.size());
+        run.loop([&](uint64_t) {
+            byte_array_buffer streambuf(buffer.data(), buffer.size());
+            istream stream(&streambuf);
+            for(size_t i = 0; i < valueCount; i++) {
+                bench::doNotOptimizeAway(VtcBlockIndexer::FileReader::readString(stream));
+            }
+        });
+    });
+}
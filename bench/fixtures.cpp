@@ -0,0 +1,315 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fixtures.h"
+#include <fstream>
+#include <random>
+#include "../src/json.hpp"
+#include "../src/utility.h"
+#include "../src/blockreader.h"
+#include "../src/byte_array_buffer.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace
+{
+    // Serializes transactions the way they are stored in the block files
+    class TransactionBuilder {
+    public:
+        TransactionBuilder(uint32_t seed) : rng(seed) {}
+
+        void uint32(uint32_t value) {
+            for(int i = 0; i < 4; i++) raw.push_back((value >> (8 * i)) & 0xff);
+        }
+
+        void uint64(uint64_t value) {
+            for(int i = 0; i < 8; i++) raw.push_back((value >> (8 * i)) & 0xff);
+        }
+
+        void varInt(uint64_t value) {
+            if(value < 0xfd) {
+                raw.push_back(value);
+            } else if(value <= 0xffff) {
+                raw.push_back(0xfd);
+                raw.push_back(value & 0xff);
+                raw.push_back(value >> 8);
+            } else {
+                raw.push_back(0xfe);
+                uint32(value);
+            }
+        }
+
+        void bytes(const vector<unsigned char>& value) {
+            raw.insert(raw.end(), value.begin(), value.end());
+        }
+
+        void varBytes(const vector<unsigned char>& value) {
+            varInt(value.size());
+            bytes(value);
+        }
+
+        vector<unsigned char> random(size_t size) {
+            vector<unsigned char> value(size);
+            for(auto& b : value) b = rng();
+            return value;
+        }
+
+        // An input spending a random outpoint with the given scriptSig
+        void input(const vector<unsigned char>& scriptSig) {
+            bytes(random(32));
+            uint32(rng() % 4);
+            varBytes(scriptSig);
+            uint32(0xffffffff);
+        }
+
+        void output(uint64_t value, const vector<unsigned char>& script) {
+            uint64(value);
+            varBytes(script);
+        }
+
+        // A P2PKH scriptSig: <signature> <compressed public key>
+        vector<unsigned char> pubKeyHashScriptSig() {
+            vector<unsigned char> scriptSig;
+            scriptSig.push_back(72);
+            vector<unsigned char> signature = random(72);
+            scriptSig.insert(scriptSig.end(), signature.begin(), signature.end());
+            scriptSig.push_back(33);
+            vector<unsigned char> publicKey = random(33);
+            publicKey[0] = 0x02;
+            scriptSig.insert(scriptSig.end(), publicKey.begin(), publicKey.end());
+            return scriptSig;
+        }
+
+        // A P2WPKH witness: <signature> <compressed public key>
+        void pubKeyHashWitness() {
+            varInt(2);
+            varBytes(random(72));
+            varBytes(random(33));
+        }
+
+        vector<unsigned char> raw;
+        mt19937 rng;
+    };
+
+    vector<unsigned char> script(VtcBlockIndexer::ScriptTemplate type, mt19937& rng) {
+        auto random = [&](size_t size) {
+            vector<unsigned char> value(size);
+            for(auto& b : value) b = rng();
+            return value;
+        };
+        auto append = [](vector<unsigned char>& script, const vector<unsigned char>& value) {
+            script.insert(script.end(), value.begin(), value.end());
+        };
+        auto publicKey = [&]() {
+            vector<unsigned char> key = random(33);
+            key[0] = 0x02 + (rng() & 1);
+            return key;
+        };
+
+        vector<unsigned char> result;
+        switch(type) {
+            case VtcBlockIndexer::ScriptTemplate::PubKeyHash:
+                result = { 0x76, 0xa9, 0x14 };
+                append(result, random(20));
+                append(result, { 0x88, 0xac });
+                break;
+            case VtcBlockIndexer::ScriptTemplate::ScriptHash:
+                result = { 0xa9, 0x14 };
+                append(result, random(20));
+                result.push_back(0x87);
+                break;
+            case VtcBlockIndexer::ScriptTemplate::PubKey:
+                result = { 0x21 };
+                append(result, publicKey());
+                result.push_back(0xac);
+                break;
+            case VtcBlockIndexer::ScriptTemplate::WitnessPubKeyHash:
+                result = { 0x00, 0x14 };
+                append(result, random(20));
+                break;
+            case VtcBlockIndexer::ScriptTemplate::WitnessScriptHash:
+                result = { 0x00, 0x20 };
+                append(result, random(32));
+                break;
+            case VtcBlockIndexer::ScriptTemplate::MultiSig:
+                // 1-of-2
+                result = { 0x51, 0x21 };
+                append(result, publicKey());
+                result.push_back(0x21);
+                append(result, publicKey());
+                append(result, { 0x52, 0xae });
+                break;
+            case VtcBlockIndexer::ScriptTemplate::NullData:
+                result = { 0x6a, 0x24 };
+                append(result, random(36));
+                break;
+            default:
+                // Starts with an invalid opcode and has no template size
+                result = { 0xba };
+                append(result, random(39));
+                break;
+        }
+        return result;
+    }
+}
+
+vector<fixtures::Transaction> fixtures::transactions() {
+    vector<Transaction> result;
+
+    // The coinbase of the bitcoin genesis block
+    result.push_back({ "genesisCoinbase", VtcBlockIndexer::Utility::hexToBytes(
+        "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4d04ffff001d0104455468652054696d65732030332f4a616e2f32303039204368616e63656c6c6f72206f6e206272696e6b206f66207365636f6e64206261696c6f757420666f722062616e6b73ffffffff0100f2052a01000000434104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac00000000") });
+
+    mt19937 rng(1);
+    {
+        // Legacy payment with change
+        TransactionBuilder tx(2);
+        tx.uint32(1);
+        tx.varInt(1);
+        tx.input(tx.pubKeyHashScriptSig());
+        tx.varInt(2);
+        tx.output(150000000, script(VtcBlockIndexer::ScriptTemplate::PubKeyHash, rng));
+        tx.output(3250000, script(VtcBlockIndexer::ScriptTemplate::PubKeyHash, rng));
+        tx.uint32(0);
+        result.push_back({ "p2pkh1in2out", tx.raw });
+    }
+    {
+        // Native segwit payment with change
+        TransactionBuilder tx(3);
+        tx.uint32(2);
+        tx.bytes({ 0x00, 0x01 });
+        tx.varInt(2);
+        tx.input({});
+        tx.input({});
+        tx.varInt(2);
+        tx.output(50000000, script(VtcBlockIndexer::ScriptTemplate::ScriptHash, rng));
+        tx.output(1234567, script(VtcBlockIndexer::ScriptTemplate::WitnessPubKeyHash, rng));
+        tx.pubKeyHashWitness();
+        tx.pubKeyHashWitness();
+        tx.uint32(0);
+        result.push_back({ "p2wpkh2in2out", tx.raw });
+    }
+    {
+        // Coinbase with a witness commitment
+        TransactionBuilder tx(4);
+        tx.uint32(1);
+        tx.bytes({ 0x00, 0x01 });
+        tx.varInt(1);
+        tx.bytes(vector<unsigned char>(32, 0));
+        tx.uint32(0xffffffff);
+        tx.varBytes(tx.random(40));
+        tx.uint32(0xffffffff);
+        tx.varInt(2);
+        tx.output(2500000000, script(VtcBlockIndexer::ScriptTemplate::PubKeyHash, rng));
+        vector<unsigned char> commitment = { 0x6a, 0x24, 0xaa, 0x21, 0xa9, 0xed };
+        vector<unsigned char> commitmentHash = tx.random(32);
+        commitment.insert(commitment.end(), commitmentHash.begin(), commitmentHash.end());
+        tx.output(0, commitment);
+        tx.varInt(1);
+        tx.varBytes(vector<unsigned char>(32, 0));
+        tx.uint32(0);
+        result.push_back({ "coinbaseSegwit", tx.raw });
+    }
+    {
+        // Consolidation of many legacy inputs
+        TransactionBuilder tx(5);
+        tx.uint32(1);
+        tx.varInt(50);
+        for(int i = 0; i < 50; i++) tx.input(tx.pubKeyHashScriptSig());
+        tx.varInt(1);
+        tx.output(1000000000, script(VtcBlockIndexer::ScriptTemplate::PubKeyHash, rng));
+        tx.uint32(0);
+        result.push_back({ "consolidation50in1out", tx.raw });
+    }
+    {
+        // Batched payout (exchange or pool) from a segwit input
+        TransactionBuilder tx(6);
+        tx.uint32(2);
+        tx.bytes({ 0x00, 0x01 });
+        tx.varInt(1);
+        tx.input({});
+        tx.varInt(100);
+        const VtcBlockIndexer::ScriptTemplate types[] = { VtcBlockIndexer::ScriptTemplate::PubKeyHash, VtcBlockIndexer::ScriptTemplate::ScriptHash, VtcBlockIndexer::ScriptTemplate::WitnessPubKeyHash, VtcBlockIndexer::ScriptTemplate::WitnessScriptHash };
+        for(int i = 0; i < 100; i++) tx.output(100000 + i, script(types[i % 4], rng));
+        tx.pubKeyHashWitness();
+        tx.uint32(0);
+        result.push_back({ "batchPayout1in100out", tx.raw });
+    }
+
+    return result;
+}
+
+bool fixtures::loadTransactions(const std::string& fileName, vector<vector<unsigned char>>& transactions) {
+    ifstream i(fileName);
+    if(!i.is_open()) return false;
+
+    json fixtures;
+    try {
+        i >> fixtures;
+    } catch(const exception& e) {
+        return false;
+    }
+    if(!fixtures["transactions"].is_object()) return false;
+
+    for(auto it = fixtures["transactions"].begin(); it != fixtures["transactions"].end(); ++it) {
+        if(it.value().is_string()) {
+            transactions.push_back(VtcBlockIndexer::Utility::hexToBytes(it.value().get<std::string>()));
+        }
+    }
+    return true;
+}
+
+vector<vector<unsigned char>> fixtures::scripts(VtcBlockIndexer::ScriptTemplate type, size_t count) {
+    mt19937 rng(static_cast<uint32_t>(type) + 100);
+    vector<vector<unsigned char>> result;
+    for(size_t i = 0; i < count; i++) {
+        result.push_back(script(type, rng));
+    }
+    return result;
+}
+
+vector<vector<unsigned char>> fixtures::randomBytes(size_t size, size_t count) {
+    mt19937 rng(size * 31 + count);
+    vector<vector<unsigned char>> result;
+    for(size_t i = 0; i < count; i++) {
+        vector<unsigned char> value(size);
+        for(auto& b : value) b = rng();
+        result.push_back(value);
+    }
+    return result;
+}
+
+std::function<void(bench::Run&)> fixtures::readTransactions(vector<vector<unsigned char>> transactions) {
+    return [transactions](bench::Run& run) {
+        VtcBlockIndexer::BlockReader blockReader("");
+        size_t bytes = 0;
+        for(const auto& raw : transactions) bytes += raw.size();
+        run.setBytesPerOp(bytes);
+        run.setItemsPerOp(transactions.size());
+        run.loop([&](uint64_t) {
+            for(const auto& raw : transactions) {
+                byte_array_buffer streambuf(raw.data(), raw.size());
+                istream stream(&streambuf);
+                bench::doNotOptimizeAway(blockReader.readTransaction(stream));
+            }
+        });
+    };
+}
@@ -0,0 +1,60 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_FIXTURES_H_INCLUDED
+#define BENCH_FIXTURES_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <functional>
+#include "bench.h"
+#include "../src/scriptsolver.h"
+
+namespace fixtures {
+
+/** A raw serialized transaction to benchmark the parser with */
+struct Transaction {
+    std::string name;
+    std::vector<unsigned char> raw;
+};
+
+/** The built-in transactions: the genesis coinbase and transactions shaped like the
+ * common real-world ones (legacy and segwit payments, a segwit coinbase, a
+ * consolidation and a batched payout). */
+std::vector<Transaction> transactions();
+
+/** Loads the raw transactions from a fixtures file (a JSON object with
+ * "transactions" mapping txids to hex). Returns false if the file could not be read.
+ */
+bool loadTransactions(const std::string& fileName, std::vector<std::vector<unsigned char>>& transactions);
+
+/** Returns count different output scripts of the given template, with random hashes
+ * and keys. ScriptTemplate::Unknown returns scripts no template matches. */
+std::vector<std::vector<unsigned char>> scripts(VtcBlockIndexer::ScriptTemplate type, size_t count);
+
+/** Returns count random byte strings of the given size */
+std::vector<std::vector<unsigned char>> randomBytes(size_t size, size_t count);
+
+/** Benchmark parsing all the given raw transactions with BlockReader::readTransaction */
+std::function<void(bench::Run&)> readTransactions(std::vector<std::vector<unsigned char>> transactions);
+
+}
+
+#endif // BENCH_FIXTURES_H_INCLUDED
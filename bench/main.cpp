@@ -0,0 +1,138 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*  vtc_bench - Microbenchmarks for the parser, script solver and crypto hot paths.
+    Runs offline on built-in fixtures (and optionally the transactions in a 
+    fixtures file) and writes the results as JSON, so runs before and
+    after an optimization can be compared.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <regex>
+#include <ctime>
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/coinparams.h"
+#include "../src/hash256.h"
+#include "../src/cxxopts.hpp"
+#include "../src/json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("vtc_bench", "Microbenchmarks for the indexer hot paths");
+    options.add_options()
+    ("coinParams", "Coin parameters file [Default: Vertcoin mainnet]", cxxopts::value<std::string>())
+    ("filter", "Only run the benchmarks whose name matches this regular expression", cxxopts::value<std::string>()->default_value(""))
+    ("samples", "Number of samples per benchmark [Default: 11]", cxxopts::value<size_t>()->default_value("11"))
+    ("sampleTime", "Minimum time per sample in milliseconds [Default: 10]", cxxopts::value<int>()->default_value("10"))
+    ("transactions", "Fixtures file with real transactions to benchmark readTransaction with", cxxopts::value<std::string>())
+    ("output", "File to write the JSON results to [Default: stdout]", cxxopts::value<std::string>()->default_value(""))
+    ("list", "List the benchmarks and exit")
+    ;
+    options.parse(argc, argv);
+
+    if(options.count("coinParams") > 0) {
+        VtcBlockIndexer::CoinParams::readFromFile(options["coinParams"].as<string>());
+    } else {
+        VtcBlockIndexer::CoinParams::magic = { 0xfa, 0xbf, 0xb5, 0xda };
+        VtcBlockIndexer::CoinParams::bech32Prefix = "vtc";
+        VtcBlockIndexer::CoinParams::p2pkhVersion = 0x47;
+        VtcBlockIndexer::CoinParams::p2shVersion = 0x05;
+    }
+
+    if(options.count("transactions") > 0) {
+        vector<vector<unsigned char>> transactions;
+        if(!fixtures::loadTransactions(options["transactions"].as<string>(), transactions)) {
+            cerr << "Could not read transactions from " << options["transactions"].as<string>() << endl;
+            return 1;
+        }
+        bench::registry().push_back({ "blockreader/readTransaction/fixturesFile", fixtures::readTransactions(transactions) });
+    }
+
+    vector<bench::Benchmark> benchmarks = bench::registry();
+    sort(benchmarks.begin(), benchmarks.end(), [](const bench::Benchmark& a, const bench::Benchmark& b) { return a.name < b.name; });
+    regex filter(options["filter"].as<string>());
+    benchmarks.erase(remove_if(benchmarks.begin(), benchmarks.end(), [&](const bench::Benchmark& benchmark) {
+        return !regex_search(benchmark.name, filter);
+    }), benchmarks.end());
+
+    if(options.count("list") > 0) {
+        for(const bench::Benchmark& benchmark : benchmarks) cout << benchmark.name << endl;
+        return 0;
+    }
+
+    bench::Config config;
+    config.samples = options["samples"].as<size_t>();
+    config.minSampleTime = chrono::milliseconds(options["sampleTime"].as<int>());
+
+    json results = json::array();
+    for(const bench::Benchmark& benchmark : benchmarks) {
+        bench::Result result = bench::run(benchmark, config);
+
+        json j;
+        j["name"] = result.name;
+        j["iterations"] = result.iterations;
+        j["samples"] = result.samples;
+        j["nsPerOp"] = { { "min", result.minNs }, { "median", result.medianNs }, { "mean", result.meanNs }, { "stddev", result.stddevNs } };
+        if(result.itemsPerOp > 0) {
+            j["itemsPerOp"] = result.itemsPerOp;
+            j["nsPerItem"] = result.medianNs / result.itemsPerOp;
+        }
+        if(result.bytesPerOp > 0) {
+            j["bytesPerOp"] = result.bytesPerOp;
+            j["bytesPerSecond"] = result.bytesPerOp * 1e9 / result.medianNs;
+        }
+        results.push_back(j);
+
+        cerr << left << setw(60) << result.name << right << setw(14) << fixed << setprecision(1) << result.medianNs << " ns/op" 
+             << " (+/- " << setprecision(1) << (result.medianNs > 0 ? 100 * result.stddevNs / result.medianNs : 0) << "%)" << endl;
+    }
+
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    json output;
+    output["context"] = {
+        { "date", date },
+        { "compiler", __VERSION__ },
+        { "hash256", VtcBlockIndexer::Hash256::implementation() },
+        { "samples", config.samples },
+        { "sampleTimeMs", options["sampleTime"].as<int>() }
+    };
+    output["benchmarks"] = results;
+
+    string outputFile = options["output"].as<string>();
+    if(outputFile.empty()) {
+        cout << output.dump(2) << endl;
+    } else {
+        ofstream o(outputFile);
+        o << output.dump(2) << endl;
+        if(!o.good()) {
+            cerr << "Could not write " << outputFile << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
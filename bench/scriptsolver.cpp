@@ -0,0 +1,50 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/scriptsolver.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t scriptCount = 1024;
+
+    bench::Registrar getAddressesFromScript(VtcBlockIndexer::ScriptTemplate type) {
+        string name = "scriptsolver/getAddressesFromScript/" + string(VtcBlockIndexer::ScriptStatistics::templateName(type));
+        return bench::Registrar(name, [type](bench::Run& run) {
+            VtcBlockIndexer::ScriptSolver scriptSolver;
+            vector<vector<unsigned char>> scripts = fixtures::scripts(type, scriptCount);
+            run.loop([&](uint64_t i) {
+                bench::doNotOptimizeAway(scriptSolver.getAddressesFromScript(scripts[i % scriptCount]));
+            });
+        });
+    }
+
+    bench::Registrar pubKeyHash = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::PubKeyHash);
+    bench::Registrar scriptHash = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::ScriptHash);
+    bench::Registrar pubKey = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::PubKey);
+    bench::Registrar witnessPubKeyHash = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::WitnessPubKeyHash);
+    bench::Registrar witnessScriptHash = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::WitnessScriptHash);
+    bench::Registrar multiSig = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::MultiSig);
+    bench::Registrar nullData = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::NullData);
+    bench::Registrar unknown = getAddressesFromScript(VtcBlockIndexer::ScriptTemplate::Unknown);
+}
@@ -0,0 +1,94 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bench.h"
+#include "fixtures.h"
+#include "../src/utility.h"
+#include "../src/hash256.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t inputCount = 1024;
+
+    bench::Registrar sha256(size_t size) {
+        return bench::Registrar("utility/sha256/" + to_string(size), [size](bench::Run& run) {
+            vector<vector<unsigned char>> inputs = fixtures::randomBytes(size, inputCount);
+            run.setBytesPerOp(size);
+            run.loop([&](uint64_t i) {
+                bench::doNotOptimizeAway(VtcBlockIndexer::Utility::sha256(inputs[i % inputCount]));
+            });
+        });
+    }
+
+    bench::Registrar sha256Hash = sha256(32);
+    bench::Registrar sha256Header = sha256(80);
+    bench::Registrar sha256Transaction = sha256(250);
+
+    bench::Registrar hash256Batch("hash256/hashBatch/64x250", [](bench::Run& run) {
+        vector<vector<unsigned char>> inputs = fixtures::randomBytes(250, 64);
+        vector<VtcBlockIndexer::Hash256::Input> batch;
+        for(const auto& input : inputs) batch.push_back({ input.data(), input.size() });
+        vector<unsigned char> out(batch.size() * VtcBlockIndexer::Hash256::outputSize);
+        run.setBytesPerOp(64 * 250);
+        run.setItemsPerOp(64);
+        run.loop([&](uint64_t) {
+            VtcBlockIndexer::Hash256::hashBatch(batch, out.data());
+            bench::doNotOptimizeAway(out[0]);
+        });
+    });
+
+    bench::Registrar base58("utility/base58/25", [](bench::Run& run) {
+        vector<vector<unsigned char>> inputs = fixtures::randomBytes(25, inputCount);
+        run.setBytesPerOp(25);
+        run.loop([&](uint64_t i) {
+            bench::doNotOptimizeAway(VtcBlockIndexer::Utility::base58(inputs[i % inputCount]));
+        });
+    });
+
+    bench::Registrar pubKeyHashAddress("utility/ripeMD160ToP2PKAddress", [](bench::Run& run) {
+        vector<vector<unsigned char>> inputs = fixtures::randomBytes(20, inputCount);
+        run.loop([&](uint64_t i) {
+            bench::doNotOptimizeAway(VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(inputs[i % inputCount]));
+        });
+    });
+
+    bench::Registrar bech32Address(size_t size) {
+        return bench::Registrar("utility/bech32Address/" + to_string(size), [size](bench::Run& run) {
+            vector<vector<unsigned char>> inputs = fixtures::randomBytes(size, inputCount);
+            run.setBytesPerOp(size);
+            run.loop([&](uint64_t i) {
+                bench::doNotOptimizeAway(VtcBlockIndexer::Utility::bech32Address(inputs[i % inputCount]));
+            });
+        });
+    }
+
+    bench::Registrar bech32WitnessPubKeyHash = bech32Address(20);
+    bench::Registrar bech32WitnessScriptHash = bech32Address(32);
+
+    bench::Registrar hashToReverseHex("utility/hashToReverseHex/32", [](bench::Run& run) {
+        vector<vector<unsigned char>> inputs = fixtures::randomBytes(32, inputCount);
+        run.setBytesPerOp(32);
+        run.loop([&](uint64_t i) {
+            bench::doNotOptimizeAway(VtcBlockIndexer::Utility::hashToReverseHex(inputs[i % inputCount]));
+        });
+    });
+}
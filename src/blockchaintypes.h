@@ -44,6 +44,15 @@ struct ScannedBlock {
     string previousBlockHash; 
 };
 
+// Describes where a transaction is stored inside the block files (as indexed under tx-filePosition-<txid>)
+struct TransactionFilePosition {
+    // The blk????.dat file the transaction is located in
+    string fileName;
+
+    // The position inside the block file where the transaction starts
+    uint64_t filePosition;
+};
+
 // Describes a transaction output inside a blockchain transaction
 struct TransactionOutput {
     // The value of the output in Satoshis (0.00000001 VTC)
@@ -32,9 +32,16 @@
 #include <chrono>
 #include <thread>
 #include <time.h>
+#include <algorithm>
 
 using namespace std;
 
+namespace {
+    // Notified blocks waiting to be indexed. Anything beyond this is left to the
+    // directory poll, which catches up with all of them anyway.
+    const size_t maxNotifiedBlocks = 16;
+}
+
 // Constructor
 VtcBlockIndexer::BlockFileWatcher::BlockFileWatcher(string blocksDir, const shared_ptr<leveldb::DB> db, const shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor) {
     this->db = db;
@@ -81,17 +88,98 @@ void VtcBlockIndexer::BlockFileWatcher::startWatcher() {
             updateIndex();
         }
 
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Wait for the next poll, or until the node announces a block
+        vector<string> blockHashes;
+        {
+            unique_lock<mutex> lock(notifyMutex);
+            notifyCondition.wait_for(lock, std::chrono::seconds(1), [this] { return !notifiedBlocks.empty(); });
+            blockHashes.swap(notifiedBlocks);
+        }
+
+        // A block that can not be indexed on top of the tip (not written yet, unknown or
+        // a reorg) is left to the directory poll, which sees its file change
+        for(const string& blockHash : blockHashes) {
+            if(!indexNotifiedBlock(blockHash)) {
+                cout << "Block " << blockHash << " does not extend the indexed tip, leaving it to the next poll." << endl;
+                break;
+            }
+        }
+    }
+}
+
+void VtcBlockIndexer::BlockFileWatcher::blockNotify(string blockHash) {
+    lock_guard<mutex> lock(notifyMutex);
+    if(notifiedBlocks.size() >= maxNotifiedBlocks || find(notifiedBlocks.begin(), notifiedBlocks.end(), blockHash) != notifiedBlocks.end()) {
+        return;
+    }
+    notifiedBlocks.push_back(blockHash);
+    notifyCondition.notify_one();
+}
+
+bool VtcBlockIndexer::BlockFileWatcher::indexNotifiedBlock(string blockHash) {
+    string highestBlock;
+    leveldb::Status s = this->db->Get(leveldb::ReadOptions(), "highestblock", &highestBlock);
+    if(!s.ok()) return false;
+
+    string tipHash;
+    s = this->db->Get(leveldb::ReadOptions(), "block-" + highestBlock, &tipHash);
+    if(!s.ok()) return false;
+    if(tipHash == blockHash) return true;
+
+    // Already indexed below the tip, nothing to do
+    string indexedHeight;
+    if(this->db->Get(leveldb::ReadOptions(), "block-hash-" + blockHash, &indexedHeight).ok()) return true;
+
+    string tipPosition;
+    s = this->db->Get(leveldb::ReadOptions(), "block-filePosition-" + highestBlock, &tipPosition);
+    if(!s.ok() || tipPosition.size() != 24) return false;
+
+    uint64_t height = stoull(highestBlock) + 1;
+
+    // A new block is appended to the tip's file after it, or starts the next one.
+    // The stored position is that of the header, after the magic string and size.
+    string fileName = tipPosition.substr(0,12);
+    uint64_t filePosition = stoull(tipPosition.substr(12,12)) - 8;
+    for(int i = 0; i < 2; i++) {
+        unique_ptr<VtcBlockIndexer::BlockScanner> blockScanner(new VtcBlockIndexer::BlockScanner(blocksDir, fileName));
+        if(blockScanner->open() && blockScanner->seek(filePosition)) {
+            while(blockScanner->moveNext()) {
+                VtcBlockIndexer::ScannedBlock block = blockScanner->scanNextBlock();
+                if(block.blockHash != blockHash) continue;
+                blockScanner->close();
+
+                if(block.previousBlockHash != tipHash) return false;
+
+                auto readStart = chrono::steady_clock::now();
+                VtcBlockIndexer::Block fullBlock = blockReader->readBlock(block.fileName, block.filePosition, height, false);
+                VtcBlockIndexer::BlockIndexer::telemetry.blockRead(chrono::duration<double>(chrono::steady_clock::now() - readStart).count(), fullBlock.byteSize);
+                blockIndexer->indexBlock(fullBlock);
+                VtcBlockIndexer::BlockIndexer::telemetry.blockProcessed(height);
+                cout << "Indexed notified block " << blockHash << " (Height " << height << ")" << endl;
+                return true;
+            }
+            blockScanner->close();
+        }
+
+        // blk?????.dat files are numbered with a fixed width
+        stringstream nextFileName;
+        nextFileName << "blk" << setw(5) << setfill('0') << (stoi(fileName.substr(3,5)) + 1) << ".dat";
+        fileName = nextFileName.str();
+        filePosition = 0;
     }
+    return false;
 }
 
 void VtcBlockIndexer::BlockFileWatcher::scanBlocks(string fileName) {
     unique_ptr<VtcBlockIndexer::BlockScanner> blockScanner(new VtcBlockIndexer::BlockScanner(blocksDir, fileName));
     if(blockScanner->open())
     {
-        while(blockScanner->moveNext()) {
+        auto scanStart = chrono::steady_clock::now();
+        vector<VtcBlockIndexer::ScannedBlock> scannedBlocks = blockScanner->scanAllBlocks();
+        VtcBlockIndexer::BlockIndexer::telemetry.fileScanned(chrono::duration<double>(chrono::steady_clock::now() - scanStart).count(), scannedBlocks.size());
+
+        for(const VtcBlockIndexer::ScannedBlock& block : scannedBlocks) {
             this->totalBlocks++;
-            VtcBlockIndexer::ScannedBlock block = blockScanner->scanNextBlock();
             // Create an empty vector inside the unordered map if this previousBlockHash
             // was not found before.
             if(this->blocks.find(block.previousBlockHash) == this->blocks.end()) {
@@ -196,7 +284,9 @@ string VtcBlockIndexer::BlockFileWatcher::processNextBlock(string prevBlockHash)
         } 
     
         if(!blockIndexer->hasIndexedBlock(bestBlock.blockHash, this->blockHeight)) {
+            auto readStart = chrono::steady_clock::now();
             VtcBlockIndexer::Block fullBlock = blockReader->readBlock(bestBlock.fileName, bestBlock.filePosition, this->blockHeight, false);
+            VtcBlockIndexer::BlockIndexer::telemetry.blockRead(chrono::duration<double>(chrono::steady_clock::now() - readStart).count(), fullBlock.byteSize);
            
             blockIndexer->indexBlock(fullBlock);
         }
@@ -217,22 +307,26 @@ void VtcBlockIndexer::BlockFileWatcher::updateIndex() {
     this->blockHeight = 0;
     this->totalBlocks = 0;
     cout << "Scanning blocks..." << endl;
+    VtcBlockIndexer::BlockIndexer::telemetry.updateStarted();
 
     scanBlockFiles(blocksDir);
     
     cout << "Found " << this->totalBlocks << " blocks. Constructing longest chain..." << endl;
+    VtcBlockIndexer::BlockIndexer::telemetry.constructionStarted();
 
     // The blockchain starts with the genesis block that has a zero hash as Previous Block Hash
     string nextBlock = "0000000000000000000000000000000000000000000000000000000000000000";
     string processedBlock = processNextBlock(nextBlock);
     double nextUpdate = 10;
     while(processedBlock != "") {
+        VtcBlockIndexer::BlockIndexer::telemetry.blockProcessed(this->blockHeight);
 
-        // Show progress every 10 seconds
+        // Show progress every 10 seconds, /sync and /metrics have the details
         double seconds = difftime(time(NULL), start);
         if(seconds >= nextUpdate) { 
             nextUpdate += 10;
-            cout << "Construction is at height " << this->blockHeight << endl;
+            VtcBlockIndexer::IndexingTelemetry::Progress progress = VtcBlockIndexer::BlockIndexer::telemetry.getProgress();
+            cout << "Construction is at height " << this->blockHeight << " (" << (int)progress.blocksPerSecond << " blocks/s, " << (int)progress.transactionsPerSecond << " tx/s, pubkey cache hit rate " << (int)(VtcBlockIndexer::ScriptSolver::pubKeyCache.getHitRate() * 100) << "%)" << endl;
         }
         this->blockHeight++;
         nextBlock = processedBlock;
@@ -240,6 +334,7 @@ void VtcBlockIndexer::BlockFileWatcher::updateIndex() {
     }
 
     cout << "Done. Processed " << this->blockHeight << " blocks. Have a nice day." << endl;
+    VtcBlockIndexer::BlockIndexer::telemetry.updateFinished();
 
     this->blocks.clear();
 }
@@ -25,6 +25,8 @@
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
+#include <mutex>
+#include <condition_variable>
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
 #include "blockchaintypes.h"
@@ -53,8 +55,21 @@ public:
 
     /** Updates the blockchain index incrementally */
     void updateIndex();
+
+    /** Queues a block the node announced (i.e. through -blocknotify) and wakes up
+     * the watcher to index it right away, instead of on the next directory poll.
+     * Hashes already queued are ignored, as is everything once the queue is full. */
+    void blockNotify(string blockHash);
     
 private:
+    /** Indexes a single notified block on top of the current tip, by only scanning
+     * the blocks written after the tip in its file, and the file after that.
+     * Returns true if it was indexed, or was already. Returns false if the block
+     * could not be found or does not extend the tip (i.e. a reorg), the directory
+     * poll picks it up then.
+     */
+    bool indexNotifiedBlock(string blockHash);
+
     /** Uses the blockscanner to scan blocks within a file and add them to the
      * unordered map.
      * 
@@ -92,6 +107,9 @@ private:
     int blockHeight;
     unordered_map<string, vector<VtcBlockIndexer::ScannedBlock>> blocks;    
     struct timespec maxLastModified;
+    mutex notifyMutex;
+    condition_variable notifyCondition;
+    vector<string> notifiedBlocks;
 }; 
 
 }
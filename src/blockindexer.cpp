@@ -19,6 +19,7 @@
 */
 #include "blockindexer.h"
 #include "scriptsolver.h"
+#include "utility.h"
 #include "blockchaintypes.h"
 #include <iostream>
 #include <sstream>
@@ -34,12 +35,25 @@ using namespace std;
 // This map keeps the nextTxoIndex in memory for speed - no database fetching on every TX
 unordered_map<string, int> nextTxoIndex;
 
+VtcBlockIndexer::IndexingTelemetry VtcBlockIndexer::BlockIndexer::telemetry;
+atomic<uint64_t> VtcBlockIndexer::BlockIndexer::tipVersion(0);
+const int VtcBlockIndexer::BlockIndexer::indexVersion = 1;
+
 
 
 VtcBlockIndexer::BlockIndexer::BlockIndexer(const shared_ptr<leveldb::DB> db, const shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor) {
     this->db = db;
     this->mempoolMonitor = mempoolMonitor;
     this->scriptSolver = make_unique<VtcBlockIndexer::ScriptSolver>();
+    this->writeTime = chrono::steady_clock::duration::zero();
+    this->writes = 0;
+}
+
+void VtcBlockIndexer::BlockIndexer::put(const string& key, const string& value) {
+    auto start = chrono::steady_clock::now();
+    this->db->Put(leveldb::WriteOptions(), key, value);
+    this->writeTime += chrono::steady_clock::now() - start;
+    this->writes++;
 }
 
 
@@ -93,6 +107,10 @@ bool VtcBlockIndexer::BlockIndexer::clearBlockTxos(string blockHash) {
     return s.ok();
 }
 
+uint64_t VtcBlockIndexer::BlockIndexer::getTipVersion() {
+    return tipVersion;
+}
+
 bool VtcBlockIndexer::BlockIndexer::hasIndexedBlock(string blockHash, int blockHeight)
 {
     stringstream ss;
@@ -109,7 +127,13 @@ bool VtcBlockIndexer::BlockIndexer::hasIndexedBlock(string blockHash, int blockH
 
 bool VtcBlockIndexer::BlockIndexer::indexBlock(Block block) {
     //cout << "Indexing block " << block.blockHash << " (Height " << block.height << ")" << endl;
-    
+    auto start = chrono::steady_clock::now();
+    chrono::steady_clock::duration solveTime = chrono::steady_clock::duration::zero();
+    this->writeTime = chrono::steady_clock::duration::zero();
+    this->writes = 0;
+    uint64_t inputCount = 0;
+    uint64_t outputCount = 0;
+
     stringstream ss;
     ss << "block-" << setw(8) << setfill('0') << block.height;
     
@@ -122,6 +146,8 @@ bool VtcBlockIndexer::BlockIndexer::indexBlock(Block block) {
     } else if (s.ok()) {
         // There was a different block at this height. Ditch the TXOs from the old block.
         clearBlockTxos(existingBlockHash);
+        telemetry.reorg();
+        tipVersion++;
     }
 
     stringstream blockHeight;
@@ -130,40 +156,42 @@ bool VtcBlockIndexer::BlockIndexer::indexBlock(Block block) {
     string highestBlock;
     s = this->db->Get(leveldb::ReadOptions(), "highestblock", &highestBlock);
     if(!s.ok()) {
-        this->db->Put(leveldb::WriteOptions(), "highestblock", blockHeight.str());
+        // A new index, so it is written in the current format from the start
+        put("highestblock", blockHeight.str());
+        put("index-version", std::to_string(indexVersion));
     } else {
         if(stoull(highestBlock) < block.height) {
-            this->db->Put(leveldb::WriteOptions(), "highestblock", blockHeight.str());
+            put("highestblock", blockHeight.str());
         }
     }
     
-    this->db->Put(leveldb::WriteOptions(), ss.str(), block.blockHash);
+    put(ss.str(), block.blockHash);
     
     stringstream ssBlockFilePositionKey;
     ssBlockFilePositionKey << "block-filePosition-" << setw(8) << setfill('0') << block.height;
     stringstream ssBlockFilePositionValue;
     ssBlockFilePositionValue << block.fileName << setw(12) << setfill('0') << block.filePosition;
 
-    this->db->Put(leveldb::WriteOptions(), ssBlockFilePositionKey.str(), ssBlockFilePositionValue.str());
+    put(ssBlockFilePositionKey.str(), ssBlockFilePositionValue.str());
     
     stringstream ssBlockHashHeightKey;
     ssBlockHashHeightKey << "block-hash-" << block.blockHash;
     stringstream ssBlockHashHeightValue;
     ssBlockHashHeightValue << setw(8) << setfill('0') << block.height;
 
-    this->db->Put(leveldb::WriteOptions(), ssBlockHashHeightKey.str(), ssBlockHashHeightValue.str());
+    put(ssBlockHashHeightKey.str(), ssBlockHashHeightValue.str());
     
     stringstream ssBlockTimeHeightKey;
     ssBlockTimeHeightKey << "block-time-" << setw(8) << setfill('0') << block.height;
-    this->db->Put(leveldb::WriteOptions(), ssBlockTimeHeightKey.str(), std::to_string(block.time));
+    put(ssBlockTimeHeightKey.str(), std::to_string(block.time));
     
     stringstream ssBlockSizeHeightKey;
     ssBlockSizeHeightKey << "block-size-" << setw(8) << setfill('0') << block.height;
-    this->db->Put(leveldb::WriteOptions(), ssBlockSizeHeightKey.str(), std::to_string(block.byteSize));
+    put(ssBlockSizeHeightKey.str(), std::to_string(block.byteSize));
     
     stringstream ssBlockTxCountHeightKey;
     ssBlockTxCountHeightKey << "block-txcount-"  << setw(8) << setfill('0') << block.height;
-    this->db->Put(leveldb::WriteOptions(), ssBlockTxCountHeightKey.str(), std::to_string(block.transactions.size()));
+    put(ssBlockTxCountHeightKey.str(), std::to_string(block.transactions.size()));
 
     int txIndex = -1;
     // TODO: Verify block integrity
@@ -171,45 +199,65 @@ bool VtcBlockIndexer::BlockIndexer::indexBlock(Block block) {
         txIndex++;
         stringstream blockTxKey;
         blockTxKey << "block-" << block.blockHash << "-tx-" << setw(8) << setfill('0') << txIndex;
-        this->db->Put(leveldb::WriteOptions(), blockTxKey.str(), tx.txHash);
+        put(blockTxKey.str(), tx.txHash);
 
         stringstream ssTxFilePositionKey;
         ssTxFilePositionKey << "tx-filePosition-" << tx.txHash;
         stringstream ssTxFilePositionValue;
         ssTxFilePositionValue << block.fileName << setw(12) << setfill('0') << tx.filePosition;
     
-        this->db->Put(leveldb::WriteOptions(), ssTxFilePositionKey.str(), ssTxFilePositionValue.str());
+        put(ssTxFilePositionKey.str(), ssTxFilePositionValue.str());
 
         stringstream txBlockKey;
         txBlockKey << "tx-" << tx.txHash << "-block";
-        this->db->Put(leveldb::WriteOptions(), txBlockKey.str(), block.blockHash);
-
-
-        for(VtcBlockIndexer::TransactionOutput out : tx.outputs) {
-            vector<string> addresses = this->scriptSolver->getAddressesFromScript(out.script);
-            if(addresses.size() > 1) {
-                if(scriptSolver->isMultiSig(out.script)) {
-                    stringstream txoMultiSigKey;
-                    txoMultiSigKey << "multisigtx-" << tx.txHash << "-" << setw(8) << setfill('0') << out.index;
-                    this->db->Put(leveldb::WriteOptions(), txoMultiSigKey.str(), std::to_string(scriptSolver->requiredSignatures(out.script)));
-                }
+        put(txBlockKey.str(), block.blockHash);
+
+
+        for(const VtcBlockIndexer::TransactionOutput& out : tx.outputs) {
+            outputCount++;
+            auto solveStart = chrono::steady_clock::now();
+            VtcBlockIndexer::ScriptClassification classification = VtcBlockIndexer::ScriptSolver::classify(out.script);
+            vector<string> addresses = this->scriptSolver->getAddresses(classification);
+            solveTime += chrono::steady_clock::now() - solveStart;
+            VtcBlockIndexer::ScriptSolver::scriptStatistics.record(classification.type, block.height);
+            if(classification.type == VtcBlockIndexer::ScriptTemplate::Unknown) {
+                VtcBlockIndexer::ScriptSolver::scriptStatistics.recordUnknown(out.script.data(), out.script.size(), block.height, tx.txHash, out.index);
+            }
+            if(addresses.size() > 1 && classification.type == VtcBlockIndexer::ScriptTemplate::MultiSig) {
+                stringstream txoMultiSigKey;
+                txoMultiSigKey << "multisigtx-" << tx.txHash << "-" << setw(8) << setfill('0') << out.index;
+                put(txoMultiSigKey.str(), std::to_string(classification.requiredSignatures));
+            }
+            if(!addresses.empty() && (classification.type == VtcBlockIndexer::ScriptTemplate::PubKey || classification.type == VtcBlockIndexer::ScriptTemplate::MultiSig)) {
+                // Indexed under the addresses of the keys, but not paying to their scripts
+                stringstream txoBareKeyKey;
+                txoBareKeyKey << "txo-" << tx.txHash << "-" << setw(8) << setfill('0') << out.index << "-barekey";
+                put(txoBareKeyKey.str(), "1");
             }
             for(string address : addresses) {
                 int nextIndex = getNextTxoIndex(address + "-txo");
+                if(nextIndex == 1) {
+                    // First output to this address, so Electrum clients can find it by script hash
+                    vector<unsigned char> addressScript = VtcBlockIndexer::Utility::addressToScript(address);
+                    if(!addressScript.empty()) {
+                        put("scripthash-" + VtcBlockIndexer::Utility::scriptHash(addressScript), address);
+                    }
+                }
                 stringstream txoKey;
                 txoKey << address << "-txo-" << setw(8) << setfill('0') << nextIndex;
                 stringstream txoValue;
                 txoValue << tx.txHash << setw(8) << setfill('0') << out.index << setw(8) << setfill('0') << block.height << out.value;
-                this->db->Put(leveldb::WriteOptions(), txoKey.str(), txoValue.str());
+                put(txoKey.str(), txoValue.str());
 
                 nextIndex = getNextTxoIndex(block.blockHash + "-txo");
                 stringstream blockTxoKey;
                 blockTxoKey << block.blockHash << "-txo-" << setw(8) << setfill('0') << nextIndex;
-                this->db->Put(leveldb::WriteOptions(), blockTxoKey.str(), txoKey.str());
+                put(blockTxoKey.str(), txoKey.str());
             }
         }
 
         for(VtcBlockIndexer::TransactionInput txi : tx.inputs) {
+            inputCount++;
             if(!txi.coinbase)
             {
                 stringstream txSpentKey;
@@ -218,17 +266,29 @@ bool VtcBlockIndexer::BlockIndexer::indexBlock(Block block) {
                 stringstream spendingTx;
                 spendingTx << block.blockHash << "-" << tx.txHash;
                 
-                this->db->Put(leveldb::WriteOptions(), txSpentKey.str(), spendingTx.str());
+                put(txSpentKey.str(), spendingTx.str());
 
                 int nextIndex = getNextTxoIndex(block.blockHash + "-txospent");
                 stringstream blockTxoSpentKey;
                 blockTxoSpentKey << block.blockHash << "-txospent-" << setw(8) << setfill('0') << nextIndex;
-                this->db->Put(leveldb::WriteOptions(), blockTxoSpentKey.str(), txSpentKey.str());
+                put(blockTxoSpentKey.str(), txSpentKey.str());
             }
         }
-        this->mempoolMonitor->transactionIndexed(tx.txHash);
     }
 
+    // Remove the confirmed transactions from the mempool in one go
+    vector<string> txids;
+    for(const VtcBlockIndexer::Transaction& tx : block.transactions) {
+        txids.push_back(tx.txHash);
+    }
+    this->mempoolMonitor->transactionsIndexed(txids);
+
+    telemetry.blockIndexed(block.transactions.size(), inputCount, outputCount, 
+        chrono::duration<double>(solveTime).count(), chrono::duration<double>(this->writeTime).count(), this->writes, 
+        chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+    // Only now the block is fully written, responses built from here on include it
+    tipVersion++;
 
 
     return true;
@@ -24,11 +24,14 @@
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <atomic>
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
 #include "blockchaintypes.h"
 #include "scriptsolver.h"
 #include "mempoolmonitor.h"
+#include "indexingtelemetry.h"
 
 using namespace std;
 
@@ -57,6 +60,19 @@ public:
      */
     bool hasIndexedBlock(string blockHash, int blockHeight);
 
+    /** Counters and timings of the indexing pipeline, shared by the block file
+     * watcher and the HTTP server */
+    static VtcBlockIndexer::IndexingTelemetry telemetry;
+
+    /** Returns a number that changes whenever a block is connected to or disconnected
+     * from the index, so cached responses can tell they are outdated */
+    static uint64_t getTipVersion();
+
+    /** The format version written to index-version when a new index is started.
+     * Version 1 marks pay-to-pubkey and bare multisig outputs with a
+     * txo-<txid>-<vout>-barekey key; an index without index-version predates that. */
+    static const int indexVersion;
+
 private:
     /** Removes TXOs and spends from a particular blockhash 
      * in case of a reorg */
@@ -66,11 +82,20 @@ private:
      */
     int getNextTxoIndex(string prefix);
 
+    /** Writes a key of the block being indexed, and counts the time it took */
+    void put(const string& key, const string& value);
+
     shared_ptr<leveldb::DB> db;
     shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor;
 
     // Reference to the scriptsolver class
     unique_ptr<VtcBlockIndexer::ScriptSolver> scriptSolver;
+
+    static atomic<uint64_t> tipVersion;
+
+    // Time spent and keys written by put() for the block being indexed
+    chrono::steady_clock::duration writeTime;
+    uint64_t writes;
 };
 
 }
@@ -21,6 +21,7 @@
 #include "filereader.h"
 #include "blockchaintypes.h"
 #include "utility.h"
+#include "hash256.h"
 #include <string.h>
 #include <memory>
 #include <sstream>
@@ -29,9 +30,97 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <numeric>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
+namespace {
+    // Size of the chunks read from the block files when extracting raw transactions.
+    // Transactions of the same block are usually close together, so a single read 
+    // often serves a number of them.
+    const size_t rawReadWindow = 64 * 1024;
+
+    // Upper bound for a single transaction, to stop growing the read window on
+    // corrupt data.
+    const size_t maxRawTransactionSize = 32 * 1024 * 1024;
+
+    // Bounds checked cursor over a serialized transaction in memory
+    struct RawCursor {
+        const unsigned char* data;
+        size_t size;
+        size_t pos;
+        bool truncated;
+
+        bool skip(uint64_t length) {
+            if(truncated || length > size - pos) {
+                truncated = true;
+                pos = size;
+                return false;
+            }
+            pos += length;
+            return true;
+        }
+
+        uint64_t readVarInt() {
+            if(!skip(1)) return 0;
+            uint8_t prefix = data[pos-1];
+            if(prefix < 253) return prefix;
+
+            size_t length = (prefix == 253) ? 2 : (prefix == 254) ? 4 : 8;
+            if(!skip(length)) return 0;
+            uint64_t value = 0;
+            for(size_t i = length; i-- > 0;) {
+                value = (value << 8) | data[pos-length+i];
+            }
+            return value;
+        }
+    };
+
+    // Walks the serialized transaction and returns its length in bytes, or 0 when the
+    // buffer ends before the transaction does. If scriptPos is passed and output scriptVout
+    // exists, its script offset and length are returned through scriptPos/scriptLength.
+    size_t parseRawTransaction(const unsigned char* data, size_t size, uint32_t scriptVout, size_t* scriptPos, size_t* scriptLength) {
+        RawCursor cursor = {data, size, 0, false};
+        
+        cursor.skip(4); // version
+        bool segwit = (size >= 6 && data[4] == 0x00 && data[5] != 0x00);
+        if(segwit) cursor.skip(2);
+
+        uint64_t inputCount = cursor.readVarInt();
+        for(uint64_t input = 0; input < inputCount && !cursor.truncated; input++) {
+            cursor.skip(36); // outpoint hash and index
+            cursor.skip(cursor.readVarInt()); // script
+            cursor.skip(4); // sequence
+        }
+
+        uint64_t outputCount = cursor.readVarInt();
+        for(uint64_t output = 0; output < outputCount && !cursor.truncated; output++) {
+            cursor.skip(8); // value
+            uint64_t length = cursor.readVarInt();
+            if(scriptPos != NULL && output == scriptVout && !cursor.truncated) {
+                *scriptPos = cursor.pos;
+                *scriptLength = length;
+            }
+            cursor.skip(length);
+        }
+
+        if(segwit) {
+            for(uint64_t input = 0; input < inputCount && !cursor.truncated; input++) {
+                uint64_t witnessItems = cursor.readVarInt();
+                for(uint64_t witnessItem = 0; witnessItem < witnessItems && !cursor.truncated; witnessItem++) {
+                    cursor.skip(cursor.readVarInt());
+                }
+            }
+        }
+
+        cursor.skip(4); // locktime
+        return cursor.truncated ? 0 : cursor.pos;
+    }
+}
+
 VtcBlockIndexer::BlockReader::BlockReader(const string blocksDir) {
     
     this->blocksDir = blocksDir;
@@ -42,7 +131,11 @@ std::vector<unsigned char> VtcBlockIndexer::BlockReader::readRawBlockHeader(stri
     ss << blocksDir << "/" << fileName;
     ifstream blockFile(ss.str(), ios_base::in | ios_base::binary);
     vector<unsigned char> blockHeader(80);
+    blockFile.seekg(filePosition, ios_base::beg);
     blockFile.read(reinterpret_cast<char *>(&blockHeader[0]) , 80);
+    if(!blockFile) {
+        return {};
+    }
     blockFile.close();
     return blockHeader;
 }
@@ -67,7 +160,9 @@ VtcBlockIndexer::Block VtcBlockIndexer::BlockReader::readBlock(string fileName,
     blockFile.seekg(filePosition, ios_base::beg);
     vector<unsigned char> blockHeader(80);
     blockFile.read(reinterpret_cast<char *>(&blockHeader[0]) , 80);
-    fullBlock.blockHash = VtcBlockIndexer::Utility::hashToReverseHex(VtcBlockIndexer::Utility::sha256(VtcBlockIndexer::Utility::sha256(blockHeader)));
+    unsigned char blockHash[VtcBlockIndexer::Hash256::outputSize];
+    VtcBlockIndexer::Hash256::hash(blockHeader.data(), blockHeader.size(), blockHash);
+    fullBlock.blockHash = VtcBlockIndexer::Utility::hashToReverseHex(blockHash, sizeof(blockHash));
    
     blockFile.seekg(filePosition, ios_base::beg);
     
@@ -83,9 +178,38 @@ VtcBlockIndexer::Block VtcBlockIndexer::BlockReader::readBlock(string fileName,
         blockFile.seekg(filePosition+80, ios_base::beg);
         uint64_t txCount = VtcBlockIndexer::FileReader::readVarInt(blockFile);
         fullBlock.transactions = {};
+        fullBlock.transactions.reserve(txCount);
+
+        // Read all transactions first, then calculate the txids and witness txids in one batch
+        vector<vector<unsigned char>> txHashBytes(txCount);
+        vector<vector<unsigned char>> witnessBytes(txCount);
+        for(uint64_t tx = 0; tx < txCount; tx++) {
+            fullBlock.transactions.push_back(readTransaction(blockFile, txHashBytes[tx], witnessBytes[tx]));
+        }
+
+        vector<VtcBlockIndexer::Hash256::Input> inputs;
+        inputs.reserve(txCount * 2);
+        for(uint64_t tx = 0; tx < txCount; tx++) {
+            inputs.push_back({ txHashBytes[tx].data(), txHashBytes[tx].size() });
+        }
         for(uint64_t tx = 0; tx < txCount; tx++) {
-            VtcBlockIndexer::Transaction transaction = readTransaction(blockFile);
-            fullBlock.transactions.push_back(transaction);
+            if(!witnessBytes[tx].empty()) {
+                inputs.push_back({ witnessBytes[tx].data(), witnessBytes[tx].size() });
+            }
+        }
+        vector<unsigned char> hashes(inputs.size() * VtcBlockIndexer::Hash256::outputSize);
+        VtcBlockIndexer::Hash256::hashBatch(inputs, hashes.data());
+
+        const unsigned char* witnessHash = hashes.data() + txCount * VtcBlockIndexer::Hash256::outputSize;
+        for(uint64_t tx = 0; tx < txCount; tx++) {
+            VtcBlockIndexer::Transaction& transaction = fullBlock.transactions[tx];
+            transaction.txHash = VtcBlockIndexer::Utility::hashToReverseHex(&hashes[tx * VtcBlockIndexer::Hash256::outputSize], VtcBlockIndexer::Hash256::outputSize);
+            if(!witnessBytes[tx].empty()) {
+                transaction.txWitHash = VtcBlockIndexer::Utility::hashToReverseHex(witnessHash, VtcBlockIndexer::Hash256::outputSize);
+                witnessHash += VtcBlockIndexer::Hash256::outputSize;
+            } else {
+                transaction.txWitHash = transaction.txHash;
+            }
         }
     }
     uint64_t endPosBlock = blockFile.tellg();
@@ -95,6 +219,23 @@ VtcBlockIndexer::Block VtcBlockIndexer::BlockReader::readBlock(string fileName,
 }
 
 VtcBlockIndexer::Transaction VtcBlockIndexer::BlockReader::readTransaction(istream& blockFile) {
+    vector<unsigned char> txHashBytes;
+    vector<unsigned char> witnessBytes;
+    VtcBlockIndexer::Transaction transaction = readTransaction(blockFile, txHashBytes, witnessBytes);
+
+    unsigned char hash[VtcBlockIndexer::Hash256::outputSize];
+    VtcBlockIndexer::Hash256::hash(txHashBytes.data(), txHashBytes.size(), hash);
+    transaction.txHash = VtcBlockIndexer::Utility::hashToReverseHex(hash, sizeof(hash));
+    if(!witnessBytes.empty()) {
+        VtcBlockIndexer::Hash256::hash(witnessBytes.data(), witnessBytes.size(), hash);
+        transaction.txWitHash = VtcBlockIndexer::Utility::hashToReverseHex(hash, sizeof(hash));
+    } else {
+        transaction.txWitHash = transaction.txHash;
+    }
+    return transaction;
+}
+
+VtcBlockIndexer::Transaction VtcBlockIndexer::BlockReader::readTransaction(istream& blockFile, vector<unsigned char>& txHashBytes, vector<unsigned char>& witnessBytes) {
     bool segwit = false;
     
     VtcBlockIndexer::Transaction transaction;
@@ -165,7 +306,7 @@ VtcBlockIndexer::Transaction VtcBlockIndexer::BlockReader::readTransaction(istre
     // The tx hash must still be calculated over the original serialization format.
     // That's why this seems a bit overcomplex
     uint64_t txitxoLength = endPosOutputs-startPosInputs;
-    std::vector<unsigned char> txHashBytes(
+    txHashBytes.resize(
         4 + // version
         txitxoLength +
         4 // locktime
@@ -178,19 +319,91 @@ VtcBlockIndexer::Transaction VtcBlockIndexer::BlockReader::readTransaction(istre
     
     blockFile.seekg(endPosTx-4, ios_base::beg);
     blockFile.read(reinterpret_cast<char *>(&txHashBytes[0] + 4 + txitxoLength), sizeof(transaction.lockTime));
-    transaction.txHash = VtcBlockIndexer::Utility::hashToReverseHex(VtcBlockIndexer::Utility::sha256(VtcBlockIndexer::Utility::sha256(txHashBytes)));
 
+    witnessBytes.clear();
     if(segwit) {
         blockFile.seekg(startPosTx, ios_base::beg);
         uint64_t length = endPosTx-startPosTx;
-        std::vector<unsigned char> transactionBytes(length);
-        blockFile.read(reinterpret_cast<char *>(&transactionBytes[0]) , length);
-        transaction.txWitHash = VtcBlockIndexer::Utility::hashToReverseHex(VtcBlockIndexer::Utility::sha256(VtcBlockIndexer::Utility::sha256(transactionBytes)));
-    } else {
-        transaction.txWitHash = string(transaction.txHash);
+        witnessBytes.resize(length);
+        blockFile.read(reinterpret_cast<char *>(&witnessBytes[0]) , length);
     }
     blockFile.seekg(endPosTx, ios_base::beg);
 
     return transaction;
 }
-  
\ No newline at end of file
+
+vector<vector<unsigned char>> VtcBlockIndexer::BlockReader::readRawTransactions(const vector<VtcBlockIndexer::TransactionFilePosition>& positions) {
+    vector<vector<unsigned char>> rawTransactions(positions.size());
+
+    // Visit the transactions in file order
+    vector<size_t> order(positions.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&positions](size_t a, size_t b) {
+        if(positions[a].fileName != positions[b].fileName) return positions[a].fileName < positions[b].fileName;
+        return positions[a].filePosition < positions[b].filePosition;
+    });
+
+    int fd = -1;
+    string openFileName = "";
+    vector<unsigned char> window;
+    uint64_t windowStart = 0;
+    size_t windowLength = 0;
+
+    for(size_t index : order) {
+        const VtcBlockIndexer::TransactionFilePosition& position = positions[index];
+        if(fd < 0 || position.fileName != openFileName) {
+            if(fd >= 0) close(fd);
+            stringstream ss;
+            ss << blocksDir << "/" << position.fileName;
+            fd = open(ss.str().c_str(), O_RDONLY);
+            openFileName = position.fileName;
+            windowLength = 0;
+        }
+        if(fd < 0) continue;
+
+        size_t length = 0;
+        
+        // Try the previous read first, it may already contain this transaction
+        if(position.filePosition >= windowStart && position.filePosition < windowStart + windowLength) {
+            size_t offset = position.filePosition - windowStart;
+            length = parseRawTransaction(&window[offset], windowLength - offset, 0, NULL, NULL);
+        }
+
+        size_t readSize = rawReadWindow;
+        while(length == 0 && readSize <= maxRawTransactionSize) {
+            window.resize(readSize);
+            ssize_t bytesRead = pread(fd, &window[0], readSize, position.filePosition);
+            if(bytesRead <= 0) {
+                windowLength = 0;
+                break;
+            }
+            windowStart = position.filePosition;
+            windowLength = bytesRead;
+            length = parseRawTransaction(&window[0], windowLength, 0, NULL, NULL);
+
+            // End of file reached and the transaction still doesn't fit
+            if(length == 0 && windowLength < readSize) break;
+            readSize *= 4;
+        }
+
+        if(length > 0) {
+            size_t offset = position.filePosition - windowStart;
+            rawTransactions[index].assign(window.begin() + offset, window.begin() + offset + length);
+        }
+    }
+
+    if(fd >= 0) close(fd);
+    return rawTransactions;
+}
+
+bool VtcBlockIndexer::BlockReader::readOutputScript(const vector<unsigned char>& rawTransaction, uint32_t vout, vector<unsigned char>& script) {
+    if(rawTransaction.empty()) return false;
+    
+    size_t scriptPos = 0;
+    size_t scriptLength = 0;
+    size_t length = parseRawTransaction(&rawTransaction[0], rawTransaction.size(), vout, &scriptPos, &scriptLength);
+    if(length == 0 || scriptPos == 0) return false;
+    
+    script.assign(rawTransaction.begin() + scriptPos, rawTransaction.begin() + scriptPos + scriptLength);
+    return true;
+}
@@ -50,11 +50,31 @@ public:
      */
     Transaction readTransaction(std::istream& blockFile);
 
-    /** Reads a transaction from an open file stream
+    /** Reads the 80 byte header of the block at the file position. Returns an empty
+     * vector if it could not be read.
      */
     std::vector<unsigned char> readRawBlockHeader(std::string fileName, uint64_t filePosition);        
+
+    /** Reads the raw serialized bytes of a set of transactions from the block files.
+     * The positions are visited sorted by file and offset, so each block file is opened
+     * once and transactions close together are served from the same read. The result
+     * has the same order as the passed positions, with an empty vector for any 
+     * transaction that could not be read.
+     */
+    std::vector<std::vector<unsigned char>> readRawTransactions(const std::vector<TransactionFilePosition>& positions);
+
+    /** Extracts the output script of output vout from a raw serialized transaction
+     * without decoding (and hashing) the full transaction. Returns false if the
+     * transaction is malformed or has no such output.
+     */
+    static bool readOutputScript(const std::vector<unsigned char>& rawTransaction, uint32_t vout, std::vector<unsigned char>& script);
     
 private:
+    /** Reads a transaction from an open stream without hashing it. The serializations
+     * the txid and the witness txid are calculated over are stored in txHashBytes and
+     * witnessBytes (the latter is left empty for non-segwit transactions).
+     */
+    Transaction readTransaction(std::istream& blockFile, std::vector<unsigned char>& txHashBytes, std::vector<unsigned char>& witnessBytes);
 
     /** Directory containing the blocks
      */
@@ -19,6 +19,7 @@
 */
 #include "blockscanner.h"
 #include "utility.h"
+#include "hash256.h"
 #include <string.h>
 #include <memory>
 #include <sstream>
@@ -59,6 +60,11 @@ bool VtcBlockIndexer::BlockScanner::moveNext() {
     return std::equal(buffer.begin(), buffer.end(), VtcBlockIndexer::CoinParams::magic.begin());
 }
 
+bool VtcBlockIndexer::BlockScanner::seek(uint64_t filePosition) {
+    this->blockFileStream.seekg(filePosition, std::ios_base::beg);
+    return !this->blockFileStream.fail();
+}
+
 VtcBlockIndexer::ScannedBlock VtcBlockIndexer::BlockScanner::scanNextBlock() {
     VtcBlockIndexer::ScannedBlock block;
 
@@ -73,7 +79,9 @@ VtcBlockIndexer::ScannedBlock VtcBlockIndexer::BlockScanner::scanNextBlock() {
     vector<unsigned char> blockHeader(80);
     this->blockFileStream.read(reinterpret_cast<char *>(&blockHeader[0]) , 80);
 
-    block.blockHash = VtcBlockIndexer::Utility::hashToReverseHex(VtcBlockIndexer::Utility::sha256(VtcBlockIndexer::Utility::sha256(blockHeader)));
+    unsigned char blockHash[VtcBlockIndexer::Hash256::outputSize];
+    VtcBlockIndexer::Hash256::hash(blockHeader.data(), blockHeader.size(), blockHash);
+    block.blockHash = VtcBlockIndexer::Utility::hashToReverseHex(blockHash, sizeof(blockHash));
     vector<unsigned char> previousBlockHash(32);
     memcpy(&previousBlockHash[0], &blockHeader[4], 32);
     block.previousBlockHash =  VtcBlockIndexer::Utility::hashToReverseHex(previousBlockHash);
@@ -81,4 +89,39 @@ VtcBlockIndexer::ScannedBlock VtcBlockIndexer::BlockScanner::scanNextBlock() {
     this->blockFileStream.seekg(blockSize - 80, std::ios_base::cur);
 
     return block;
-}
\ No newline at end of file
+}
+
+std::vector<VtcBlockIndexer::ScannedBlock> VtcBlockIndexer::BlockScanner::scanAllBlocks() {
+    std::vector<VtcBlockIndexer::ScannedBlock> blocks;
+    std::vector<unsigned char> headers;
+
+    while(moveNext()) {
+        VtcBlockIndexer::ScannedBlock block;
+
+        uint32_t blockSize;
+        this->blockFileStream.read(reinterpret_cast<char *>(&blockSize), sizeof(blockSize));
+
+        block.fileName = this->blockFileName;
+        block.filePosition = this->blockFileStream.tellg();
+
+        headers.resize(headers.size() + 80);
+        this->blockFileStream.read(reinterpret_cast<char *>(&headers[headers.size() - 80]), 80);
+        this->blockFileStream.seekg(blockSize - 80, std::ios_base::cur);
+
+        blocks.push_back(block);
+    }
+
+    std::vector<VtcBlockIndexer::Hash256::Input> inputs(blocks.size());
+    for(size_t i = 0; i < blocks.size(); i++) {
+        inputs[i] = { &headers[i * 80], 80 };
+    }
+    std::vector<unsigned char> hashes(blocks.size() * VtcBlockIndexer::Hash256::outputSize);
+    VtcBlockIndexer::Hash256::hashBatch(inputs, hashes.data());
+
+    for(size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].blockHash = VtcBlockIndexer::Utility::hashToReverseHex(&hashes[i * VtcBlockIndexer::Hash256::outputSize], VtcBlockIndexer::Hash256::outputSize);
+        blocks[i].previousBlockHash = VtcBlockIndexer::Utility::hashToReverseHex(&headers[i * 80 + 4], 32);
+    }
+
+    return blocks;
+}
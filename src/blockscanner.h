@@ -56,6 +56,11 @@ public:
      */
     bool moveNext();
 
+    /** Moves the file pointer to the given position, which should be the start
+     *  of a block's magic string. Returns false if the file is shorter.
+     */
+    bool seek(uint64_t filePosition);
+
     /** Scans the next block. Scanning only reads the header and returns a
      *  ScannedBlock struct that contains the file the block was found in,
      *  the start position and length inside that file, its hash and 
@@ -64,6 +69,11 @@ public:
      */
     ScannedBlock scanNextBlock();
 
+    /** Scans all remaining blocks in the file. The headers are read first and
+     *  hashed in one batch, which is faster than scanning block by block.
+     */
+    std::vector<ScannedBlock> scanAllBlocks();
+
     /** Closes the file
      */
     bool close();
@@ -0,0 +1,822 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "electrumserver.h"
+#include "blockindexer.h"
+#include "utility.h"
+#include "hash256.h"
+#include "leveldb/write_batch.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace
+{
+    const char* serverVersion = "VtcBlockIndexer 0.1";
+    const char* protocolVersion = "1.4";
+
+    // How often the event loops look for new blocks and mempool changes to notify
+    const int notificationIntervalMs = 500;
+
+    // A connection stops being read while this much output is waiting to be sent
+    const size_t maxPendingOutput = 1024 * 1024;
+
+    // Longest line (request or batch) a client can send
+    const size_t maxRequestSize = 1024 * 1024;
+
+    // Most script hashes a single connection can subscribe to
+    const size_t maxSubscriptions = 20000;
+
+    // Most blocks between two looks at the tip for which only the addresses the blocks
+    // touched are read again, rather than every subscription
+    const long long maxIncrementalBlocks = 20;
+
+    // JSON-RPC error codes
+    const int parseError = -32700;
+    const int invalidRequest = -32600;
+    const int methodNotFound = -32601;
+    const int invalidParams = -32602;
+
+    json errorResponse(const json& id, int code, const string& message) {
+        json response;
+        response["jsonrpc"] = "2.0";
+        response["error"] = { { "code", code }, { "message", message } };
+        response["id"] = id;
+        return response;
+    }
+
+    /** Returns the positional or named parameter of a request, or null if it was not passed */
+    json getParam(const json& request, size_t index, const string& name) {
+        if(request.count("params") == 0) return nullptr;
+        const json& params = request["params"];
+        if(params.is_array() && index < params.size()) return params[index];
+        if(params.is_object() && params.count(name) != 0) return params[name];
+        return nullptr;
+    }
+
+    bool isScriptHash(const json& param) {
+        if(!param.is_string()) return false;
+        const string& scriptHash = param.get_ref<const string&>();
+        return scriptHash.size() == 64 && all_of(scriptHash.begin(), scriptHash.end(), [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+    }
+
+    string spentKey(const string& txid, uint32_t vout) {
+        stringstream ss;
+        ss << "txo-" << txid << "-" << setw(8) << setfill('0') << vout << "-spent";
+        return ss.str();
+    }
+
+    string bareKeyKey(const string& txid, uint32_t vout) {
+        stringstream ss;
+        ss << "txo-" << txid << "-" << setw(8) << setfill('0') << vout << "-barekey";
+        return ss.str();
+    }
+}
+
+VtcBlockIndexer::ElectrumServer::ElectrumServer(const shared_ptr<leveldb::DB> db, const shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor, string blocksDir) {
+    this->db = db;
+    this->mempoolMonitor = mempoolMonitor;
+    this->blockReader.reset(new VtcBlockIndexer::BlockReader(blocksDir));
+}
+
+void VtcBlockIndexer::ElectrumServer::run(int port, size_t threads) {
+    // Until the outputs of an older index are marked, it would serve them wrong
+    backfillBareKeys();
+
+    int listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if(listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        cerr << "Electrum server could not listen on port " << port << endl;
+        if(listenFd >= 0) close(listenFd);
+        return;
+    }
+
+    for(size_t i = 0; i < max<size_t>(threads, 1); i++) {
+        unique_ptr<EventLoop> loop(new EventLoop());
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loop->tipVersion = VtcBlockIndexer::BlockIndexer::getTipVersion();
+        loop->tipHeight = -1;
+        loop->mempool = mempoolMonitor->getSnapshot();
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = loop->wakeFd;
+        epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &event);
+        std::thread(&VtcBlockIndexer::ElectrumServer::runLoop, this, loop.get()).detach();
+        loops.push_back(std::move(loop));
+    }
+    cout << "Electrum server listening on port " << port << endl;
+    std::thread(&VtcBlockIndexer::ElectrumServer::backfillScriptHashes, this).detach();
+
+    // Hand the connections to the event loops in turn
+    size_t nextLoop = 0;
+    while(true) {
+        int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            if(errno != EINTR && errno != ECONNABORTED) {
+                // Likely out of file descriptors, give the loops a moment to close some
+                this_thread::sleep_for(chrono::milliseconds(100));
+            }
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        EventLoop& loop = *loops[nextLoop++ % loops.size()];
+        {
+            lock_guard<mutex> lock(loop.pendingMutex);
+            loop.pending.push_back(fd);
+        }
+        uint64_t wake = 1;
+        if(write(loop.wakeFd, &wake, sizeof(wake)) < 0) {
+            cerr << "Could not wake Electrum event loop" << endl;
+        }
+    }
+}
+
+void VtcBlockIndexer::ElectrumServer::runLoop(EventLoop* loop) {
+    vector<epoll_event> events(256);
+    while(true) {
+        int count = epoll_wait(loop->epollFd, events.data(), events.size(), notificationIntervalMs);
+        for(int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if(fd == loop->wakeFd) {
+                adoptPending(*loop);
+                continue;
+            }
+
+            auto it = loop->connections.find(fd);
+            if(it == loop->connections.end()) continue;
+            if((events[i].events & (EPOLLERR | EPOLLHUP)) != 0 || !serve(*loop, *it->second, (events[i].events & EPOLLIN) != 0)) {
+                closeConnection(*loop, fd);
+            }
+        }
+        notifySubscriptions(*loop);
+    }
+}
+
+void VtcBlockIndexer::ElectrumServer::adoptPending(EventLoop& loop) {
+    uint64_t wakes;
+    while(read(loop.wakeFd, &wakes, sizeof(wakes)) > 0) {}
+
+    vector<int> pending;
+    {
+        lock_guard<mutex> lock(loop.pendingMutex);
+        pending.swap(loop.pending);
+    }
+    for(int fd : pending) {
+        unique_ptr<Connection> connection(new Connection());
+        connection->fd = fd;
+        connection->outputOffset = 0;
+        connection->events = EPOLLIN;
+        connection->headersSubscribed = false;
+        connection->headerHeight = -1;
+        epoll_event event = {};
+        event.events = connection->events;
+        event.data.fd = fd;
+        if(epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        loop.connections[fd] = std::move(connection);
+    }
+}
+
+void VtcBlockIndexer::ElectrumServer::closeConnection(EventLoop& loop, int fd) {
+    epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    loop.connections.erase(fd);
+}
+
+bool VtcBlockIndexer::ElectrumServer::serve(EventLoop& loop, Connection& connection, bool readable) {
+    if(readable) {
+        char buffer[16384];
+        while(true) {
+            ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if(received > 0) {
+                connection.input.append(buffer, received);
+                if(connection.input.size() > maxRequestSize + maxPendingOutput) break;
+            } else if(received == 0) {
+                return false;
+            } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else if(errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+    // Answer the pipelined requests in order, until the client stops reading responses
+    size_t position = 0;
+    while(connection.output.size() - connection.outputOffset < maxPendingOutput) {
+        size_t end = connection.input.find('\n', position);
+        if(end == string::npos) break;
+        string line = connection.input.substr(position, end - position);
+        position = end + 1;
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty()) continue;
+
+        string response = handleLine(loop, connection, line);
+        if(!response.empty()) {
+            connection.output += response;
+            connection.output += '\n';
+        }
+    }
+    connection.input.erase(0, position);
+    if(connection.input.size() > maxRequestSize && connection.input.find('\n') == string::npos) {
+        return false;
+    }
+
+    return flush(loop, connection);
+}
+
+bool VtcBlockIndexer::ElectrumServer::flush(EventLoop& loop, Connection& connection) {
+    while(connection.outputOffset < connection.output.size()) {
+        ssize_t sent = send(connection.fd, connection.output.data() + connection.outputOffset, connection.output.size() - connection.outputOffset, MSG_NOSIGNAL);
+        if(sent > 0) {
+            connection.outputOffset += sent;
+        } else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if(sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    if(connection.outputOffset == connection.output.size()) {
+        connection.output.clear();
+        connection.outputOffset = 0;
+    }
+
+    // Wait for the socket to take more output, and stop reading while too much is waiting
+    size_t pending = connection.output.size() - connection.outputOffset;
+    uint32_t events = (pending < maxPendingOutput ? EPOLLIN : 0) | (pending > 0 ? EPOLLOUT : 0);
+    if(events != connection.events) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = connection.fd;
+        epoll_ctl(loop.epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+
+    // Requests left unanswered while the output was full can be answered now
+    if(pending == 0 && connection.input.find('\n') != string::npos) {
+        return serve(loop, connection, false);
+    }
+    return true;
+}
+
+string VtcBlockIndexer::ElectrumServer::handleLine(EventLoop& loop, Connection& connection, const string& line) {
+    json message;
+    try {
+        message = json::parse(line);
+    } catch(const exception& e) {
+        return errorResponse(nullptr, parseError, "Invalid JSON").dump();
+    }
+
+    if(message.is_array()) {
+        json responses = json::array();
+        for(const json& request : message) {
+            json response = handleRequest(loop, connection, request);
+            if(!response.is_null()) responses.push_back(response);
+        }
+        return responses.empty() ? "" : responses.dump();
+    }
+
+    json response = handleRequest(loop, connection, message);
+    return response.is_null() ? "" : response.dump();
+}
+
+json VtcBlockIndexer::ElectrumServer::handleRequest(EventLoop& loop, Connection& connection, const json& request) {
+    if(!request.is_object() || request.count("method") == 0 || !request["method"].is_string()) {
+        return errorResponse(request.is_object() && request.count("id") != 0 ? request["id"] : json(nullptr), invalidRequest, "Invalid request");
+    }
+    // Requests without an id are notifications, which are not answered
+    if(request.count("id") == 0) return nullptr;
+
+    const json& id = request["id"];
+    const string method = request["method"].get<string>();
+    json result;
+    try {
+        if(method == "server.version") {
+            result = { serverVersion, protocolVersion };
+        } else if(method == "server.ping") {
+            result = nullptr;
+        } else if(method == "blockchain.headers.subscribe") {
+            leveldb::ReadOptions readOptions;
+            result = readTip(readOptions);
+            connection.headersSubscribed = true;
+            if(!result.is_null()) connection.headerHeight = result["height"].get<long long>();
+        } else if(method.compare(0, 22, "blockchain.scripthash.") == 0) {
+            json scriptHash = getParam(request, 0, "scripthash");
+            if(!isScriptHash(scriptHash)) {
+                return errorResponse(id, invalidParams, "Expected a script hash");
+            }
+            const string& hash = scriptHash.get_ref<const string&>();
+
+            if(method == "blockchain.scripthash.unsubscribe") {
+                result = connection.subscriptions.erase(hash) > 0;
+            } else if(method == "blockchain.scripthash.subscribe") {
+                if(connection.subscriptions.size() >= maxSubscriptions && connection.subscriptions.count(hash) == 0) {
+                    return errorResponse(id, invalidRequest, "Too many subscriptions");
+                }
+
+                // Keep the confirmed history, so the notifications only read what changed
+                const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
+                Subscription& subscription = connection.subscriptions[hash];
+                subscription.tipVersion = VtcBlockIndexer::BlockIndexer::getTipVersion();
+                leveldb::ReadOptions readOptions;
+                readOptions.snapshot = this->db->GetSnapshot();
+                subscription.address = resolveScriptHash(hash, &readOptions, *mempool);
+                subscription.confirmed = subscription.address.empty() ? ConfirmedHistory() : readConfirmed(subscription.address, readOptions);
+                this->db->ReleaseSnapshot(readOptions.snapshot);
+
+                subscription.status = statusHash(addMempool(subscription.confirmed, subscription.address, *mempool));
+                result = subscription.status.empty() ? json(nullptr) : json(subscription.status);
+            } else if(method == "blockchain.scripthash.get_balance" || method == "blockchain.scripthash.get_history" || method == "blockchain.scripthash.listunspent") {
+                AddressState state = getAddressState(connection, hash);
+                if(method == "blockchain.scripthash.get_balance") {
+                    result = { { "confirmed", state.confirmed }, { "unconfirmed", state.unconfirmed } };
+                } else if(method == "blockchain.scripthash.get_history") {
+                    result = json::array();
+                    for(const auto& entry : state.history) {
+                        result.push_back({ { "tx_hash", entry.first }, { "height", entry.second } });
+                    }
+                } else {
+                    result = json::array();
+                    for(const Utxo& utxo : state.unspent) {
+                        result.push_back({ { "tx_hash", utxo.txid }, { "tx_pos", utxo.vout }, { "height", utxo.height }, { "value", utxo.value } });
+                    }
+                }
+            } else {
+                return errorResponse(id, methodNotFound, "Unknown method " + method);
+            }
+        } else {
+            return errorResponse(id, methodNotFound, "Unknown method " + method);
+        }
+    } catch(const exception& e) {
+        return errorResponse(id, invalidParams, e.what());
+    }
+
+    json response;
+    response["jsonrpc"] = "2.0";
+    response["result"] = result;
+    response["id"] = id;
+    return response;
+}
+
+VtcBlockIndexer::ElectrumServer::AddressState VtcBlockIndexer::ElectrumServer::getAddressState(Connection& connection, const string& scriptHash) {
+    const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
+    auto subscription = connection.subscriptions.find(scriptHash);
+    if(subscription != connection.subscriptions.end() && !subscription->second.address.empty() && subscription->second.tipVersion == VtcBlockIndexer::BlockIndexer::getTipVersion()) {
+        return addMempool(subscription->second.confirmed, subscription->second.address, *mempool);
+    }
+
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = this->db->GetSnapshot();
+    string address = resolveScriptHash(scriptHash, &readOptions, *mempool);
+    ConfirmedHistory confirmed;
+    if(!address.empty()) {
+        confirmed = readConfirmed(address, readOptions);
+    }
+    this->db->ReleaseSnapshot(readOptions.snapshot);
+    return addMempool(confirmed, address, *mempool);
+}
+
+string VtcBlockIndexer::ElectrumServer::resolveScriptHash(const string& scriptHash, const leveldb::ReadOptions* readOptions, const VtcBlockIndexer::MempoolSnapshot& mempool) {
+    string address;
+    if(readOptions != nullptr && this->db->Get(*readOptions, "scripthash-" + scriptHash, &address).ok()) {
+        return address;
+    }
+    return mempool.scriptHashAddress(scriptHash);
+}
+
+VtcBlockIndexer::ElectrumServer::ConfirmedHistory VtcBlockIndexer::ElectrumServer::readConfirmed(const string& address, const leveldb::ReadOptions& readOptions) {
+    vector<Utxo> txos;
+    string start(address + "-txo-00000001");
+    string limit(address + "-txo-99999999");
+    leveldb::Iterator* it = this->db->NewIterator(readOptions);
+    for (it->Seek(start);
+            it->Valid() && it->key().ToString() < limit;
+            it->Next()) {
+        string txo = it->value().ToString();
+        txos.push_back({ txo.substr(0,64), (uint32_t)stoul(txo.substr(64,8)), stoll(txo.substr(72,8)), stoll(txo.substr(80)) });
+    }
+    assert(it->status().ok());  // Check for any errors found during the scan
+    delete it;
+
+    // Look the spends up in key order, and each spending block's height once.
+    // Pay-to-pubkey and multisig outputs are indexed under the address of the key,
+    // but do not pay to the script hash that was asked for, so they are left out.
+    vector<string> spentKeys;
+    vector<size_t> spentOrder(txos.size());
+    for(size_t i = 0; i < txos.size(); i++) {
+        spentKeys.push_back(spentKey(txos[i].txid, txos[i].vout));
+        spentOrder[i] = i;
+    }
+    sort(spentOrder.begin(), spentOrder.end(), [&spentKeys](size_t a, size_t b) { return spentKeys[a] < spentKeys[b]; });
+
+    ConfirmedHistory history;
+    vector<bool> spent(txos.size(), false);
+    vector<bool> bareKey(txos.size(), false);
+    unordered_map<string, long long> blockHeights;
+    for(size_t i : spentOrder) {
+        string marker;
+        if(this->db->Get(readOptions, bareKeyKey(txos[i].txid, txos[i].vout), &marker).ok()) {
+            bareKey[i] = true;
+            continue;
+        }
+
+        string spendingTx;
+        if(!this->db->Get(readOptions, spentKeys[i], &spendingTx).ok() || spendingTx.size() < 66) continue;
+        spent[i] = true;
+
+        const string blockHash = spendingTx.substr(0, 64);
+        auto blockHeight = blockHeights.find(blockHash);
+        if(blockHeight == blockHeights.end()) {
+            string height;
+            long long spendHeight = txos[i].height;
+            if(this->db->Get(readOptions, "block-hash-" + blockHash, &height).ok()) {
+                spendHeight = stoll(height);
+            }
+            blockHeight = blockHeights.insert({ blockHash, spendHeight }).first;
+        }
+        history.transactions.push_back({ blockHeight->second, spendingTx.substr(65) });
+    }
+
+    for(size_t i = 0; i < txos.size(); i++) {
+        if(bareKey[i]) continue;
+        history.transactions.push_back({ txos[i].height, txos[i].txid });
+        if(!spent[i]) history.unspent.push_back(txos[i]);
+    }
+    sort(history.transactions.begin(), history.transactions.end());
+    history.transactions.erase(unique(history.transactions.begin(), history.transactions.end()), history.transactions.end());
+    return history;
+}
+
+VtcBlockIndexer::ElectrumServer::AddressState VtcBlockIndexer::ElectrumServer::addMempool(const ConfirmedHistory& confirmed, const string& address, const VtcBlockIndexer::MempoolSnapshot& mempool) {
+    AddressState state = { {}, {}, 0, 0 };
+    unordered_set<string> confirmedTxids;
+    for(const auto& transaction : confirmed.transactions) {
+        state.history.push_back({ transaction.second, transaction.first });
+        confirmedTxids.insert(transaction.second);
+    }
+
+    // Right after a block is indexed its transactions can still be in the mempool
+    // snapshot for a moment, those are already in the confirmed history
+    map<string, long long> mempoolTransactions;
+    for(const Utxo& utxo : confirmed.unspent) {
+        state.confirmed += utxo.value;
+        string spender = mempool.outpointSpend(utxo.txid, utxo.vout);
+        if(!spender.empty() && confirmedTxids.count(spender) == 0) {
+            state.unconfirmed -= utxo.value;
+            mempoolTransactions[spender] = 0;
+        } else {
+            state.unspent.push_back(utxo);
+        }
+    }
+
+    for(const VtcBlockIndexer::TransactionOutput& txo : mempool.getTxos(address)) {
+        if(confirmedTxids.count(txo.txHash) != 0) continue;
+        VtcBlockIndexer::ScriptTemplate type = VtcBlockIndexer::ScriptSolver::classify(txo.script).type;
+        if(type == VtcBlockIndexer::ScriptTemplate::PubKey || type == VtcBlockIndexer::ScriptTemplate::MultiSig) continue;
+        state.unconfirmed += txo.value;
+        mempoolTransactions[txo.txHash] = 0;
+        string spender = mempool.outpointSpend(txo.txHash, txo.index);
+        if(!spender.empty()) {
+            state.unconfirmed -= txo.value;
+            mempoolTransactions[spender] = 0;
+        } else {
+            state.unspent.push_back({ txo.txHash, txo.index, 0, (long long)txo.value });
+        }
+    }
+
+    // Unconfirmed transactions are at height -1 if they spend unconfirmed outputs, 0 otherwise
+    for(auto& transaction : mempoolTransactions) {
+        shared_ptr<const VtcBlockIndexer::Transaction> tx = mempool.getTransaction(transaction.first);
+        if(tx) {
+            for(const VtcBlockIndexer::TransactionInput& txi : tx->inputs) {
+                if(!txi.coinbase && mempool.hasTransaction(txi.txHash)) {
+                    transaction.second = -1;
+                    break;
+                }
+            }
+        }
+        state.history.push_back({ transaction.first, transaction.second });
+    }
+    return state;
+}
+
+string VtcBlockIndexer::ElectrumServer::statusHash(const AddressState& state) {
+    if(state.history.empty()) return "";
+
+    string history;
+    for(const auto& entry : state.history) {
+        history += entry.first + ":" + std::to_string(entry.second) + ":";
+    }
+    unsigned char hash[VtcBlockIndexer::Hash256::outputSize];
+    VtcBlockIndexer::Hash256::sha256(reinterpret_cast<const unsigned char*>(history.data()), history.size(), hash);
+    return VtcBlockIndexer::Utility::hashToHex(hash, sizeof(hash));
+}
+
+json VtcBlockIndexer::ElectrumServer::readTip(const leveldb::ReadOptions& readOptions) {
+    string highestBlock;
+    if(!this->db->Get(readOptions, "highestblock", &highestBlock).ok()) {
+        return nullptr;
+    }
+    long long height = stoll(highestBlock);
+
+    stringstream blockKey;
+    blockKey << "block-filePosition-" << setw(8) << setfill('0') << height;
+    string filePosition;
+    if(!this->db->Get(readOptions, blockKey.str(), &filePosition).ok() || filePosition.size() != 24) {
+        return nullptr;
+    }
+    vector<unsigned char> header = blockReader->readRawBlockHeader(filePosition.substr(0,12), stoull(filePosition.substr(12,12)));
+    if(header.empty()) {
+        return nullptr;
+    }
+    return { { "height", height }, { "hex", VtcBlockIndexer::Utility::hashToHex(header) } };
+}
+
+bool VtcBlockIndexer::ElectrumServer::collectTouched(EventLoop& loop, const leveldb::ReadOptions& readOptions, long long height, unordered_set<string>& addresses, unordered_set<string>& spentKeys) {
+    if(loop.tipHeight < 0 || height < loop.tipHeight || height - loop.tipHeight > maxIncrementalBlocks) {
+        return false;
+    }
+
+    for(long long blockHeight = loop.tipHeight; blockHeight <= height; blockHeight++) {
+        stringstream blockKey;
+        blockKey << "block-" << setw(8) << setfill('0') << blockHeight;
+        string blockHash;
+        if(!this->db->Get(readOptions, blockKey.str(), &blockHash).ok()) {
+            return false;
+        }
+        // The block the loop last saw must still be there, otherwise there was a reorg
+        if(blockHeight == loop.tipHeight) {
+            if(blockHash != loop.tipHash) return false;
+            continue;
+        }
+
+        // The block's undo keys point at the address TXO keys and spent keys it wrote
+        leveldb::Iterator* it = this->db->NewIterator(readOptions);
+        for (it->Seek(blockHash + "-txo-00000001");
+                it->Valid() && it->key().ToString() < blockHash + "-txo-99999999";
+                it->Next()) {
+            string txoKey = it->value().ToString();
+            if(txoKey.size() > 13) addresses.insert(txoKey.substr(0, txoKey.size() - 13));
+        }
+        for (it->Seek(blockHash + "-txospent-00000001");
+                it->Valid() && it->key().ToString() < blockHash + "-txospent-99999999";
+                it->Next()) {
+            spentKeys.insert(it->value().ToString());
+        }
+        assert(it->status().ok());  // Check for any errors found during the scan
+        delete it;
+    }
+    return true;
+}
+
+void VtcBlockIndexer::ElectrumServer::notifySubscriptions(EventLoop& loop) {
+    const uint64_t tipVersion = VtcBlockIndexer::BlockIndexer::getTipVersion();
+    const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
+    if(tipVersion == loop.tipVersion && mempool == loop.mempool) return;
+    const bool tipChanged = (tipVersion != loop.tipVersion);
+
+    // Only the subscriptions the mempool change involves have to be looked at again
+    const bool mempoolChanged = (mempool != loop.mempool);
+    unordered_set<string> mempoolAddresses;
+    unordered_set<string> mempoolOutpoints;
+    if(mempoolChanged) {
+        mempool->collectChanges(*loop.mempool, mempoolAddresses, mempoolOutpoints);
+    }
+
+    leveldb::ReadOptions readOptions;
+    readOptions.snapshot = this->db->GetSnapshot();
+
+    json header;
+    bool incremental = false;
+    unordered_set<string> touchedAddresses;
+    unordered_set<string> touchedSpentKeys;
+    if(tipChanged) {
+        header = readTip(readOptions);
+        long long height = header.is_null() ? -1 : header["height"].get<long long>();
+        incremental = collectTouched(loop, readOptions, height, touchedAddresses, touchedSpentKeys);
+
+        // The highest block can still be being indexed, so next time start from the one before it
+        loop.tipHeight = height - 1;
+        loop.tipHash.clear();
+        stringstream blockKey;
+        blockKey << "block-" << setw(8) << setfill('0') << loop.tipHeight;
+        if(loop.tipHeight < 0 || !this->db->Get(readOptions, blockKey.str(), &loop.tipHash).ok()) {
+            loop.tipHeight = -1;
+        }
+    }
+
+    vector<int> failed;
+    for(auto& connectionEntry : loop.connections) {
+        Connection& connection = *connectionEntry.second;
+        bool notified = false;
+
+        if(tipChanged && connection.headersSubscribed && !header.is_null() && header["height"].get<long long>() != connection.headerHeight) {
+            connection.headerHeight = header["height"].get<long long>();
+            json notification = { { "jsonrpc", "2.0" }, { "method", "blockchain.headers.subscribe" }, { "params", json::array({ header }) } };
+            connection.output += notification.dump() + "\n";
+            notified = true;
+        }
+
+        for(auto& subscriptionEntry : connection.subscriptions) {
+            Subscription& subscription = subscriptionEntry.second;
+            bool changed = false;
+            if(subscription.address.empty()) {
+                // Not seen before, look again now it might be in a block or the mempool
+                subscription.address = resolveScriptHash(subscriptionEntry.first, tipChanged ? &readOptions : nullptr, *mempool);
+                if(subscription.address.empty()) continue;
+                subscription.confirmed = readConfirmed(subscription.address, readOptions);
+                subscription.tipVersion = tipVersion;
+                changed = true;
+            } else if(subscription.tipVersion != tipVersion) {
+                bool touched = !incremental || touchedAddresses.count(subscription.address) != 0;
+                for(size_t i = 0; !touched && i < subscription.confirmed.unspent.size(); i++) {
+                    const Utxo& utxo = subscription.confirmed.unspent[i];
+                    touched = touchedSpentKeys.count(spentKey(utxo.txid, utxo.vout)) != 0;
+                }
+                if(touched) {
+                    subscription.confirmed = readConfirmed(subscription.address, readOptions);
+                    changed = true;
+                }
+                subscription.tipVersion = tipVersion;
+            }
+
+            if(!changed && mempoolChanged) {
+                changed = mempoolAddresses.count(subscription.address) != 0;
+                for(size_t i = 0; !changed && !mempoolOutpoints.empty() && i < subscription.confirmed.unspent.size(); i++) {
+                    const Utxo& utxo = subscription.confirmed.unspent[i];
+                    changed = mempoolOutpoints.count(VtcBlockIndexer::MempoolSnapshot::outpointKey(utxo.txid, utxo.vout)) != 0;
+                }
+            }
+            if(!changed) continue;
+
+            string status = statusHash(addMempool(subscription.confirmed, subscription.address, *mempool));
+            if(status != subscription.status) {
+                subscription.status = status;
+                json notification = { { "jsonrpc", "2.0" }, { "method", "blockchain.scripthash.subscribe" }, { "params", json::array({ subscriptionEntry.first, status.empty() ? json(nullptr) : json(status) }) } };
+                connection.output += notification.dump() + "\n";
+                notified = true;
+            }
+        }
+
+        if(notified && !flush(loop, connection)) {
+            failed.push_back(connection.fd);
+        }
+    }
+    this->db->ReleaseSnapshot(readOptions.snapshot);
+
+    loop.tipVersion = tipVersion;
+    loop.mempool = mempool;
+    for(int fd : failed) {
+        closeConnection(loop, fd);
+    }
+}
+
+void VtcBlockIndexer::ElectrumServer::backfillScriptHashes() {
+    string backfilled;
+    if(this->db->Get(leveldb::ReadOptions(), "scripthashes-backfilled", &backfilled).ok()) {
+        return;
+    }
+    cout << "Mapping the script hashes of the indexed addresses for the Electrum server..." << endl;
+
+    // The first TXO key of every address, i.e. <address>-txo-00000001. The block hash
+    // prefixed keys (the TXOs to undo on a reorg) match as well, but are no address.
+    const string firstTxoSuffix = "-txo-00000001";
+    leveldb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+    leveldb::WriteBatch batch;
+    size_t batched = 0;
+    uint64_t mapped = 0;
+    leveldb::Iterator* it = this->db->NewIterator(readOptions);
+    for(it->SeekToFirst(); it->Valid(); it->Next()) {
+        leveldb::Slice key = it->key();
+        if(key.size() <= firstTxoSuffix.size() || memcmp(key.data() + key.size() - firstTxoSuffix.size(), firstTxoSuffix.data(), firstTxoSuffix.size()) != 0) continue;
+
+        string address(key.data(), key.size() - firstTxoSuffix.size());
+        vector<unsigned char> addressScript = VtcBlockIndexer::Utility::addressToScript(address);
+        if(addressScript.empty()) continue;
+
+        batch.Put("scripthash-" + VtcBlockIndexer::Utility::scriptHash(addressScript), address);
+        mapped++;
+        if(++batched == 10000) {
+            this->db->Write(leveldb::WriteOptions(), &batch);
+            batch.Clear();
+            batched = 0;
+        }
+    }
+    assert(it->status().ok());  // Check for any errors found during the scan
+    delete it;
+
+    batch.Put("scripthashes-backfilled", "1");
+    this->db->Write(leveldb::WriteOptions(), &batch);
+    cout << "Mapped the script hashes of " << mapped << " addresses" << endl;
+}
+
+void VtcBlockIndexer::ElectrumServer::backfillBareKeys() {
+    string version;
+    if(this->db->Get(leveldb::ReadOptions(), "index-version", &version).ok() && stoi(version) >= VtcBlockIndexer::BlockIndexer::indexVersion) {
+        return;
+    }
+    cout << "Marking the pay-to-pubkey and bare multisig outputs in the index for the Electrum server..." << endl;
+
+    // These outputs are only filed under P2PKH addresses, so only the TXOs of those
+    // need their script read. The block hash prefixed keys match no address.
+    const string txoInfix = "-txo-";
+    const size_t txoSuffixLength = txoInfix.size() + 8;
+    leveldb::ReadOptions readOptions;
+    readOptions.fill_cache = false;
+    string lastAddress;
+    bool lastAddressIsKeyHash = false;
+    vector<pair<string, uint32_t>> outpoints;
+    vector<VtcBlockIndexer::TransactionFilePosition> positions;
+    uint64_t marked = 0;
+
+    auto markOutpoints = [&]() {
+        vector<vector<unsigned char>> rawTransactions = blockReader->readRawTransactions(positions);
+        leveldb::WriteBatch batch;
+        for(size_t i = 0; i < outpoints.size(); i++) {
+            vector<unsigned char> script;
+            if(!VtcBlockIndexer::BlockReader::readOutputScript(rawTransactions[i], outpoints[i].second, script)) continue;
+            VtcBlockIndexer::ScriptTemplate type = VtcBlockIndexer::ScriptSolver::classify(script).type;
+            if(type == VtcBlockIndexer::ScriptTemplate::PubKey || type == VtcBlockIndexer::ScriptTemplate::MultiSig) {
+                batch.Put(bareKeyKey(outpoints[i].first, outpoints[i].second), "1");
+                marked++;
+            }
+        }
+        this->db->Write(leveldb::WriteOptions(), &batch);
+        outpoints.clear();
+        positions.clear();
+    };
+
+    leveldb::Iterator* it = this->db->NewIterator(readOptions);
+    for(it->SeekToFirst(); it->Valid(); it->Next()) {
+        leveldb::Slice key = it->key();
+        if(key.size() <= txoSuffixLength || memcmp(key.data() + key.size() - txoSuffixLength, txoInfix.data(), txoInfix.size()) != 0) continue;
+
+        string address(key.data(), key.size() - txoSuffixLength);
+        if(address != lastAddress) {
+            vector<unsigned char> addressScript = VtcBlockIndexer::Utility::addressToScript(address);
+            lastAddressIsKeyHash = addressScript.size() == 25 && addressScript[0] == 0x76;
+            lastAddress = address;
+        }
+        if(!lastAddressIsKeyHash || it->value().size() < 72) continue;
+
+        string txo = it->value().ToString();
+        string filePosition;
+        if(!this->db->Get(readOptions, "tx-filePosition-" + txo.substr(0,64), &filePosition).ok() || filePosition.size() != 24) continue;
+        outpoints.push_back({ txo.substr(0,64), (uint32_t)stoul(txo.substr(64,8)) });
+        positions.push_back({ filePosition.substr(0,12), stoull(filePosition.substr(12,12)) });
+        if(outpoints.size() == 10000) {
+            markOutpoints();
+        }
+    }
+    assert(it->status().ok());  // Check for any errors found during the scan
+    delete it;
+    markOutpoints();
+
+    this->db->Put(leveldb::WriteOptions(), "index-version", std::to_string(VtcBlockIndexer::BlockIndexer::indexVersion));
+    cout << "Marked " << marked << " pay-to-pubkey and bare multisig outputs" << endl;
+}
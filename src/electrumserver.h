@@ -0,0 +1,185 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ELECTRUMSERVER_H_INCLUDED
+#define ELECTRUMSERVER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include "leveldb/db.h"
+#include "mempoolmonitor.h"
+#include "blockreader.h"
+#include "json.hpp"
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The ElectrumServer class serves the Electrum protocol (JSON-RPC over TCP, one message
+ * per line) from the index and the MempoolMonitor, so Electrum light wallets can use the
+ * indexer. Scripts are found by their script hash through the scripthash- keys written by
+ * the BlockIndexer and the script hashes in the MempoolSnapshot.
+ * 
+ * Connections are persistent and can pipeline requests (or send JSON-RPC batches), the
+ * responses are sent in request order. Every connection is served by one of a fixed 
+ * number of event loop threads, which also notify its subscriptions when a block is
+ * indexed or the mempool changes.
+ */
+
+class ElectrumServer {
+public:
+    /** Constructs an ElectrumServer instance
+     * 
+     * @param db the index
+     * @param mempoolMonitor the memory pool to include unconfirmed transactions from
+     * @param blocksDir the directory with the block files, to read the block headers from
+     */
+    ElectrumServer(const shared_ptr<leveldb::DB> db, const shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor, string blocksDir);
+
+    /** Listens on the port and serves the connections with the given number of event
+     * loop threads. Only returns if the port cannot be listened on. */
+    void run(int port, size_t threads);
+
+    /** Writes the scripthash- keys of the addresses that were indexed before these keys
+     * were introduced. Scans the whole index, but only the first time it runs on it. */
+    void backfillScriptHashes();
+
+    /** Writes the txo-<txid>-<vout>-barekey keys of the pay-to-pubkey and bare multisig
+     * outputs in an index built before they were marked (i.e. without index-version),
+     * reading their scripts from the block files. Scans the whole index, but only the
+     * first time it runs on it. */
+    void backfillBareKeys();
+
+private:
+    /** An output that is not spent (in the index, or the mempool for height 0) */
+    struct Utxo {
+        string txid;
+        uint32_t vout;
+        long long height;
+        long long value;
+    };
+
+    /** The confirmed history of an address: the (height, txid) of every transaction
+     * paying to or spending from it in order, and its unspent outputs */
+    struct ConfirmedHistory {
+        vector<pair<long long, string>> transactions;
+        vector<Utxo> unspent;
+    };
+
+    /** The history of an address including the mempool, as Electrum reports it */
+    struct AddressState {
+        vector<pair<string, long long>> history;
+        vector<Utxo> unspent;
+        long long confirmed;
+        long long unconfirmed;
+    };
+
+    /** A script hash a connection subscribed to. The confirmed history is kept for the
+     * tip version it was read at, so mempool changes are handled without LevelDB. */
+    struct Subscription {
+        string address;
+        uint64_t tipVersion;
+        ConfirmedHistory confirmed;
+        string status;
+    };
+
+    struct Connection {
+        int fd;
+        string input;
+        string output;
+        size_t outputOffset;
+        uint32_t events;
+        bool headersSubscribed;
+        long long headerHeight;
+        unordered_map<string, Subscription> subscriptions;
+    };
+
+    /** One event loop thread and the connections it serves. Only the thread itself
+     * touches the connections; new ones are handed over through pending. */
+    struct EventLoop {
+        int epollFd;
+        int wakeFd;
+        mutex pendingMutex;
+        vector<int> pending;
+        unordered_map<int, unique_ptr<Connection>> connections;
+        uint64_t tipVersion;
+        long long tipHeight;
+        string tipHash;
+        shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool;
+    };
+
+    void runLoop(EventLoop* loop);
+    void adoptPending(EventLoop& loop);
+    void closeConnection(EventLoop& loop, int fd);
+
+    /** Reads, handles and answers what the connection sent. Returns false if the
+     * connection has to be closed. */
+    bool serve(EventLoop& loop, Connection& connection, bool readable);
+
+    /** Sends as much of the pending output as the socket takes. Returns false if
+     * the connection has to be closed. */
+    bool flush(EventLoop& loop, Connection& connection);
+
+    /** Handles one line: a request, a batch of requests or garbage. Returns the
+     * response line, or an empty string if nothing has to be sent back. */
+    string handleLine(EventLoop& loop, Connection& connection, const string& line);
+    nlohmann::json handleRequest(EventLoop& loop, Connection& connection, const nlohmann::json& request);
+
+    /** Sends the notifications of the subscriptions that changed since the loop
+     * last looked at the tip and the mempool */
+    void notifySubscriptions(EventLoop& loop);
+
+    /** Collects the addresses paid to and the outpoints spent by the blocks indexed
+     * since the loop's tip. Returns false if the chain did not simply grow (i.e. on a 
+     * reorg or a large gap), in which case everything has to be read again. */
+    bool collectTouched(EventLoop& loop, const leveldb::ReadOptions& readOptions, long long height, unordered_set<string>& addresses, unordered_set<string>& spentKeys);
+
+    /** Returns the address the script hash pays to, or an empty string if the index
+     * and the mempool have never seen it */
+    string resolveScriptHash(const string& scriptHash, const leveldb::ReadOptions* readOptions, const VtcBlockIndexer::MempoolSnapshot& mempool);
+    ConfirmedHistory readConfirmed(const string& address, const leveldb::ReadOptions& readOptions);
+    AddressState addMempool(const ConfirmedHistory& confirmed, const string& address, const VtcBlockIndexer::MempoolSnapshot& mempool);
+
+    /** Returns the state of the address a script hash pays to, reusing the confirmed
+     * history of a subscription of the connection when it is current */
+    AddressState getAddressState(Connection& connection, const string& scriptHash);
+
+    /** Returns the Electrum status of a history: the hex SHA-256 of all "txid:height:",
+     * or an empty string (null) if there is no history */
+    static string statusHash(const AddressState& state);
+
+    /** Returns the tip's height and header as blockchain.headers.subscribe reports it */
+    nlohmann::json readTip(const leveldb::ReadOptions& readOptions);
+
+    shared_ptr<leveldb::DB> db;
+    shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor;
+    unique_ptr<VtcBlockIndexer::BlockReader> blockReader;
+    vector<unique_ptr<EventLoop>> loops;
+};
+
+}
+
+#endif // ELECTRUMSERVER_H_INCLUDED
@@ -0,0 +1,440 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "hash256.h"
+#include <openssl/sha.h>
+#include <string.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const uint32_t initialState[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    const uint32_t roundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    inline void writeBigEndian(unsigned char* p, uint32_t v) {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    /** Writes the padding of a message: the bytes after its last full block, 0x80, 
+     * zeroes and the length in bits. Returns the number of blocks (1 or 2) written
+     * to tail, which has to hold 128 bytes. */
+    size_t padTail(const unsigned char* data, size_t size, unsigned char* tail) {
+        size_t remaining = size % 64;
+        size_t blocks = (remaining + 9 <= 64) ? 1 : 2;
+        memset(tail, 0, blocks * 64);
+        memcpy(tail, data + size - remaining, remaining);
+        tail[remaining] = 0x80;
+        uint64_t bits = (uint64_t)size * 8;
+        writeBigEndian(tail + blocks * 64 - 8, (uint32_t)(bits >> 32));
+        writeBigEndian(tail + blocks * 64 - 4, (uint32_t)bits);
+        return blocks;
+    }
+
+    /** The single block holding a 32 byte digest with its padding, used for the
+     * second round of the double hash. */
+    void padDigest(const unsigned char* digest, unsigned char* block) {
+        memcpy(block, digest, 32);
+        memset(block + 32, 0, 32);
+        block[32] = 0x80;
+        block[62] = 0x01; // 256 bits
+    }
+
+    void sha256OpenSsl(const unsigned char* data, size_t size, unsigned char* out) {
+        SHA256_CTX sha256;
+        SHA256_Init(&sha256);
+        SHA256_Update(&sha256, data, size);
+        SHA256_Final(out, &sha256);
+    }
+
+    void hashOpenSsl(const unsigned char* data, size_t size, unsigned char* out) {
+        unsigned char first[32];
+        sha256OpenSsl(data, size, first);
+        sha256OpenSsl(first, 32, out);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    /** Converts the state to the ABEF/CDGH layout the sha256rnds2 instruction works on */
+    __attribute__((target("sha,sse4.1")))
+    inline void loadShaNiState(const uint32_t* state, __m128i& abef, __m128i& cdgh) {
+        __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+        abef = _mm_alignr_epi8(cdab, efgh, 8);
+        cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+    }
+
+    __attribute__((target("sha,sse4.1")))
+    inline void storeShaNiState(__m128i abef, __m128i cdgh, uint32_t* state) {
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+    }
+
+    /** Compresses one block for each of the Streams independent messages with the SHA
+     * extensions. The round instructions have a long latency, compressing two messages 
+     * at once keeps the unit busy. */
+    template<int Streams>
+    __attribute__((target("sha,sse4.1")))
+    inline void compressShaNi(__m128i* abef, __m128i* cdgh, const unsigned char* const* blocks) {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        __m128i abefSaved[Streams];
+        __m128i cdghSaved[Streams];
+        __m128i w[Streams][4];
+
+        for(int n = 0; n < Streams; n++) {
+            abefSaved[n] = abef[n];
+            cdghSaved[n] = cdgh[n];
+        }
+
+#pragma GCC unroll 16
+        for(int i = 0; i < 16; i++) {
+            const __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&roundConstants[i * 4]));
+            for(int n = 0; n < Streams; n++) {
+                __m128i words;
+                if(i < 4) {
+                    words = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks[n] + i * 16)), byteSwap);
+                } else {
+                    // W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16], four words at a time
+                    words = _mm_sha256msg1_epu32(w[n][i % 4], w[n][(i + 1) % 4]);
+                    words = _mm_add_epi32(words, _mm_alignr_epi8(w[n][(i + 3) % 4], w[n][(i + 2) % 4], 4));
+                    words = _mm_sha256msg2_epu32(words, w[n][(i + 3) % 4]);
+                }
+                w[n][i % 4] = words;
+
+                __m128i message = _mm_add_epi32(words, k);
+                cdgh[n] = _mm_sha256rnds2_epu32(cdgh[n], abef[n], message);
+                abef[n] = _mm_sha256rnds2_epu32(abef[n], cdgh[n], _mm_shuffle_epi32(message, 0x0E));
+            }
+        }
+
+        for(int n = 0; n < Streams; n++) {
+            abef[n] = _mm_add_epi32(abef[n], abefSaved[n]);
+            cdgh[n] = _mm_add_epi32(cdgh[n], cdghSaved[n]);
+        }
+    }
+
+    /** A message split in blocks: the full blocks are read from the input, the
+     * last one or two blocks with the padding from tail */
+    struct PaddedMessage {
+        const unsigned char* data;
+        size_t fullBlocks;
+        size_t totalBlocks;
+        unsigned char tail[128];
+
+        PaddedMessage(const unsigned char* data, size_t size) : data(data), fullBlocks(size / 64) {
+            totalBlocks = fullBlocks + padTail(data, size, tail);
+        }
+
+        const unsigned char* block(size_t i) const {
+            return (i < fullBlocks) ? data + i * 64 : tail + (i - fullBlocks) * 64;
+        }
+    };
+
+    /** Hashes the messages in pairs. The blocks both messages have are compressed
+     * together, the remaining blocks of the longer one alone. */
+    __attribute__((target("sha,sse4.1")))
+    void hashBatchShaNi(const VtcBlockIndexer::Hash256::Input* inputs, size_t count, unsigned char* out) {
+        size_t i = 0;
+        for(; i + 2 <= count; i += 2) {
+            PaddedMessage first(inputs[i].data, inputs[i].size);
+            PaddedMessage second(inputs[i + 1].data, inputs[i + 1].size);
+
+            __m128i abef[2], cdgh[2];
+            loadShaNiState(initialState, abef[0], cdgh[0]);
+            abef[1] = abef[0];
+            cdgh[1] = cdgh[0];
+
+            size_t common = min(first.totalBlocks, second.totalBlocks);
+            for(size_t b = 0; b < common; b++) {
+                const unsigned char* blocks[2] = { first.block(b), second.block(b) };
+                compressShaNi<2>(abef, cdgh, blocks);
+            }
+            const PaddedMessage& longer = (first.totalBlocks > common) ? first : second;
+            int n = (first.totalBlocks > common) ? 0 : 1;
+            for(size_t b = common; b < longer.totalBlocks; b++) {
+                const unsigned char* block = longer.block(b);
+                compressShaNi<1>(&abef[n], &cdgh[n], &block);
+            }
+
+            // Second round over both digests
+            unsigned char digestBlocks[2][64];
+            for(int m = 0; m < 2; m++) {
+                uint32_t state[8];
+                unsigned char digest[32];
+                storeShaNiState(abef[m], cdgh[m], state);
+                for(int w = 0; w < 8; w++) {
+                    writeBigEndian(digest + w * 4, state[w]);
+                }
+                padDigest(digest, digestBlocks[m]);
+            }
+            loadShaNiState(initialState, abef[0], cdgh[0]);
+            abef[1] = abef[0];
+            cdgh[1] = cdgh[0];
+            const unsigned char* blocks[2] = { digestBlocks[0], digestBlocks[1] };
+            compressShaNi<2>(abef, cdgh, blocks);
+
+            for(int m = 0; m < 2; m++) {
+                uint32_t state[8];
+                storeShaNiState(abef[m], cdgh[m], state);
+                for(int w = 0; w < 8; w++) {
+                    writeBigEndian(out + (i + m) * 32 + w * 4, state[w]);
+                }
+            }
+        }
+        if(i < count) {
+            hashOpenSsl(inputs[i].data, inputs[i].size, out + i * 32);
+        }
+    }
+
+    /** AVX2 kernel: eight messages are compressed in parallel, one per 32 bit lane.
+     * The state holds word i of all lanes in state[i]. Lanes that are not set in 
+     * activeLanes keep their state. */
+    __attribute__((target("avx2")))
+    inline __m256i rotateRight(__m256i x, int n) {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    /** Transposes eight rows of eight 32 bit words, so row i holds word i of every lane */
+    __attribute__((target("avx2")))
+    void transpose8x8(__m256i* rows) {
+        __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+        __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+        __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+        __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+        __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+        __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+        __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+        __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+        __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+        __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+        __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+        __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+        __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+        __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+        __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+        __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+        rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+        rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+        rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+        rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+        rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+        rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+        rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+        rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+    }
+
+    __attribute__((target("avx2")))
+    void transformAvx2(__m256i* state, const unsigned char* const* blocks, __m256i activeLanes) {
+        const __m256i byteSwap = _mm256_set_epi8(
+            12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+            12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+        // Load the block of every lane and transpose, so w[t] holds word t of all lanes
+        __m256i w[16];
+        for(int half = 0; half < 2; half++) {
+            for(int l = 0; l < 8; l++) {
+                w[half * 8 + l] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[l] + half * 32)), byteSwap);
+            }
+            transpose8x8(w + half * 8);
+        }
+
+        __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+        __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+#pragma GCC unroll 64
+        for(int t = 0; t < 64; t++) {
+            if(t >= 16) {
+                __m256i w15 = w[(t - 15) & 15];
+                __m256i w2 = w[(t - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotateRight(w15, 7), rotateRight(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotateRight(w2, 17), rotateRight(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+            }
+
+            __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotateRight(e, 6), rotateRight(e, 11)), rotateRight(e, 25));
+            __m256i choose = _mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g)));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1), _mm256_add_epi32(choose, 
+                _mm256_add_epi32(_mm256_set1_epi32(roundConstants[t]), w[t & 15])));
+            __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotateRight(a, 2), rotateRight(a, 13)), rotateRight(a, 22));
+            __m256i majority = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(sigma0, majority);
+
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, t2);
+        }
+
+        const __m256i result[8] = { a, b, c, d, e, f, g, h };
+        for(int i = 0; i < 8; i++) {
+            state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], result[i]), activeLanes);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void hashBatchAvx2(const VtcBlockIndexer::Hash256::Input* inputs, size_t count, unsigned char* out) {
+        static const unsigned char unusedBlock[64] = { 0 };
+
+        for(size_t group = 0; group < count; group += 8) {
+            size_t lanes = min<size_t>(8, count - group);
+            const VtcBlockIndexer::Hash256::Input* lane = inputs + group;
+
+            unsigned char tails[8][128];
+            size_t fullBlocks[8];
+            size_t totalBlocks[8];
+            size_t maxBlocks = 0;
+            for(size_t l = 0; l < 8; l++) {
+                if(l < lanes) {
+                    fullBlocks[l] = lane[l].size / 64;
+                    totalBlocks[l] = fullBlocks[l] + padTail(lane[l].data, lane[l].size, tails[l]);
+                } else {
+                    fullBlocks[l] = totalBlocks[l] = 0;
+                }
+                maxBlocks = max(maxBlocks, totalBlocks[l]);
+            }
+
+            __m256i state[8];
+            for(int i = 0; i < 8; i++) {
+                state[i] = _mm256_set1_epi32(initialState[i]);
+            }
+
+            // Lanes with fewer blocks are masked out once they are done
+            const unsigned char* blocks[8];
+            for(size_t b = 0; b < maxBlocks; b++) {
+                int32_t active[8];
+                for(size_t l = 0; l < 8; l++) {
+                    active[l] = (b < totalBlocks[l]) ? -1 : 0;
+                    if(b < fullBlocks[l]) {
+                        blocks[l] = lane[l].data + b * 64;
+                    } else if(b < totalBlocks[l]) {
+                        blocks[l] = tails[l] + (b - fullBlocks[l]) * 64;
+                    } else {
+                        blocks[l] = unusedBlock;
+                    }
+                }
+                transformAvx2(state, blocks, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(active)));
+            }
+
+            // Second round over the 32 byte digests, all lanes have exactly one block
+            uint32_t words[8][8];
+            for(int i = 0; i < 8; i++) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+            }
+            unsigned char digests[8][64];
+            for(size_t l = 0; l < 8; l++) {
+                unsigned char first[32];
+                for(int i = 0; i < 8; i++) {
+                    writeBigEndian(first + i * 4, words[i][l]);
+                }
+                padDigest(first, digests[l]);
+                blocks[l] = digests[l];
+            }
+            for(int i = 0; i < 8; i++) {
+                state[i] = _mm256_set1_epi32(initialState[i]);
+            }
+            transformAvx2(state, blocks, _mm256_set1_epi32(-1));
+
+            for(int i = 0; i < 8; i++) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+            }
+            for(size_t l = 0; l < lanes; l++) {
+                for(int i = 0; i < 8; i++) {
+                    writeBigEndian(out + (group + l) * 32 + i * 4, words[i][l]);
+                }
+            }
+        }
+    }
+#endif
+
+    /** Picks the batch kernel for this CPU, once at startup. Single messages are 
+     * hashed by OpenSSL, which uses the SHA extensions itself where available. */
+    struct Hash256Kernels {
+        void (*hashBatch)(const VtcBlockIndexer::Hash256::Input*, size_t, unsigned char*);
+        const char* name;
+
+        Hash256Kernels() : hashBatch(NULL), name("openssl") {
+#if defined(__x86_64__) || defined(__i386__)
+            unsigned int eax, ebx, ecx, edx;
+            bool shaExtensions = __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1 << 29));
+            if(shaExtensions && __builtin_cpu_supports("sse4.1")) {
+                hashBatch = hashBatchShaNi;
+                name = "sha-ni";
+            } else if(__builtin_cpu_supports("avx2")) {
+                hashBatch = hashBatchAvx2;
+                name = "avx2";
+            }
+#endif
+        }
+    };
+
+    const Hash256Kernels kernels;
+}
+
+void VtcBlockIndexer::Hash256::sha256(const unsigned char* data, size_t size, unsigned char* out) {
+    sha256OpenSsl(data, size, out);
+}
+
+void VtcBlockIndexer::Hash256::hash(const unsigned char* data, size_t size, unsigned char* out) {
+    hashOpenSsl(data, size, out);
+}
+
+void VtcBlockIndexer::Hash256::hashBatch(const Input* inputs, size_t count, unsigned char* out) {
+    if(kernels.hashBatch != NULL) {
+        kernels.hashBatch(inputs, count, out);
+        return;
+    }
+    for(size_t i = 0; i < count; i++) {
+        hashOpenSsl(inputs[i].data, inputs[i].size, out + i * outputSize);
+    }
+}
+
+void VtcBlockIndexer::Hash256::hashBatch(const vector<Input>& inputs, unsigned char* out) {
+    hashBatch(inputs.data(), inputs.size(), out);
+}
+
+const char* VtcBlockIndexer::Hash256::implementation() {
+    return kernels.name;
+}
@@ -0,0 +1,71 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HASH256_H_INCLUDED
+#define HASH256_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The Hash256 class calculates double SHA-256 hashes (block hashes and txids). 
+ * Hashing many independent messages at once (all headers in a block file, all 
+ * transactions in a block) through hashBatch uses a multi-message kernel picked for
+ * the CPU at startup: the SHA extensions (SHA-NI) on two messages at a time, or AVX2 
+ * on eight messages at a time. Single messages and CPUs without either go through 
+ * OpenSSL.
+ */
+
+class Hash256 {
+public:
+    /** A message to hash. The data has to stay valid during the call. */
+    struct Input {
+        const unsigned char* data;
+        size_t size;
+    };
+
+    static const size_t outputSize = 32;
+
+    /** Calculates a single SHA-256 hash, writing 32 bytes to out */
+    static void sha256(const unsigned char* data, size_t size, unsigned char* out);
+
+    /** Calculates SHA-256(SHA-256(data)), writing 32 bytes to out */
+    static void hash(const unsigned char* data, size_t size, unsigned char* out);
+
+    /** Calculates the double SHA-256 hash of count independent messages, writing
+     * 32 bytes per message to out in the same order */
+    static void hashBatch(const Input* inputs, size_t count, unsigned char* out);
+    static void hashBatch(const vector<Input>& inputs, unsigned char* out);
+
+    /** The kernel used on this CPU: "sha-ni", "avx2" or "openssl" */
+    static const char* implementation();
+
+private:
+    Hash256() {}
+};
+
+}
+
+#endif // HASH256_H_INCLUDED
@@ -0,0 +1,95 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "histogram.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+    uint64_t toBits(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double fromBits(uint64_t bits) {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+VtcBlockIndexer::Histogram::Histogram(const vector<double>& upperBounds) : upperBounds(upperBounds), bucketCounts(new atomic<uint64_t>[upperBounds.size() + 1]), sumBits(toBits(0)) {
+    for(size_t i = 0; i <= upperBounds.size(); i++) {
+        bucketCounts[i] = 0;
+    }
+}
+
+vector<double> VtcBlockIndexer::Histogram::exponentialBounds(double start, double factor, size_t count) {
+    vector<double> bounds;
+    double bound = start;
+    for(size_t i = 0; i < count; i++) {
+        bounds.push_back(bound);
+        bound *= factor;
+    }
+    return bounds;
+}
+
+void VtcBlockIndexer::Histogram::observe(double value) {
+    size_t bucket = lower_bound(upperBounds.begin(), upperBounds.end(), value) - upperBounds.begin();
+    bucketCounts[bucket].fetch_add(1, memory_order_relaxed);
+
+    uint64_t expected = sumBits.load(memory_order_relaxed);
+    while(!sumBits.compare_exchange_weak(expected, toBits(fromBits(expected) + value), memory_order_relaxed)) {
+    }
+}
+
+VtcBlockIndexer::Histogram::Snapshot VtcBlockIndexer::Histogram::snapshot() const {
+    Snapshot snapshot;
+    snapshot.upperBounds = upperBounds;
+    snapshot.count = 0;
+    for(size_t i = 0; i <= upperBounds.size(); i++) {
+        snapshot.bucketCounts.push_back(bucketCounts[i].load(memory_order_relaxed));
+        snapshot.count += snapshot.bucketCounts.back();
+    }
+    snapshot.sum = fromBits(sumBits.load(memory_order_relaxed));
+    return snapshot;
+}
+
+double VtcBlockIndexer::Histogram::Snapshot::quantile(double q) const {
+    if(count == 0) return 0;
+
+    double rank = q * count;
+    uint64_t cumulative = 0;
+    for(size_t i = 0; i < bucketCounts.size(); i++) {
+        if(bucketCounts[i] == 0 || cumulative + bucketCounts[i] < rank) {
+            cumulative += bucketCounts[i];
+            continue;
+        }
+
+        // Values beyond the last bound are reported as the last bound
+        if(i == upperBounds.size()) return upperBounds.empty() ? 0 : upperBounds.back();
+
+        double lower = (i == 0) ? 0 : upperBounds[i - 1];
+        return lower + (upperBounds[i] - lower) * ((rank - cumulative) / bucketCounts[i]);
+    }
+    return upperBounds.empty() ? 0 : upperBounds.back();
+}
@@ -0,0 +1,78 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HISTOGRAM_H_INCLUDED
+#define HISTOGRAM_H_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The Histogram class counts observed values into buckets with fixed upper bounds, 
+ * like a Prometheus histogram. Observing only touches atomics, so it can be done
+ * from any thread without locking.
+ */
+
+class Histogram {
+public:
+    /** A consistent enough copy of the histogram to render or compute quantiles from */
+    struct Snapshot {
+        vector<double> upperBounds;
+
+        // Number of observations per bucket (not cumulative), the last one is the
+        // +Inf bucket, so it has one element more than upperBounds
+        vector<uint64_t> bucketCounts;
+        uint64_t count;
+        double sum;
+
+        /** Estimates the quantile (0..1) by interpolating within the bucket it falls in.
+         * Returns 0 when nothing was observed. */
+        double quantile(double q) const;
+    };
+
+    /** Constructs a histogram with the given (ascending) bucket upper bounds */
+    Histogram(const vector<double>& upperBounds);
+
+    /** Returns count bounds starting at start, each factor times the previous */
+    static vector<double> exponentialBounds(double start, double factor, size_t count);
+
+    /** Adds a value to the histogram */
+    void observe(double value);
+
+    /** Copies the current counts */
+    Snapshot snapshot() const;
+
+private:
+    vector<double> upperBounds;
+    unique_ptr<atomic<uint64_t>[]> bucketCounts;
+
+    // The sum is kept as the bits of a double, to add to it with compare and swap
+    atomic<uint64_t> sumBits;
+};
+
+}
+
+#endif // HISTOGRAM_H_INCLUDED
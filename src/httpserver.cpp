@@ -26,33 +26,298 @@
 #include <vector>
 #include <memory>
 #include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <algorithm>
 #include <restbed>
 #include "json.hpp"
 #include "utility.h"
+#include "scriptsolver.h"
+#include "blockindexer.h"
+#include "prometheuswriter.h"
+#include "instrumenteddb.h"
+#include "leveldb/cache.h"
+#include "walletdescriptor.h"
+#include <chrono>
+#include <thread>
 using namespace std;
 using namespace restbed;
 using json = nlohmann::json;
 
+namespace {
+    // A TXO in a response that still needs its raw transaction (or script) filled in
+    struct RawTxoLookup {
+        size_t entry;
+        string txid;
+        uint32_t vout;
+        string spender;
+    };
+
+    // Most addresses a single /addressBalances request can ask for
+    const size_t maxBulkAddresses = 1000;
+
+    // A TXO found while looking up the addresses of a bulk request
+    struct AddressTxo {
+        size_t address;
+        string txid;
+        uint32_t vout;
+        long long height;
+        long long value;
+        string spentKey;
+        bool spent;
+    };
+
+    /** Returns the same figures as /addressBalance?details=1 for each of the addresses,
+     * and with utxos also the outputs /addressTxos?unspent=1 would return. The addresses
+     * must be unique. Keys are read in sorted order (the address TXOs, then the spent 
+     * markers, then the block times) so consecutive reads mostly hit the same blocks. */
+    vector<json> lookupAddresses(leveldb::DB* db, const leveldb::ReadOptions& readOptions, const VtcBlockIndexer::MempoolSnapshot& mempool, const vector<string>& addresses, bool utxos, bool unconfirmed) {
+        vector<size_t> addressOrder(addresses.size());
+        for(size_t i = 0; i < addressOrder.size(); i++) addressOrder[i] = i;
+        sort(addressOrder.begin(), addressOrder.end(), [&addresses](size_t a, size_t b) { return addresses[a] < addresses[b]; });
+
+        vector<AddressTxo> txos;
+        leveldb::Iterator* it = db->NewIterator(readOptions);
+        for(size_t i : addressOrder) {
+            string start(addresses[i] + "-txo-00000001");
+            string limit(addresses[i] + "-txo-99999999");
+            for (it->Seek(start);
+                    it->Valid() && it->key().ToString() < limit;
+                    it->Next()) {
+                string txo = it->value().ToString();
+                txos.push_back({ i, txo.substr(0,64), (uint32_t)stoul(txo.substr(64,8)), stoll(txo.substr(72,8)), stoll(txo.substr(80)), "txo-" + txo.substr(0,64) + "-" + txo.substr(64,8) + "-spent", false });
+            }
+        }
+        assert(it->status().ok());  // Check for any errors found during the scan
+        delete it;
+
+        // The spent markers are spread over the whole key space, sort them as well
+        vector<size_t> spentOrder(txos.size());
+        for(size_t i = 0; i < spentOrder.size(); i++) spentOrder[i] = i;
+        sort(spentOrder.begin(), spentOrder.end(), [&txos](size_t a, size_t b) { return txos[a].spentKey < txos[b].spentKey; });
+        for(size_t i : spentOrder) {
+            string spentTx;
+            txos[i].spent = db->Get(readOptions, txos[i].spentKey, &spentTx).ok();
+        }
 
-VtcBlockIndexer::HttpServer::HttpServer(shared_ptr<leveldb::DB> db, shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor, string blocksDir) {
-    this->db = db;
+        map<long long, long long> blockTimes;
+        if(utxos) {
+            for(const AddressTxo& txo : txos) {
+                if(!txo.spent) blockTimes[txo.height] = 0;
+            }
+            for(auto& blockTime : blockTimes) {
+                stringstream ssBlockTimeHeightKey;
+                string blockTimeStr;
+                ssBlockTimeHeightKey << "block-time-" << setw(8) << setfill('0') << blockTime.first;
+                if(db->Get(readOptions, ssBlockTimeHeightKey.str(), &blockTimeStr).ok()) {
+                    blockTime.second = stoll(blockTimeStr);
+                }
+            }
+        }
+
+        vector<json> results(addresses.size());
+        for(json& result : results) {
+            result["balance"] = 0LL;
+            result["txCount"] = 0LL;
+            result["unconfirmedBalance"] = 0LL;
+            result["unconfirmedTxCount"] = 0LL;
+            if(utxos) result["utxos"] = json::array();
+        }
+
+        for(const AddressTxo& txo : txos) {
+            json& result = results[txo.address];
+            result["txCount"] = result["txCount"].get<long long>() + 1;
+            if(txo.spent) {
+                result["txCount"] = result["txCount"].get<long long>() + 1;
+                continue;
+            }
+
+            result["balance"] = result["balance"].get<long long>() + txo.value;
+            string spender = mempool.outpointSpend(txo.txid, txo.vout);
+            if(spender.compare("") == 0) {
+                result["unconfirmedBalance"] = result["unconfirmedBalance"].get<long long>() + txo.value;
+            } else {
+                result["unconfirmedTxCount"] = result["unconfirmedTxCount"].get<long long>() + 1;
+                if(unconfirmed) continue;
+            }
+
+            if(utxos) {
+                json utxo;
+                utxo["height"] = txo.height;
+                utxo["spender"] = nullptr;
+                utxo["txhash"] = txo.txid;
+                utxo["vout"] = txo.vout;
+                utxo["value"] = txo.value;
+                utxo["time"] = blockTimes[txo.height];
+                result["utxos"].push_back(utxo);
+            }
+        }
+
+        for(size_t i = 0; i < addresses.size(); i++) {
+            json& result = results[i];
+            for (const VtcBlockIndexer::TransactionOutput& txo : mempool.getTxos(addresses[i])) {
+                result["unconfirmedTxCount"] = result["unconfirmedTxCount"].get<long long>() + 1;
+                string spender = mempool.outpointSpend(txo.txHash, txo.index);
+                if(spender.compare("") != 0) {
+                    result["unconfirmedTxCount"] = result["unconfirmedTxCount"].get<long long>() + 1;
+                    continue;
+                }
+
+                result["unconfirmedBalance"] = result["unconfirmedBalance"].get<long long>() + txo.value;
+                if(utxos && unconfirmed) {
+                    json utxo;
+                    utxo["txhash"] = txo.txHash;
+                    utxo["vout"] = txo.index;
+                    utxo["value"] = txo.value;
+                    utxo["block"] = 0;
+                    utxo["spender"] = nullptr;
+                    result["utxos"].push_back(utxo);
+                }
+            }
+        }
+        return results;
+    }
+
+    // Largest gap of unused addresses a /walletScan request can ask for
+    const size_t maxGapLimit = 1000;
+
+    // Most addresses /walletScan derives per branch before it gives up
+    const uint32_t maxScanAddresses = 100000;
+
+    // How long the /sync status is served from the cache while the tip does not change
+    const chrono::seconds syncCacheAge(2);
+
+    // Key ranges of the index, to estimate how much space each kind of data takes.
+    // Keys prefixed with a block hash (the TXOs and spends to undo on a reorg) start
+    // with zeros. Whatever is not in these ranges is keyed by address.
+    struct KeyRange {
+        const char* name;
+        const char* start;
+        const char* limit;
+    };
+
+    const KeyRange keyRanges[] = {
+        { "block", "block-", "block." },
+        { "tx", "tx-", "tx." },
+        { "txoSpent", "txo-", "txo." },
+        { "multisig", "multisigtx-", "multisigtx." },
+        { "scriptHash", "scripthash-", "scripthash." },
+        { "blockUndo", "0000", "0001" }
+    };
+
+    /** Parses the per level table of the leveldb.stats property */
+    json parseLevelStats(const string& stats) {
+        json levels = json::array();
+        stringstream ss(stats);
+        string line;
+        bool inTable = false;
+        while(getline(ss, line)) {
+            if(line.compare(0, 5, "-----") == 0) {
+                inTable = true;
+                continue;
+            }
+            if(!inTable) continue;
+
+            int level;
+            long long files;
+            double size, seconds, read, written;
+            if(sscanf(line.c_str(), "%d %lld %lf %lf %lf %lf", &level, &files, &size, &seconds, &read, &written) != 6) break;
+
+            json jsonLevel;
+            jsonLevel["level"] = level;
+            jsonLevel["files"] = files;
+            jsonLevel["sizeMB"] = size;
+            jsonLevel["compactionSeconds"] = seconds;
+            jsonLevel["compactionReadMB"] = read;
+            jsonLevel["compactionWriteMB"] = written;
+            levels.push_back(jsonLevel);
+        }
+        return levels;
+    }
+}
+
+VtcBlockIndexer::HttpServer::HttpServer(shared_ptr<leveldb::DB> db, shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor, shared_ptr<VtcBlockIndexer::BlockFileWatcher> blockFileWatcher, string blocksDir) {
+    this->db = make_shared<VtcBlockIndexer::InstrumentedDB>(db);
     this->blocksDir = blocksDir;
     this->mempoolMonitor = mempoolMonitor;
+    this->blockFileWatcher = blockFileWatcher;
+    this->blockCache = NULL;
+    this->blockCacheSize = 0;
+    this->bloomFilterBits = 0;
+    this->gapLimit = 20;
+    this->adminBindAddress = "127.0.0.1";
+    this->adminPort = 0;
     blockReader.reset(new VtcBlockIndexer::BlockReader(blocksDir));
     scriptSolver = std::make_unique<VtcBlockIndexer::ScriptSolver>();
-    httpClient.reset(new jsonrpc::HttpClient("http://middleware:middleware@" + std::string(std::getenv("COIND_HOST")) + ":8332"));
+    httpClient.reset(new VtcBlockIndexer::PersistentHttpClient("http://middleware:middleware@" + std::string(std::getenv("COIND_HOST")) + ":8332"));
     vertcoind.reset(new VertcoinClient(*httpClient));
 }
 
 
 
+bool VtcBlockIndexer::HttpServer::getRawTransactions(const vector<string>& txids, unordered_map<string, vector<unsigned char>>& rawTransactions, string& error) {
+    vector<string> indexedTxids;
+    vector<VtcBlockIndexer::TransactionFilePosition> positions;
+    unordered_set<string> seen;
+    vector<string> missingTxids;
+    
+    for(const string& txid : txids) {
+        if(!seen.insert(txid).second) continue;
+
+        string filePosition;
+        leveldb::Status s = this->db->Get(leveldb::ReadOptions(), "tx-filePosition-" + txid, &filePosition);
+        if(s.ok() && filePosition.size() == 24) {
+            indexedTxids.push_back(txid);
+            positions.push_back({filePosition.substr(0,12), stoull(filePosition.substr(12,12))});
+        } else {
+            missingTxids.push_back(txid);
+        }
+    }
+
+    vector<vector<unsigned char>> rawIndexed = this->blockReader->readRawTransactions(positions);
+    for(size_t i = 0; i < indexedTxids.size(); i++) {
+        if(rawIndexed[i].empty()) {
+            missingTxids.push_back(indexedTxids[i]);
+        } else {
+            rawTransactions[indexedTxids[i]] = rawIndexed[i];
+        }
+    }
+
+    if(missingTxids.empty()) return true;
+
+    try {
+        unordered_map<string, string> rawMissing;
+        {
+            VtcBlockIndexer::RequestTracker::RpcCall rpcCall;
+            rawMissing = vertcoind->getrawtransactions(missingTxids);
+        }
+        for(const string& txid : missingTxids) {
+            auto rawTx = rawMissing.find(txid);
+            if(rawTx == rawMissing.end()) {
+                error = "Transaction " + txid + " not found";
+                cout << "Not found " << error << endl;
+                return false;
+            }
+            rawTransactions[txid] = VtcBlockIndexer::Utility::hexToBytes(rawTx->second);
+        }
+    } catch(const jsonrpc::JsonRpcException& e) {
+        error = e.what();
+        cout << "Not found " << error << endl;
+        return false;
+    }
+    return true;
+}
+
 void VtcBlockIndexer::HttpServer::getTransaction(const shared_ptr<Session> session) {
     const auto request = session->get_request();
     
-    cout << "Looking up txid " << request->get_path_parameter("id") << endl;
-    
     try {
-        const Json::Value tx = vertcoind->getrawtransaction(request->get_path_parameter("id"), true);
+        Json::Value tx;
+        {
+            VtcBlockIndexer::RequestTracker::RpcCall rpcCall;
+            tx = vertcoind->getrawtransaction(request->get_path_parameter("id"), true);
+        }
         
         stringstream body;
         body << tx.toStyledString();
@@ -126,51 +391,101 @@ void VtcBlockIndexer::HttpServer::getTransactionProof(const shared_ptr<Session>
    session->close( OK, body, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(body.size()) } } );
 }
 
-void VtcBlockIndexer::HttpServer::sync(const shared_ptr<Session> session) {
+string VtcBlockIndexer::HttpServer::getSyncBody() {
     json j;
 
-    const auto request = session->get_request( );
-
+    // Nothing is indexed yet until the genesis block is
+    long long height = -1;
     string highestBlockString;
-    this->db->Get(leveldb::ReadOptions(),"highestblock",&highestBlockString);
+    if(this->db->Get(leveldb::ReadOptions(),"highestblock",&highestBlockString).ok()) {
+        height = stoll(highestBlockString);
+    }
 
+    long long blockChainHeight = -1;
     j["error"] = nullptr;
-    j["height"] = stoll(highestBlockString);
+    j["height"] = height;
+    j["blockChainHeight"] = nullptr;
     try {
-        const Json::Value blockCount = vertcoind->getblockcount();
+        Json::Value blockCount;
+        {
+            VtcBlockIndexer::RequestTracker::RpcCall rpcCall;
+            blockCount = vertcoind->getblockcount();
+        }
         
-        j["blockChainHeight"] = blockCount.asInt();
+        blockChainHeight = blockCount.asInt();
+        j["blockChainHeight"] = blockChainHeight;
     } catch(const jsonrpc::JsonRpcException& e) {
         const std::string message(e.what());
         j["error"] = message;
     }
 
-    float progress = (float)j["height"].get<int>() / (float)j["blockChainHeight"].get<int>();
-    progress *= 100;
-    j["syncPercentage"] = progress;
-    if(progress >= 100) {
-        j["status"] = "finished";
+    if(blockChainHeight > 0) {
+        float progress = (float)max(height, 0LL) / (float)blockChainHeight;
+        progress *= 100;
+        j["syncPercentage"] = progress;
+        if(progress >= 100) {
+            j["status"] = "finished";
+        } else {
+            j["status"] = "indexing";
+        }
     } else {
-        j["status"] = "indexing";
+        // Without the node's height the progress is unknown
+        j["syncPercentage"] = nullptr;
+        j["status"] = "unknown";
     }
 
-    string body = j.dump();
-    session->close( OK, body, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(body.size()) } } );
+    VtcBlockIndexer::IndexingTelemetry::Progress progress = VtcBlockIndexer::BlockIndexer::telemetry.getProgress();
+    json indexing;
+    indexing["phase"] = VtcBlockIndexer::IndexingTelemetry::phaseName(progress.phase);
+    indexing["height"] = progress.height;
+    indexing["blocksPerSecond"] = progress.blocksPerSecond;
+    indexing["transactionsPerSecond"] = progress.transactionsPerSecond;
+    indexing["updateSeconds"] = progress.updateSeconds;
+    if(progress.phase == VtcBlockIndexer::IndexingTelemetry::Phase::Constructing && progress.blocksPerSecond > 0 && blockChainHeight > (long long)progress.height) {
+        indexing["etaSeconds"] = (blockChainHeight - progress.height) / progress.blocksPerSecond;
+    } else {
+        indexing["etaSeconds"] = nullptr;
+    }
+
+    json stages;
+    for(const auto& stage : VtcBlockIndexer::BlockIndexer::telemetry.getStages()) {
+        json jsonStage;
+        jsonStage["count"] = stage.second.count;
+        jsonStage["seconds"] = stage.second.sum;
+        jsonStage["p50"] = stage.second.quantile(0.5);
+        jsonStage["p99"] = stage.second.quantile(0.99);
+        stages[stage.first] = jsonStage;
+    }
+    indexing["stages"] = stages;
+    j["indexing"] = indexing;
+
+    json pubKeyCache;
+    pubKeyCache["size"] = VtcBlockIndexer::ScriptSolver::pubKeyCache.getSize();
+    pubKeyCache["hits"] = VtcBlockIndexer::ScriptSolver::pubKeyCache.getHits();
+    pubKeyCache["misses"] = VtcBlockIndexer::ScriptSolver::pubKeyCache.getMisses();
+    pubKeyCache["hitRate"] = VtcBlockIndexer::ScriptSolver::pubKeyCache.getHitRate();
+    j["pubKeyCache"] = pubKeyCache;
+
+    return j.dump();
 }
 
-void VtcBlockIndexer::HttpServer::getBlocks(const shared_ptr<Session> session) {
-    json j = json::array();
+void VtcBlockIndexer::HttpServer::sync(const shared_ptr<Session> session) {
+    // The node's height changes before the indexer catches up and the indexing rates change
+    // all the time, so the status is only cached briefly on top of the tip version
+    uint64_t version = VtcBlockIndexer::BlockIndexer::getTipVersion();
+    shared_ptr<const VtcBlockIndexer::ResponseCache::Entry> entry = responseCache.get("sync", version, syncCacheAge);
+    if(!entry) {
+        entry = responseCache.put("sync", version, getSyncBody());
+    }
+    respondCached(session, entry);
+}
 
-    const auto request = session->get_request( );
+string VtcBlockIndexer::HttpServer::getBlocksBody(long long limitParam) {
+    json j = json::array();
 
     string highestBlockString;
     this->db->Get(leveldb::ReadOptions(),"highestblock",&highestBlockString);
     
-   
-    long long limitParam = stoi(request->get_query_parameter("limit","0"));
-    if(limitParam == 0 || limitParam > 100)
-        limitParam = 100;
-
     long long lowestBlock = stoll(highestBlockString)-limitParam;
     stringstream lowestBlockString;
     lowestBlockString << setw(8) << setfill('0') << lowestBlock;
@@ -199,14 +514,42 @@ void VtcBlockIndexer::HttpServer::getBlocks(const shared_ptr<Session> session) {
         j.push_back(blockObj);
     }
 
-    string body = j.dump();
-    
-   session->close( OK, body, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(body.size()) } } );
+    return j.dump();
+}
+
+void VtcBlockIndexer::HttpServer::getBlocks(const shared_ptr<Session> session) {
+    const auto request = session->get_request( );
+
+    long long limitParam = stoi(request->get_query_parameter("limit","0"));
+    if(limitParam <= 0 || limitParam > 100)
+        limitParam = 100;
+
+    // The list only changes when a block is connected or disconnected
+    uint64_t version = VtcBlockIndexer::BlockIndexer::getTipVersion();
+    string key = "blocks-" + std::to_string(limitParam);
+    shared_ptr<const VtcBlockIndexer::ResponseCache::Entry> entry = responseCache.get(key, version);
+    if(!entry) {
+        entry = responseCache.put(key, version, getBlocksBody(limitParam));
+    }
+    respondCached(session, entry);
+}
+
+void VtcBlockIndexer::HttpServer::respondCached(const shared_ptr<Session> session, const shared_ptr<const VtcBlockIndexer::ResponseCache::Entry>& entry) {
+    const auto request = session->get_request( );
+
+    // Clients revalidate with the ETag they got, send no body if it still matches
+    const string ifNoneMatch = request->get_header("If-None-Match");
+    if(!ifNoneMatch.empty() && (ifNoneMatch == "*" || ifNoneMatch.find(entry->etag) != string::npos)) {
+        session->close( 304, "", { { "ETag", entry->etag }, { "Cache-Control", "no-cache" }, { "Content-Length", "0" } } );
+        return;
+    }
 
+    session->close( OK, entry->body, { { "Content-Type",  "application/json" }, { "ETag", entry->etag }, { "Cache-Control", "no-cache" }, { "Content-Length",  std::to_string(entry->body.size()) } } );
 }
 
 void VtcBlockIndexer::HttpServer::addressBalance( const shared_ptr< Session > session )
 {
+    const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
     long long balance = 0;
     long long unconfirmedBalance = 0;
     long long txCount = 0;
@@ -214,8 +557,6 @@ void VtcBlockIndexer::HttpServer::addressBalance( const shared_ptr< Session > se
     int txoCount = 0;
     const auto request = session->get_request( );
     int details = stoi(request->get_query_parameter("details","0"));
-    
-    cout << "Checking balance for address " << request->get_path_parameter( "address" ) << endl;
 
     string start(request->get_path_parameter( "address" ) + "-txo-00000001");
     string limit(request->get_path_parameter( "address" ) + "-txo-99999999");
@@ -236,7 +577,7 @@ void VtcBlockIndexer::HttpServer::addressBalance( const shared_ptr< Session > se
         {
             balance += stoll(txo.substr(80));
             // check mempool for spenders
-            string spender = mempoolMonitor->outpointSpend(txo.substr(0,64), stol(txo.substr(64,8)));
+            string spender = mempool->outpointSpend(txo.substr(0,64), stol(txo.substr(64,8)));
             if(spender.compare("") == 0) {
                 unconfirmedBalance += stoll(txo.substr(80));
             } else {
@@ -249,15 +590,12 @@ void VtcBlockIndexer::HttpServer::addressBalance( const shared_ptr< Session > se
     assert(it->status().ok());  // Check for any errors found during the scan
     delete it;
 
-    cout << "Analyzed " << txoCount << " TXOs - Balance is " << balance << endl;
- 
     // Add mempool transactions
-    vector<VtcBlockIndexer::TransactionOutput> mempoolOutputs = mempoolMonitor->getTxos(request->get_path_parameter( "address" ));
+    vector<VtcBlockIndexer::TransactionOutput> mempoolOutputs = mempool->getTxos(request->get_path_parameter( "address" ));
     for (VtcBlockIndexer::TransactionOutput txo : mempoolOutputs) {
         txoCount++;
         unconfirmedTxCount++;
-        string spender = mempoolMonitor->outpointSpend(txo.txHash, txo.index);
-        cout << "Spender for " << txo.txHash << "/" << txo.index << " = " << spender;
+        string spender = mempool->outpointSpend(txo.txHash, txo.index);
         if(spender.compare("") == 0) {
             unconfirmedBalance += txo.value;
         } else {
@@ -265,8 +603,6 @@ void VtcBlockIndexer::HttpServer::addressBalance( const shared_ptr< Session > se
         }
     }
 
-    cout << "Including mempool: Analyzed " << txoCount << " TXOs - Balance is " << balance << endl;
-    
     if(details != 0) {
         json j;
         j["balance"] = balance;
@@ -286,6 +622,7 @@ void VtcBlockIndexer::HttpServer::addressBalance( const shared_ptr< Session > se
 
 void VtcBlockIndexer::HttpServer::addressTxos( const shared_ptr< Session > session )
 {
+    const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
     json j = json::array();
 
     const auto request = session->get_request( );
@@ -297,8 +634,8 @@ void VtcBlockIndexer::HttpServer::addressTxos( const shared_ptr< Session > sessi
     int unspent = stoi(request->get_query_parameter("unspent","0"));
     int unconfirmed = stoi(request->get_query_parameter("unconfirmed","0"));
     int scripts = stoi(request->get_query_parameter("script","0"));
-    cout << "Fetching address txos for address " << request->get_path_parameter( "address" ) << endl;
    
+    vector<RawTxoLookup> rawLookups;
     string start(request->get_path_parameter( "address" ) + "-txo-00000001");
     string limit(request->get_path_parameter( "address" ) + "-txo-99999999");
     
@@ -319,7 +656,7 @@ void VtcBlockIndexer::HttpServer::addressTxos( const shared_ptr< Session > sessi
 
             if(!s.ok()) {
                 if(unconfirmed) {
-                    string spender = mempoolMonitor->outpointSpend(txo.substr(0,64), stol(txo.substr(64,8)));
+                    string spender = mempool->outpointSpend(txo.substr(0,64), stol(txo.substr(64,8)));
                     if(spender.compare("") == 0) {
                         txoObj["spender"] = nullptr;
                     } else {
@@ -335,43 +672,9 @@ void VtcBlockIndexer::HttpServer::addressTxos( const shared_ptr< Session > sessi
 
             }
 
-            if(raw != 0) {
-                try {
-                    const Json::Value tx = vertcoind->getrawtransaction(txo.substr(0,64), false);
-                    txoObj["tx"] = tx.asString();
-                } catch(const jsonrpc::JsonRpcException& e) {
-                    const std::string message(e.what());
-                    session->close(400, message, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(message.size())}});
-                    cout << "Not found " << message << endl;
-                    return;
-                }
-            }
-
-            if(raw == 0 && scripts != 0) {
-                 try {
-                    const Json::Value tx = vertcoind->getrawtransaction(txo.substr(0,64), true);
-                    const Json::Value scriptHex = tx["vout"][stoi(txo.substr(64,8))]["scriptPubKey"]["hex"];
-                    txoObj["script"] = scriptHex.asString();
-                } catch(const jsonrpc::JsonRpcException& e) {
-                    const std::string message(e.what());
-                    session->close(400, message, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(message.size())}});
-                    cout << "Not found " << message << endl;
-                    return;
-                }
-            }
-
-           
-
-            if(raw != 0 && txoObj["spender"].is_string()) {
-                try {
-                    const Json::Value tx = vertcoind->getrawtransaction(txoObj["spender"].get<string>(), false);
-                    txoObj["spender"] = tx.asString();
-                } catch(const jsonrpc::JsonRpcException& e) {
-                    const std::string message(e.what());
-                    session->close(400, message, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(message.size())}});
-                    cout << "Not found " << message << endl;
-                    return;
-                }
+            if(raw != 0 || scripts != 0) {
+                string spender = (raw != 0 && txoObj["spender"].is_string()) ? txoObj["spender"].get<string>() : "";
+                rawLookups.push_back({j.size(), txo.substr(0,64), (uint32_t)stoul(txo.substr(64,8)), spender});
             }
 
             if(raw == 0) {
@@ -393,16 +696,46 @@ void VtcBlockIndexer::HttpServer::addressTxos( const shared_ptr< Session > sessi
     assert(it->status().ok());  // Check for any errors found during the scan
     delete it;
 
+    // Fill in the raw transactions and scripts from the block files in one go
+    if(!rawLookups.empty()) {
+        vector<string> txids;
+        for(const RawTxoLookup& lookup : rawLookups) {
+            txids.push_back(lookup.txid);
+            if(!lookup.spender.empty()) txids.push_back(lookup.spender);
+        }
+
+        unordered_map<string, vector<unsigned char>> rawTransactions;
+        string error;
+        if(!getRawTransactions(txids, rawTransactions, error)) {
+            session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
+            return;
+        }
+
+        for(const RawTxoLookup& lookup : rawLookups) {
+            json& txoObj = j[lookup.entry];
+            if(raw != 0) {
+                txoObj["tx"] = VtcBlockIndexer::Utility::hashToHex(rawTransactions[lookup.txid]);
+                if(!lookup.spender.empty()) {
+                    txoObj["spender"] = VtcBlockIndexer::Utility::hashToHex(rawTransactions[lookup.spender]);
+                }
+            } else {
+                vector<unsigned char> script;
+                VtcBlockIndexer::BlockReader::readOutputScript(rawTransactions[lookup.txid], lookup.vout, script);
+                txoObj["script"] = VtcBlockIndexer::Utility::hashToHex(script);
+            }
+        }
+    }
+
     if(unconfirmed == 1) {
         // Add mempool transactions
-        vector<VtcBlockIndexer::TransactionOutput> mempoolOutputs = mempoolMonitor->getTxos(request->get_path_parameter( "address" ));
+        vector<VtcBlockIndexer::TransactionOutput> mempoolOutputs = mempool->getTxos(request->get_path_parameter( "address" ));
         for (VtcBlockIndexer::TransactionOutput txo : mempoolOutputs) {
             json txoObj;
             txoObj["txhash"] = txo.txHash;
             txoObj["vout"] = txo.index;
             txoObj["value"] = txo.value;
             txoObj["block"] = 0;
-            string spender = mempoolMonitor->outpointSpend(txo.txHash, txo.index);
+            string spender = mempool->outpointSpend(txo.txHash, txo.index);
             if(spender.compare("") != 0) {
                 txoObj["spender"] = spender;
             } else {
@@ -419,6 +752,7 @@ void VtcBlockIndexer::HttpServer::addressTxos( const shared_ptr< Session > sessi
 
 void VtcBlockIndexer::HttpServer::outpointSpend( const shared_ptr< Session > session )
 {
+    const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
     json j;
     j["error"] = false;
     const auto request = session->get_request( );
@@ -439,7 +773,6 @@ void VtcBlockIndexer::HttpServer::outpointSpend( const shared_ptr< Session > ses
     {
         stringstream txoId;
         txoId << "txo-" << txid << "-" << setw(8) << setfill('0') << vout << "-spent";
-        cout << "Checking outpoint spent " << txoId.str() << endl;
         string spentTx;
 
         s = this->db->Get(leveldb::ReadOptions(), txoId.str(), &spentTx);
@@ -455,7 +788,7 @@ void VtcBlockIndexer::HttpServer::outpointSpend( const shared_ptr< Session > ses
                 j["height"] = stol(blockHeightStr);
             }
         } else if(unconfirmed != 0) {
-            string mempoolSpend = mempoolMonitor->outpointSpend(txid, vout);
+            string mempoolSpend = mempool->outpointSpend(txid, vout);
             if(mempoolSpend.compare("") != 0) {
                 j["spent"] = true;
                 j["spender"] = mempoolSpend;
@@ -464,16 +797,15 @@ void VtcBlockIndexer::HttpServer::outpointSpend( const shared_ptr< Session > ses
         }
 
         if(raw != 0 && j["spender"].is_string()) {
-            try {
-                const Json::Value tx = vertcoind->getrawtransaction(j["spender"].get<string>(), false);
-                j["spenderRaw"] = tx.asString();
-                j["spender"] = nullptr;
-            } catch(const jsonrpc::JsonRpcException& e) {
-                const std::string message(e.what());
-                session->close(400, message, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(message.size())}});
-                cout << "Not found " << message << endl;
+            const string spender = j["spender"].get<string>();
+            unordered_map<string, vector<unsigned char>> rawTransactions;
+            string error;
+            if(!getRawTransactions({spender}, rawTransactions, error)) {
+                session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
                 return;
             }
+            j["spenderRaw"] = VtcBlockIndexer::Utility::hashToHex(rawTransactions[spender]);
+            j["spender"] = nullptr;
         }
 
 
@@ -495,12 +827,15 @@ void VtcBlockIndexer::HttpServer::outpointSpends( const shared_ptr< Session > se
     
     
     
-    session->fetch( content_length, [ request, this ]( const shared_ptr< Session > session, const Bytes & body )
+    // The body may arrive later on another thread, keep tracing the request there
+    session->fetch( content_length, [ request, this, trace = VtcBlockIndexer::RequestTracker::current() ]( const shared_ptr< Session > session, const Bytes & body )
     {
+        VtcBlockIndexer::RequestTracker::Scope scope(trace);
         const auto request = session->get_request( );
         int raw = stoi(request->get_query_parameter("raw","0"));
         int unconfirmed = stoi(request->get_query_parameter("unconfirmed","0"));
-        
+        const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
+
 
         string content =string(body.begin(), body.end());
         json output = json::array();
@@ -510,7 +845,6 @@ void VtcBlockIndexer::HttpServer::outpointSpends( const shared_ptr< Session > se
                 if(txo.is_object() && txo["txid"].is_string() && txo["vout"].is_number()) {
                     stringstream txoId;
                     txoId << "txo-" << txo["txid"].get<string>() << "-" << setw(8) << setfill('0') << txo["vout"].get<int>() << "-spent";
-                    cout << "Checking outpoint spent " << txoId.str() << endl;
             
                     json j;
                     j["txid"] = txo["txid"];
@@ -539,7 +873,7 @@ void VtcBlockIndexer::HttpServer::outpointSpends( const shared_ptr< Session > se
                                 j["height"] = stol(blockHeightStr);
                             }   
                         } else if(unconfirmed != 0) {
-                            string mempoolSpend = mempoolMonitor->outpointSpend( txo["txid"].get<string>(), txo["vout"].get<int>());
+                            string mempoolSpend = mempool->outpointSpend( txo["txid"].get<string>(), txo["vout"].get<int>());
                             if(mempoolSpend.compare("") != 0) {
                                 json j;
                                 j["spender"] = mempoolSpend;
@@ -551,38 +885,203 @@ void VtcBlockIndexer::HttpServer::outpointSpends( const shared_ptr< Session > se
                         }
                     }
 
-                    if(raw != 0 && j["spender"].is_string()) {
-                        try {
-                            const Json::Value tx = vertcoind->getrawtransaction(j["spender"].get<string>(), false);
-                            j["spenderRaw"] = tx.asString();
-                            j["spender"] = nullptr;
-                        } catch(const jsonrpc::JsonRpcException& e) {
-                            const std::string message(e.what());
-                            cout << "Not found " << message << endl;
-                        }
-                    }
-
                     output.push_back(j);
                     
                 }
             }
         }
+
+        // Replace the spenders with their raw transactions, read in one batch
+        if(raw != 0) {
+            vector<string> spenders;
+            for(auto& j : output) {
+                if(j["spender"].is_string()) spenders.push_back(j["spender"].get<string>());
+            }
+
+            unordered_map<string, vector<unsigned char>> rawTransactions;
+            string error;
+            getRawTransactions(spenders, rawTransactions, error);
+            for(auto& j : output) {
+                if(j["spender"].is_string()) {
+                    auto rawTx = rawTransactions.find(j["spender"].get<string>());
+                    if(rawTx != rawTransactions.end()) {
+                        j["spenderRaw"] = VtcBlockIndexer::Utility::hashToHex(rawTx->second);
+                        j["spender"] = nullptr;
+                    }
+                }
+            }
+        }
     
         string resultBody = output.dump();
         session->close( OK, resultBody, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(resultBody.size()) } } );
     } );
 } 
 
+void VtcBlockIndexer::HttpServer::addressBalances( const shared_ptr< Session > session )
+{
+    const auto request = session->get_request( );
+    const size_t content_length = request->get_header( "Content-Length", 0);
+
+    // The body may arrive later on another thread, keep tracing the request there
+    session->fetch( content_length, [ request, this, trace = VtcBlockIndexer::RequestTracker::current() ]( const shared_ptr< Session > session, const Bytes & body )
+    {
+        VtcBlockIndexer::RequestTracker::Scope scope(trace);
+        const auto request = session->get_request( );
+        int utxos = stoi(request->get_query_parameter("utxos","0"));
+        int unconfirmed = stoi(request->get_query_parameter("unconfirmed","0"));
+
+        vector<string> addresses;
+        try {
+            json input = json::parse(string(body.begin(), body.end()));
+            for(auto& address : input) {
+                if(address.is_string()) addresses.push_back(address.get<string>());
+            }
+        } catch(const exception& e) {
+            const string error = "Expected a JSON array of addresses";
+            session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
+            return;
+        }
+
+        sort(addresses.begin(), addresses.end());
+        addresses.erase(unique(addresses.begin(), addresses.end()), addresses.end());
+        if(addresses.size() > maxBulkAddresses) {
+            const string error = "At most " + std::to_string(maxBulkAddresses) + " addresses per request";
+            session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
+            return;
+        }
+
+        // Read everything from one snapshot, so a block indexed in between can't show up halfway
+        leveldb::ReadOptions readOptions;
+        readOptions.snapshot = this->db->GetSnapshot();
+        vector<json> results = lookupAddresses(this->db.get(), readOptions, *mempoolMonitor->getSnapshot(), addresses, utxos != 0, unconfirmed != 0);
+        this->db->ReleaseSnapshot(readOptions.snapshot);
+
+        json output = json::object();
+        for(size_t i = 0; i < addresses.size(); i++) {
+            output[addresses[i]] = results[i];
+        }
+
+        string resultBody = output.dump();
+        session->close( OK, resultBody, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(resultBody.size()) } } );
+    } );
+}
+
+void VtcBlockIndexer::HttpServer::walletScan( const shared_ptr< Session > session )
+{
+    const auto request = session->get_request( );
+    const size_t content_length = request->get_header( "Content-Length", 0);
+
+    // The body may arrive later on another thread, keep tracing the request there
+    session->fetch( content_length, [ request, this, trace = VtcBlockIndexer::RequestTracker::current() ]( const shared_ptr< Session > session, const Bytes & body )
+    {
+        VtcBlockIndexer::RequestTracker::Scope scope(trace);
+        const auto request = session->get_request( );
+        int unconfirmed = stoi(request->get_query_parameter("unconfirmed","0"));
+
+        string descriptor;
+        size_t gapLimit = this->gapLimit;
+        try {
+            json input = json::parse(string(body.begin(), body.end()));
+            descriptor = input.at("descriptor").get<string>();
+            if(input.count("gapLimit") != 0) {
+                gapLimit = input["gapLimit"].get<size_t>();
+            }
+        } catch(const exception& e) {
+            const string error = "Expected a JSON object with a descriptor (and optionally a gapLimit)";
+            session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
+            return;
+        }
+
+        vector<VtcBlockIndexer::WalletDescriptor> branches;
+        string error;
+        if(!VtcBlockIndexer::WalletDescriptor::parse(descriptor, branches, error)) {
+            session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
+            return;
+        }
+        if(gapLimit < 1 || gapLimit > maxGapLimit) {
+            error = "The gapLimit must be between 1 and " + std::to_string(maxGapLimit);
+            session->close(400, error, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(error.size())}});
+            return;
+        }
+
+        // All batches read from one snapshot, so the wallet is seen at a single tip
+        leveldb::ReadOptions readOptions;
+        readOptions.snapshot = this->db->GetSnapshot();
+        const shared_ptr<const VtcBlockIndexer::MempoolSnapshot> mempool = mempoolMonitor->getSnapshot();
+
+        json output;
+        output["branches"] = json::array();
+        long long balance = 0;
+        long long unconfirmedBalance = 0;
+        for(const VtcBlockIndexer::WalletDescriptor& branch : branches) {
+            const string pathPrefix = branch.getPath().substr(0, branch.getPath().size() - 1);
+            json jsonBranch;
+            jsonBranch["path"] = branch.getPath();
+            jsonBranch["addresses"] = json::array();
+
+            // Derive up to gapLimit addresses past the last used one at a time, and
+            // look them up together, until a whole gap turned out to be unused
+            uint32_t nextIndex = 0;
+            uint32_t scanEnd = gapLimit;
+            while(nextIndex < scanEnd && nextIndex < maxScanAddresses) {
+                uint32_t batchEnd = min(scanEnd, maxScanAddresses);
+                vector<uint32_t> indexes;
+                vector<string> addresses;
+                for(uint32_t index = nextIndex; index < batchEnd; index++) {
+                    string address = branch.deriveAddress(index);
+                    if(address.empty()) continue; // No valid key at this index, wallets skip it
+                    indexes.push_back(index);
+                    addresses.push_back(address);
+                }
+                nextIndex = batchEnd;
+
+                vector<json> results = lookupAddresses(this->db.get(), readOptions, *mempool, addresses, true, unconfirmed != 0);
+                for(size_t i = 0; i < results.size(); i++) {
+                    json& result = results[i];
+                    if(result["txCount"].get<long long>() == 0 && result["unconfirmedTxCount"].get<long long>() == 0) continue;
+
+                    scanEnd = indexes[i] + 1 + gapLimit;
+                    balance += result["balance"].get<long long>();
+                    unconfirmedBalance += result["unconfirmedBalance"].get<long long>();
+                    result["index"] = indexes[i];
+                    result["path"] = pathPrefix + std::to_string(indexes[i]);
+                    result["address"] = addresses[i];
+                    jsonBranch["addresses"].push_back(result);
+                }
+            }
+
+            jsonBranch["addressesScanned"] = nextIndex;
+            jsonBranch["nextIndex"] = scanEnd - gapLimit;
+            jsonBranch["complete"] = (nextIndex >= scanEnd);
+            output["branches"].push_back(jsonBranch);
+        }
+        this->db->ReleaseSnapshot(readOptions.snapshot);
+
+        output["gapLimit"] = gapLimit;
+        output["balance"] = balance;
+        output["unconfirmedBalance"] = unconfirmedBalance;
+
+        string resultBody = output.dump();
+        session->close( OK, resultBody, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(resultBody.size()) } } );
+    } );
+}
+
 void VtcBlockIndexer::HttpServer::sendRawTransaction( const shared_ptr< Session > session )
 {
     const auto request = session->get_request( );
     const size_t content_length = request->get_header( "Content-Length", 0);
-    session->fetch( content_length, [ request, this ]( const shared_ptr< Session > session, const Bytes & body )
+    // The body may arrive later on another thread, keep tracing the request there
+    session->fetch( content_length, [ request, this, trace = VtcBlockIndexer::RequestTracker::current() ]( const shared_ptr< Session > session, const Bytes & body )
     {
+        VtcBlockIndexer::RequestTracker::Scope scope(trace);
         const string rawtx = string(body.begin(), body.end());
         
         try {
-            const auto txid = vertcoind->sendrawtransaction(rawtx);
+            string txid;
+            {
+                VtcBlockIndexer::RequestTracker::RpcCall rpcCall;
+                txid = vertcoind->sendrawtransaction(rawtx);
+            }
             
             session->close(OK, txid, {{"Content-Type","text/plain"}, {"Content-Length",  std::to_string(txid.size())}});
         } catch(const jsonrpc::JsonRpcException& e) {
@@ -592,48 +1091,314 @@ void VtcBlockIndexer::HttpServer::sendRawTransaction( const shared_ptr< Session
     });
 } 
 
+void VtcBlockIndexer::HttpServer::blockNotify( const shared_ptr< Session > session )
+{
+    const auto request = session->get_request( );
+    const string blockHash = request->get_path_parameter( "hash" );
+    if(blockHash.size() != 64) {
+        const string message = "Invalid block hash";
+        session->close(400, message, {{"Content-Type","text/plain"},{"Content-Length",  std::to_string(message.size())}});
+        return;
+    }
+
+    blockFileWatcher->blockNotify(blockHash);
+
+    session->close(202, "", {{"Content-Length", "0"}});
+}
+
+void VtcBlockIndexer::HttpServer::scriptStats( const shared_ptr< Session > session )
+{
+    VtcBlockIndexer::ScriptStatistics& statistics = VtcBlockIndexer::ScriptSolver::scriptStatistics;
+    json j;
+    j["rangeSize"] = statistics.getRangeSize();
+
+    json ranges = json::array();
+    for(const VtcBlockIndexer::ScriptStatistics::RangeCounts& range : statistics.getRangeCounts()) {
+        json jsonRange;
+        jsonRange["fromHeight"] = range.fromHeight;
+        jsonRange["toHeight"] = range.toHeight;
+        json templates;
+        for(size_t type = 0; type < VtcBlockIndexer::ScriptStatistics::templateCount; type++) {
+            templates[VtcBlockIndexer::ScriptStatistics::templateName(static_cast<VtcBlockIndexer::ScriptTemplate>(type))] = range.counts[type];
+        }
+        jsonRange["templates"] = templates;
+        ranges.push_back(jsonRange);
+    }
+    j["ranges"] = ranges;
+
+    json samples = json::array();
+    for(const VtcBlockIndexer::ScriptStatistics::UnknownScript& unknown : statistics.getUnknownSamples()) {
+        json sample;
+        if(unknown.height >= 0) {
+            sample["height"] = unknown.height;
+        } else {
+            sample["height"] = nullptr;
+        }
+        if(!unknown.txHash.empty()) {
+            sample["txid"] = unknown.txHash;
+            sample["vout"] = unknown.index;
+        }
+        sample["scriptSize"] = unknown.scriptSize;
+        sample["script"] = VtcBlockIndexer::Utility::hashToHex(unknown.script);
+        samples.push_back(sample);
+    }
+
+    json unknownScripts;
+    unknownScripts["seen"] = statistics.getUnknownSeen();
+    unknownScripts["dropped"] = statistics.getUnknownDropped();
+    unknownScripts["samples"] = samples;
+    j["unknownScripts"] = unknownScripts;
+
+    string body = j.dump();
+    session->close( OK, body, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(body.size()) } } );
+}
+
+void VtcBlockIndexer::HttpServer::metrics(const shared_ptr<Session> session) {
+    stringstream ss;
+    VtcBlockIndexer::PrometheusWriter writer(ss);
+
+    VtcBlockIndexer::BlockIndexer::telemetry.writeMetrics(writer);
+    requestTracker.writeMetrics(writer);
+
+    writer.family("vtc_indexer_http_response_cache_hits_total", "counter", "Responses to /blocks and /sync served from the response cache");
+    writer.sample("vtc_indexer_http_response_cache_hits_total", responseCache.getHits());
+    writer.family("vtc_indexer_http_response_cache_misses_total", "counter", "Responses to /blocks and /sync that were built");
+    writer.sample("vtc_indexer_http_response_cache_misses_total", responseCache.getMisses());
+
+    writer.family("vtc_indexer_leveldb_block_cache_bytes", "gauge", "Bytes of blocks in the LevelDB block cache");
+    writer.sample("vtc_indexer_leveldb_block_cache_bytes", blockCache != NULL ? blockCache->TotalCharge() : 0);
+    writer.family("vtc_indexer_leveldb_block_cache_capacity_bytes", "gauge", "Capacity of the LevelDB block cache");
+    writer.sample("vtc_indexer_leveldb_block_cache_capacity_bytes", blockCacheSize);
+    writer.family("vtc_indexer_leveldb_files", "gauge", "Table files per LevelDB level");
+    string files;
+    for(int level = 0; level < 7 && this->db->GetProperty("leveldb.num-files-at-level" + std::to_string(level), &files); level++) {
+        writer.sample("vtc_indexer_leveldb_files", stoll(files), { { "level", std::to_string(level) } });
+    }
+
+    writer.family("vtc_indexer_pubkey_cache_size", "gauge", "Public keys in the address cache");
+    writer.sample("vtc_indexer_pubkey_cache_size", VtcBlockIndexer::ScriptSolver::pubKeyCache.getSize());
+    writer.family("vtc_indexer_pubkey_cache_hits_total", "counter", "Public key address lookups served from the cache");
+    writer.sample("vtc_indexer_pubkey_cache_hits_total", VtcBlockIndexer::ScriptSolver::pubKeyCache.getHits());
+    writer.family("vtc_indexer_pubkey_cache_misses_total", "counter", "Public key address lookups that had to hash the key");
+    writer.sample("vtc_indexer_pubkey_cache_misses_total", VtcBlockIndexer::ScriptSolver::pubKeyCache.getMisses());
+
+    string body = ss.str();
+    session->close( OK, body, { { "Content-Type",  "text/plain; version=0.0.4" }, { "Content-Length",  std::to_string(body.size()) } } );
+}
+
+void VtcBlockIndexer::HttpServer::slowRequests(const shared_ptr<Session> session) {
+    json j;
+    j["thresholdSeconds"] = requestTracker.getSlowThreshold();
+
+    json requests = json::array();
+    for(const VtcBlockIndexer::RequestTracker::SlowRequest& slow : requestTracker.getSlowRequests()) {
+        json jsonSlow;
+        jsonSlow["time"] = slow.time;
+        jsonSlow["endpoint"] = slow.endpoint;
+        jsonSlow["path"] = slow.path;
+        jsonSlow["seconds"] = slow.seconds;
+        jsonSlow["leveldbGets"] = slow.leveldbGets;
+        jsonSlow["iteratorSteps"] = slow.iteratorSteps;
+        jsonSlow["leveldbSeconds"] = slow.leveldbSeconds;
+        jsonSlow["rpcCalls"] = slow.rpcCalls;
+        jsonSlow["rpcSeconds"] = slow.rpcSeconds;
+        requests.push_back(jsonSlow);
+    }
+    j["requests"] = requests;
+
+    string body = j.dump();
+    session->close( OK, body, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(body.size()) } } );
+}
+
+void VtcBlockIndexer::HttpServer::storage(const shared_ptr<Session> session) {
+    const auto request = session->get_request( );
+    json j;
+
+    string value;
+    if(this->db->GetProperty("leveldb.stats", &value)) {
+        j["stats"] = value;
+        j["levels"] = parseLevelStats(value);
+    } else {
+        j["stats"] = nullptr;
+        j["levels"] = json::array();
+    }
+
+    json filesPerLevel = json::array();
+    for(int level = 0; level < 7; level++) {
+        if(!this->db->GetProperty("leveldb.num-files-at-level" + std::to_string(level), &value)) break;
+        filesPerLevel.push_back(stoll(value));
+    }
+    j["filesPerLevel"] = filesPerLevel;
+
+    // Only available in recent LevelDB versions
+    if(this->db->GetProperty("leveldb.approximate-memory-usage", &value)) {
+        j["approximateMemoryUsage"] = stoll(value);
+    } else {
+        j["approximateMemoryUsage"] = nullptr;
+    }
+
+    // The table list has a line per file, only included with ?sstables=1
+    if(request->get_query_parameter("sstables", "0") != "0" && this->db->GetProperty("leveldb.sstables", &value)) {
+        j["sstables"] = value;
+    }
+
+    const size_t rangeCount = sizeof(keyRanges) / sizeof(keyRanges[0]);
+    vector<leveldb::Range> ranges;
+    for(const KeyRange& keyRange : keyRanges) {
+        ranges.push_back(leveldb::Range(keyRange.start, keyRange.limit));
+    }
+    ranges.push_back(leveldb::Range("", "\x7f"));
+    vector<uint64_t> sizes(ranges.size());
+    this->db->GetApproximateSizes(ranges.data(), ranges.size(), sizes.data());
+
+    json keySizes;
+    uint64_t prefixedSize = 0;
+    for(size_t i = 0; i < rangeCount; i++) {
+        keySizes[keyRanges[i].name] = sizes[i];
+        prefixedSize += sizes[i];
+    }
+    uint64_t totalSize = sizes[rangeCount];
+    keySizes["address"] = totalSize > prefixedSize ? totalSize - prefixedSize : 0;
+    keySizes["total"] = totalSize;
+    j["approximateSizes"] = keySizes;
+
+    json cache;
+    cache["capacity"] = blockCacheSize;
+    if(blockCache != NULL) {
+        cache["usage"] = blockCache->TotalCharge();
+        cache["usageRatio"] = blockCacheSize > 0 ? (double)blockCache->TotalCharge() / blockCacheSize : 0;
+    } else {
+        cache["usage"] = nullptr;
+        cache["usageRatio"] = nullptr;
+    }
+    j["blockCache"] = cache;
+    j["bloomFilterBitsPerKey"] = bloomFilterBits;
+
+    string body = j.dump();
+    session->close( OK, body, { { "Content-Type",  "application/json" }, { "Content-Length",  std::to_string(body.size()) } } );
+}
+
+void VtcBlockIndexer::HttpServer::setStorageOptions(leveldb::Cache* blockCache, size_t blockCacheSize, int bloomFilterBits) {
+    this->blockCache = blockCache;
+    this->blockCacheSize = blockCacheSize;
+    this->bloomFilterBits = bloomFilterBits;
+}
+
+void VtcBlockIndexer::HttpServer::setGapLimit(size_t gapLimit) {
+    this->gapLimit = gapLimit;
+}
+
+void VtcBlockIndexer::HttpServer::setAdminInterface(string bindAddress, uint16_t port) {
+    this->adminBindAddress = bindAddress;
+    this->adminPort = port;
+}
+
+void VtcBlockIndexer::HttpServer::setSlowRequestLog(double thresholdSeconds, size_t capacity) {
+    requestTracker.setSlowLog(thresholdSeconds, capacity);
+}
+
+function<void(const shared_ptr<Session>)> VtcBlockIndexer::HttpServer::traced(const string& endpoint, void (VtcBlockIndexer::HttpServer::*handler)(const shared_ptr<Session>)) {
+    requestTracker.addEndpoint(endpoint);
+    return [this, endpoint, handler](const shared_ptr<Session> session) {
+        const auto request = session->get_request();
+        string path = request->get_path();
+        char separator = '?';
+        for(const auto& parameter : request->get_query_parameters()) {
+            path += separator + parameter.first + "=" + parameter.second;
+            separator = '&';
+        }
+
+        VtcBlockIndexer::RequestTracker::Scope scope(requestTracker.start(endpoint, path));
+        (this->*handler)(session);
+    };
+}
+
 void VtcBlockIndexer::HttpServer::run()
 {
     auto addressBalanceResource = make_shared< Resource >( );
     addressBalanceResource->set_path( "/addressBalance/{address: .*}" );
-    addressBalanceResource->set_method_handler( "GET", bind( &VtcBlockIndexer::HttpServer::addressBalance, this, std::placeholders::_1) );
+    addressBalanceResource->set_method_handler( "GET", traced("addressBalance", &VtcBlockIndexer::HttpServer::addressBalance) );
 
     auto addressTxosResource = make_shared< Resource >( );
     addressTxosResource->set_path( "/addressTxos/{address: .*}" );
-    addressTxosResource->set_method_handler( "GET", bind( &VtcBlockIndexer::HttpServer::addressTxos, this, std::placeholders::_1) );
+    addressTxosResource->set_method_handler( "GET", traced("addressTxos", &VtcBlockIndexer::HttpServer::addressTxos) );
 
     auto addressTxosSinceBlockResource = make_shared< Resource >( );
     addressTxosSinceBlockResource->set_path( "/addressTxosSince/{sinceBlock: ^[0-9]*$}/{address: .*}" );
-    addressTxosSinceBlockResource->set_method_handler( "GET", bind( &VtcBlockIndexer::HttpServer::addressTxos, this, std::placeholders::_1) );
+    addressTxosSinceBlockResource->set_method_handler( "GET", traced("addressTxosSince", &VtcBlockIndexer::HttpServer::addressTxos) );
     
     auto getTransactionResource = make_shared<Resource>();
     getTransactionResource->set_path( "/getTransaction/{id: [0-9a-f]*}" );
-    getTransactionResource->set_method_handler("GET", bind(&VtcBlockIndexer::HttpServer::getTransaction, this, std::placeholders::_1) );
+    getTransactionResource->set_method_handler("GET", traced("getTransaction", &VtcBlockIndexer::HttpServer::getTransaction) );
 
     auto getTransactionProofResource = make_shared<Resource>();
     getTransactionProofResource->set_path( "/getTransactionProof/{id: [0-9a-f]*}" );
-    getTransactionProofResource->set_method_handler("GET", bind(&VtcBlockIndexer::HttpServer::getTransactionProof, this, std::placeholders::_1) );
+    getTransactionProofResource->set_method_handler("GET", traced("getTransactionProof", &VtcBlockIndexer::HttpServer::getTransactionProof) );
 
     auto outpointSpendResource = make_shared<Resource>();
     outpointSpendResource->set_path( "/outpointSpend/{txid: .*}/{vout: .*}" );
-    outpointSpendResource->set_method_handler("GET", bind(&VtcBlockIndexer::HttpServer::outpointSpend, this, std::placeholders::_1) );
+    outpointSpendResource->set_method_handler("GET", traced("outpointSpend", &VtcBlockIndexer::HttpServer::outpointSpend) );
 
     auto outpointSpendsResource = make_shared<Resource>();
     outpointSpendsResource->set_path( "/outpointSpends" );
-    outpointSpendsResource->set_method_handler("POST", bind(&VtcBlockIndexer::HttpServer::outpointSpends, this, std::placeholders::_1) );
+    outpointSpendsResource->set_method_handler("POST", traced("outpointSpends", &VtcBlockIndexer::HttpServer::outpointSpends) );
+
+    auto addressBalancesResource = make_shared<Resource>();
+    addressBalancesResource->set_path( "/addressBalances" );
+    addressBalancesResource->set_method_handler("POST", traced("addressBalances", &VtcBlockIndexer::HttpServer::addressBalances) );
+
+    auto walletScanResource = make_shared<Resource>();
+    walletScanResource->set_path( "/walletScan" );
+    walletScanResource->set_method_handler("POST", traced("walletScan", &VtcBlockIndexer::HttpServer::walletScan) );
 
     auto sendRawTransactionResource = make_shared<Resource>();
     sendRawTransactionResource->set_path( "/sendRawTransaction" );
-    sendRawTransactionResource->set_method_handler("POST", bind(&VtcBlockIndexer::HttpServer::sendRawTransaction, this, std::placeholders::_1) );
+    sendRawTransactionResource->set_method_handler("POST", traced("sendRawTransaction", &VtcBlockIndexer::HttpServer::sendRawTransaction) );
+
+    auto blockNotifyResource = make_shared<Resource>();
+    blockNotifyResource->set_path( "/blockNotify/{hash: ^[0-9a-f]+$}" );
+    blockNotifyResource->set_method_handler("POST", traced("blockNotify", &VtcBlockIndexer::HttpServer::blockNotify) );
 
     auto blocksResource = make_shared<Resource>();
     blocksResource->set_path( "/blocks" );
-    blocksResource->set_method_handler("GET", bind(&VtcBlockIndexer::HttpServer::getBlocks, this, std::placeholders::_1) );
+    blocksResource->set_method_handler("GET", traced("blocks", &VtcBlockIndexer::HttpServer::getBlocks) );
 
     auto syncResource = make_shared<Resource>();
     syncResource->set_path( "/sync" );
-    syncResource->set_method_handler("GET", bind(&VtcBlockIndexer::HttpServer::sync, this, std::placeholders::_1) );
-
+    syncResource->set_method_handler("GET", traced("sync", &VtcBlockIndexer::HttpServer::sync) );
+
+    auto scriptStatsResource = make_shared<Resource>();
+    scriptStatsResource->set_path( "/scriptStats" );
+    scriptStatsResource->set_method_handler("GET", traced("scriptStats", &VtcBlockIndexer::HttpServer::scriptStats) );
+
+
+    auto metricsResource = make_shared<Resource>();
+    metricsResource->set_path( "/metrics" );
+    metricsResource->set_method_handler("GET", traced("metrics", &VtcBlockIndexer::HttpServer::metrics) );
+
+    auto storageResource = make_shared<Resource>();
+    storageResource->set_path( "/debug/storage" );
+    storageResource->set_method_handler("GET", traced("storage", &VtcBlockIndexer::HttpServer::storage) );
+
+    auto slowRequestsResource = make_shared<Resource>();
+    slowRequestsResource->set_path( "/debug/slowRequests" );
+    slowRequestsResource->set_method_handler("GET", traced("slowRequests", &VtcBlockIndexer::HttpServer::slowRequests) );
+
+    // The admin interface runs on its own thread, without the CORS header
+    if(adminPort != 0) {
+        std::thread([this, blockNotifyResource, storageResource, slowRequestsResource]() {
+            auto adminSettings = make_shared< Settings >( );
+            adminSettings->set_bind_address( adminBindAddress );
+            adminSettings->set_port( adminPort );
+            adminSettings->set_default_header( "Connection", "close" );
+
+            Service adminService;
+            adminService.publish( blockNotifyResource );
+            adminService.publish( storageResource );
+            adminService.publish( slowRequestsResource );
+            adminService.start( adminSettings );
+        }).detach();
+    }
 
     auto settings = make_shared< Settings >( );
     settings->set_port( 8888 );
@@ -648,8 +1413,12 @@ void VtcBlockIndexer::HttpServer::run()
     service.publish( getTransactionProofResource );
     service.publish( outpointSpendResource );
     service.publish( outpointSpendsResource );
+    service.publish( addressBalancesResource );
+    service.publish( walletScanResource );
     service.publish( sendRawTransactionResource );
     service.publish( blocksResource );
     service.publish( syncResource );
+    service.publish( scriptStatsResource );
+    service.publish( metricsResource );
     service.start( settings );
 }
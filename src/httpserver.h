@@ -22,15 +22,19 @@
 */
 
 #include <restbed>
-#include <jsonrpccpp/client/connectors/httpclient.h>
 
 #include "leveldb/db.h"
 #include "leveldb/write_batch.h"
+#include "leveldb/cache.h"
 
 #include "vertcoinrpc.h"
+#include "persistenthttpclient.h"
 #include "blockreader.h"
 #include "scriptsolver.h"
 #include "mempoolmonitor.h"
+#include "blockfilewatcher.h"
+#include "requesttracker.h"
+#include "responsecache.h"
 
 using namespace std;
 using namespace restbed;
@@ -44,8 +48,25 @@ namespace VtcBlockIndexer {
     
     class HttpServer {
         public:
-            HttpServer(const shared_ptr<leveldb::DB> db, const shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor, string blocksDir);
+            HttpServer(const shared_ptr<leveldb::DB> db, const shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor, const shared_ptr<VtcBlockIndexer::BlockFileWatcher> blockFileWatcher, string blocksDir);
             void run();
+
+            /** Logs requests that take longer than thresholdSeconds, keeping the last
+             * capacity of them for /debug/slowRequests. Call before run(). */
+            void setSlowRequestLog(double thresholdSeconds, size_t capacity);
+
+            /** Tells the server the block cache and bloom filter size the database
+             * was opened with, for /debug/storage. Call before run(). */
+            void setStorageOptions(leveldb::Cache* blockCache, size_t blockCacheSize, int bloomFilterBits);
+
+            /** Sets the number of consecutive unused addresses after which /walletScan
+             * stops scanning a branch, unless the request asks for another. Call before run(). */
+            void setGapLimit(size_t gapLimit);
+
+            /** Sets the address and port of the admin interface, which serves the endpoints
+             * that must not be public (/blockNotify and the /debug endpoints). Port 0 disables it. Call before run(). */
+            void setAdminInterface(string bindAddress, uint16_t port);
+
             /* REST Api for returning the balance of a given address */
             void addressBalance( const shared_ptr< Session > session );
 
@@ -70,16 +91,66 @@ namespace VtcBlockIndexer {
             /* REST Api for returning sync status */
             void sync( const shared_ptr< Session > session );
 
+            /* REST Api for returning the balances (and optionally the UTXOs) of a collection of addresses */
+            void addressBalances( const shared_ptr< Session > session );
+
+            /* REST Api for finding the used addresses of an extended public key or descriptor, with their balances and UTXOs */
+            void walletScan( const shared_ptr< Session > session );
+
             /* REST Api for sending a hex transaction on the VTC p2p network*/
             void sendRawTransaction( const shared_ptr< Session > session );
+
+            /* REST Api for the coin daemon's -blocknotify to trigger indexing a new block right away */
+            void blockNotify( const shared_ptr< Session > session );
+
+            /* REST Api for returning the output script templates seen per height range and a sample of unrecognized scripts */
+            void scriptStats( const shared_ptr< Session > session );
+
+            /* REST Api for returning the indexing telemetry in the Prometheus text format */
+            void metrics( const shared_ptr< Session > session );
+
+            /* REST Api for returning the most recent requests that were slower than the threshold */
+            void slowRequests( const shared_ptr< Session > session );
+
+            /* REST Api for returning LevelDB's statistics, the approximate size per kind of key and the block cache usage */
+            void storage( const shared_ptr< Session > session );
             
         private:
+            /** Fetches the raw transactions for the given txids. Transactions in the index
+             * are read from the block files using their indexed file position, others (i.e.
+             * mempool transactions) are requested from the coin daemon. Returns false if 
+             * one or more transactions could not be found, the error is stored in error.
+             */
+            bool getRawTransactions(const vector<string>& txids, unordered_map<string, vector<unsigned char>>& rawTransactions, string& error);
+
+            /** Builds the body of /blocks with the given number of blocks */
+            string getBlocksBody(long long limitParam);
+
+            /** Builds the body of /sync */
+            string getSyncBody();
+
+            /** Responds with a cached body and its ETag, or with 304 Not Modified when the
+             * request's If-None-Match has the ETag already */
+            void respondCached(const shared_ptr<Session> session, const shared_ptr<const VtcBlockIndexer::ResponseCache::Entry>& entry);
+
+            /** Wraps a handler to time its requests as the given endpoint */
+            function<void(const shared_ptr<Session>)> traced(const string& endpoint, void (HttpServer::*handler)(const shared_ptr<Session>));
+
             shared_ptr<leveldb::DB> db;
             unique_ptr<VertcoinClient> vertcoind;
-            unique_ptr<jsonrpc::HttpClient> httpClient;
+            unique_ptr<VtcBlockIndexer::PersistentHttpClient> httpClient;
             unique_ptr<VtcBlockIndexer::BlockReader> blockReader;
             unique_ptr<VtcBlockIndexer::ScriptSolver> scriptSolver;
             shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor;
+            shared_ptr<VtcBlockIndexer::BlockFileWatcher> blockFileWatcher;
+            VtcBlockIndexer::RequestTracker requestTracker;
+            VtcBlockIndexer::ResponseCache responseCache;
+            leveldb::Cache* blockCache;
+            size_t blockCacheSize;
+            int bloomFilterBits;
+            size_t gapLimit;
+            string adminBindAddress;
+            uint16_t adminPort;
             /** Directory containing the blocks
              */
             string blocksDir; 
@@ -0,0 +1,182 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "indexingtelemetry.h"
+
+using namespace std;
+
+VtcBlockIndexer::IndexingTelemetry::IndexingTelemetry() :
+    started(chrono::steady_clock::now()),
+    phase((int)Phase::Idle), height(0), updateStartedAt(0), updates(0), filesScanned(0), blocksScanned(0),
+    blocksRead(0), bytesRead(0), blocksIndexed(0), transactionsIndexed(0), inputsIndexed(0), outputsIndexed(0),
+    keysWritten(0), reorgs(0), blocksPerSecond(0), transactionsPerSecond(0), ratesMeasuredAt(0),
+    windowStart(0), windowHeight(0), windowTransactions(0),
+    fileScanSeconds(Histogram::exponentialBounds(0.001, 2, 16)),
+    blockReadSeconds(Histogram::exponentialBounds(0.00001, 2, 20)),
+    scriptSolveSeconds(Histogram::exponentialBounds(0.00001, 2, 20)),
+    writeSeconds(Histogram::exponentialBounds(0.00001, 2, 20)),
+    writesPerBlock(Histogram::exponentialBounds(8, 2, 16)),
+    blockIndexSeconds(Histogram::exponentialBounds(0.00001, 2, 20)) {
+}
+
+double VtcBlockIndexer::IndexingTelemetry::now() const {
+    return chrono::duration<double>(chrono::steady_clock::now() - started).count();
+}
+
+void VtcBlockIndexer::IndexingTelemetry::updateStarted() {
+    updates++;
+    updateStartedAt = now();
+    phase = (int)Phase::Scanning;
+}
+
+void VtcBlockIndexer::IndexingTelemetry::fileScanned(double seconds, uint64_t blocks) {
+    filesScanned++;
+    blocksScanned += blocks;
+    fileScanSeconds.observe(seconds);
+}
+
+void VtcBlockIndexer::IndexingTelemetry::constructionStarted() {
+    phase = (int)Phase::Constructing;
+    windowStart = now();
+    windowHeight = 0;
+    windowTransactions = transactionsIndexed;
+}
+
+void VtcBlockIndexer::IndexingTelemetry::updateFinished() {
+    phase = (int)Phase::Idle;
+}
+
+void VtcBlockIndexer::IndexingTelemetry::blockRead(double seconds, uint64_t bytes) {
+    blocksRead++;
+    bytesRead += bytes;
+    blockReadSeconds.observe(seconds);
+}
+
+void VtcBlockIndexer::IndexingTelemetry::blockIndexed(uint64_t transactions, uint64_t inputs, uint64_t outputs, double solveSeconds, double writeSeconds, uint64_t writes, double totalSeconds) {
+    blocksIndexed++;
+    transactionsIndexed += transactions;
+    inputsIndexed += inputs;
+    outputsIndexed += outputs;
+    keysWritten += writes;
+    scriptSolveSeconds.observe(solveSeconds);
+    this->writeSeconds.observe(writeSeconds);
+    writesPerBlock.observe(writes);
+    blockIndexSeconds.observe(totalSeconds);
+}
+
+void VtcBlockIndexer::IndexingTelemetry::blockProcessed(uint64_t height) {
+    this->height = height;
+
+    double time = now();
+    double elapsed = time - windowStart;
+    if(elapsed < 5) return;
+
+    uint64_t transactions = transactionsIndexed;
+    blocksPerSecond = (height > windowHeight) ? (height - windowHeight) / elapsed : 0;
+    transactionsPerSecond = (transactions - windowTransactions) / elapsed;
+    ratesMeasuredAt = time;
+
+    windowStart = time;
+    windowHeight = height;
+    windowTransactions = transactions;
+}
+
+void VtcBlockIndexer::IndexingTelemetry::reorg() {
+    reorgs++;
+}
+
+VtcBlockIndexer::IndexingTelemetry::Progress VtcBlockIndexer::IndexingTelemetry::getProgress() const {
+    Progress progress;
+    progress.phase = (Phase)phase.load();
+    progress.height = height;
+
+    double time = now();
+    bool ratesCurrent = progress.phase == Phase::Constructing && time - ratesMeasuredAt < 15;
+    progress.blocksPerSecond = ratesCurrent ? blocksPerSecond.load() : 0;
+    progress.transactionsPerSecond = ratesCurrent ? transactionsPerSecond.load() : 0;
+    progress.updateSeconds = (progress.phase == Phase::Idle) ? 0 : time - updateStartedAt;
+    return progress;
+}
+
+vector<pair<string, VtcBlockIndexer::Histogram::Snapshot>> VtcBlockIndexer::IndexingTelemetry::getStages() const {
+    return {
+        { "fileScan", fileScanSeconds.snapshot() },
+        { "blockRead", blockReadSeconds.snapshot() },
+        { "scriptSolve", scriptSolveSeconds.snapshot() },
+        { "write", writeSeconds.snapshot() },
+        { "blockIndex", blockIndexSeconds.snapshot() }
+    };
+}
+
+void VtcBlockIndexer::IndexingTelemetry::writeMetrics(PrometheusWriter& writer) const {
+    Progress progress = getProgress();
+
+    writer.family("vtc_indexer_phase", "gauge", "Current indexer phase (0 idle, 1 scanning block files, 2 constructing the chain)");
+    writer.sample("vtc_indexer_phase", (int)progress.phase);
+    writer.family("vtc_indexer_height", "gauge", "Height the indexer has processed up to");
+    writer.sample("vtc_indexer_height", progress.height);
+    writer.family("vtc_indexer_blocks_per_second", "gauge", "Blocks processed per second over the last few seconds");
+    writer.sample("vtc_indexer_blocks_per_second", progress.blocksPerSecond);
+    writer.family("vtc_indexer_transactions_per_second", "gauge", "Transactions indexed per second over the last few seconds");
+    writer.sample("vtc_indexer_transactions_per_second", progress.transactionsPerSecond);
+
+    writer.family("vtc_indexer_updates_total", "counter", "Index updates (block file scans) started");
+    writer.sample("vtc_indexer_updates_total", updates);
+    writer.family("vtc_indexer_files_scanned_total", "counter", "Block files scanned");
+    writer.sample("vtc_indexer_files_scanned_total", filesScanned);
+    writer.family("vtc_indexer_blocks_scanned_total", "counter", "Blocks found while scanning block files");
+    writer.sample("vtc_indexer_blocks_scanned_total", blocksScanned);
+    writer.family("vtc_indexer_blocks_read_total", "counter", "Blocks read and parsed from the block files");
+    writer.sample("vtc_indexer_blocks_read_total", blocksRead);
+    writer.family("vtc_indexer_bytes_read_total", "counter", "Bytes of blocks read from the block files");
+    writer.sample("vtc_indexer_bytes_read_total", bytesRead);
+    writer.family("vtc_indexer_blocks_indexed_total", "counter", "Blocks written to the index");
+    writer.sample("vtc_indexer_blocks_indexed_total", blocksIndexed);
+    writer.family("vtc_indexer_transactions_indexed_total", "counter", "Transactions written to the index");
+    writer.sample("vtc_indexer_transactions_indexed_total", transactionsIndexed);
+    writer.family("vtc_indexer_inputs_indexed_total", "counter", "Transaction inputs written to the index");
+    writer.sample("vtc_indexer_inputs_indexed_total", inputsIndexed);
+    writer.family("vtc_indexer_outputs_indexed_total", "counter", "Transaction outputs written to the index");
+    writer.sample("vtc_indexer_outputs_indexed_total", outputsIndexed);
+    writer.family("vtc_indexer_keys_written_total", "counter", "Keys written to LevelDB while indexing blocks");
+    writer.sample("vtc_indexer_keys_written_total", keysWritten);
+    writer.family("vtc_indexer_reorgs_total", "counter", "Indexed blocks that were replaced by a block of another chain");
+    writer.sample("vtc_indexer_reorgs_total", reorgs);
+
+    writer.family("vtc_indexer_file_scan_seconds", "histogram", "Time to scan a block file for block headers");
+    writer.histogram("vtc_indexer_file_scan_seconds", fileScanSeconds.snapshot());
+    writer.family("vtc_indexer_block_read_seconds", "histogram", "Time to read and parse a block");
+    writer.histogram("vtc_indexer_block_read_seconds", blockReadSeconds.snapshot());
+    writer.family("vtc_indexer_script_solve_seconds", "histogram", "Time per block spent classifying output scripts and deriving addresses");
+    writer.histogram("vtc_indexer_script_solve_seconds", scriptSolveSeconds.snapshot());
+    writer.family("vtc_indexer_write_seconds", "histogram", "Time per block spent writing keys to LevelDB");
+    writer.histogram("vtc_indexer_write_seconds", writeSeconds.snapshot());
+    writer.family("vtc_indexer_writes_per_block", "histogram", "Keys written to LevelDB per block");
+    writer.histogram("vtc_indexer_writes_per_block", writesPerBlock.snapshot());
+    writer.family("vtc_indexer_block_index_seconds", "histogram", "Total time to index a block, excluding reading it");
+    writer.histogram("vtc_indexer_block_index_seconds", blockIndexSeconds.snapshot());
+}
+
+const char* VtcBlockIndexer::IndexingTelemetry::phaseName(Phase phase) {
+    switch(phase) {
+        case Phase::Scanning: return "scanning";
+        case Phase::Constructing: return "constructing";
+        default: return "idle";
+    }
+}
@@ -0,0 +1,149 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INDEXINGTELEMETRY_H_INCLUDED
+#define INDEXINGTELEMETRY_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include "histogram.h"
+#include "prometheuswriter.h"
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The IndexingTelemetry class keeps counters and timing histograms of the indexing
+ * pipeline: scanning the block files, reading blocks, solving their scripts and
+ * writing them to LevelDB. Everything is kept in atomics, so the HTTP server can
+ * read it while the indexer writes it. The progress (height and rates) is recorded
+ * by the single indexing thread.
+ */
+
+class IndexingTelemetry {
+public:
+    /** What the indexer is doing */
+    enum class Phase : int {
+        Idle = 0,
+        Scanning = 1,
+        Constructing = 2
+    };
+
+    /** Progress of the indexer. The rates are measured over the last few seconds and
+     * are zero when the indexer has not made progress recently. */
+    struct Progress {
+        Phase phase;
+        uint64_t height;
+        double blocksPerSecond;
+        double transactionsPerSecond;
+
+        // Seconds since the running index update started, 0 when idle
+        double updateSeconds;
+    };
+
+    IndexingTelemetry();
+
+    /** Marks the start of an index update, which starts by scanning the block files */
+    void updateStarted();
+
+    /** Records the scan of one block file */
+    void fileScanned(double seconds, uint64_t blocks);
+
+    /** Marks the end of scanning, the longest chain is constructed from here */
+    void constructionStarted();
+
+    /** Marks the end of an index update */
+    void updateFinished();
+
+    /** Records reading and parsing a block from its block file */
+    void blockRead(double seconds, uint64_t bytes);
+
+    /** Records indexing a block: the time spent in the script solver, writing to LevelDB 
+     * (and the number of keys written), and in total */
+    void blockIndexed(uint64_t transactions, uint64_t inputs, uint64_t outputs, double solveSeconds, double writeSeconds, uint64_t writes, double totalSeconds);
+
+    /** Records that the block at the given height is in the index (indexed now, or 
+     * before), and updates the rates every few seconds. Called from the indexing 
+     * thread only. */
+    void blockProcessed(uint64_t height);
+
+    /** Records that a block at an indexed height was replaced */
+    void reorg();
+
+    /** Returns the current progress */
+    Progress getProgress() const;
+
+    /** Returns the timing histograms of the pipeline stages by name (fileScan, blockRead, 
+     * scriptSolve, write and blockIndex), in seconds */
+    vector<pair<string, Histogram::Snapshot>> getStages() const;
+
+    /** Writes all metrics in the Prometheus text format */
+    void writeMetrics(PrometheusWriter& writer) const;
+
+    /** Returns the name of the phase as used in the API (e.g. "scanning") */
+    static const char* phaseName(Phase phase);
+
+private:
+    /** Seconds since the telemetry was constructed */
+    double now() const;
+
+    chrono::steady_clock::time_point started;
+
+    atomic<int> phase;
+    atomic<uint64_t> height;
+    atomic<double> updateStartedAt;
+    atomic<uint64_t> updates;
+    atomic<uint64_t> filesScanned;
+    atomic<uint64_t> blocksScanned;
+    atomic<uint64_t> blocksRead;
+    atomic<uint64_t> bytesRead;
+    atomic<uint64_t> blocksIndexed;
+    atomic<uint64_t> transactionsIndexed;
+    atomic<uint64_t> inputsIndexed;
+    atomic<uint64_t> outputsIndexed;
+    atomic<uint64_t> keysWritten;
+    atomic<uint64_t> reorgs;
+
+    // Rates over the last window, and when they were measured
+    atomic<double> blocksPerSecond;
+    atomic<double> transactionsPerSecond;
+    atomic<double> ratesMeasuredAt;
+
+    // Start of the current rate window, only used by the indexing thread
+    double windowStart;
+    uint64_t windowHeight;
+    uint64_t windowTransactions;
+
+    Histogram fileScanSeconds;
+    Histogram blockReadSeconds;
+    Histogram scriptSolveSeconds;
+    Histogram writeSeconds;
+    Histogram writesPerBlock;
+    Histogram blockIndexSeconds;
+};
+
+}
+
+#endif // INDEXINGTELEMETRY_H_INCLUDED
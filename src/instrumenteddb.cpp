@@ -0,0 +1,100 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "instrumenteddb.h"
+#include "requesttracker.h"
+#include <chrono>
+
+using namespace std;
+
+namespace {
+    /** Passes an iterator through, reporting its seeks and steps */
+    class InstrumentedIterator : public leveldb::Iterator {
+    public:
+        InstrumentedIterator(leveldb::Iterator* it) : it(it) {
+        }
+
+        virtual bool Valid() const { return it->Valid(); }
+        virtual void SeekToFirst() { auto start = chrono::steady_clock::now(); it->SeekToFirst(); VtcBlockIndexer::RequestTracker::iteratorStep(chrono::steady_clock::now() - start); }
+        virtual void SeekToLast() { auto start = chrono::steady_clock::now(); it->SeekToLast(); VtcBlockIndexer::RequestTracker::iteratorStep(chrono::steady_clock::now() - start); }
+        virtual void Seek(const leveldb::Slice& target) { auto start = chrono::steady_clock::now(); it->Seek(target); VtcBlockIndexer::RequestTracker::iteratorStep(chrono::steady_clock::now() - start); }
+        virtual void Next() { auto start = chrono::steady_clock::now(); it->Next(); VtcBlockIndexer::RequestTracker::iteratorStep(chrono::steady_clock::now() - start); }
+        virtual void Prev() { auto start = chrono::steady_clock::now(); it->Prev(); VtcBlockIndexer::RequestTracker::iteratorStep(chrono::steady_clock::now() - start); }
+        virtual leveldb::Slice key() const { return it->key(); }
+        virtual leveldb::Slice value() const { return it->value(); }
+        virtual leveldb::Status status() const { return it->status(); }
+
+    private:
+        unique_ptr<leveldb::Iterator> it;
+    };
+}
+
+VtcBlockIndexer::InstrumentedDB::InstrumentedDB(const shared_ptr<leveldb::DB> db) {
+    this->db = db;
+}
+
+leveldb::Status VtcBlockIndexer::InstrumentedDB::Put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value) {
+    return db->Put(options, key, value);
+}
+
+leveldb::Status VtcBlockIndexer::InstrumentedDB::Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key) {
+    return db->Delete(options, key);
+}
+
+leveldb::Status VtcBlockIndexer::InstrumentedDB::Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates) {
+    return db->Write(options, updates);
+}
+
+leveldb::Status VtcBlockIndexer::InstrumentedDB::Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) {
+    if(!VtcBlockIndexer::RequestTracker::tracing()) {
+        return db->Get(options, key, value);
+    }
+
+    auto start = chrono::steady_clock::now();
+    leveldb::Status s = db->Get(options, key, value);
+    VtcBlockIndexer::RequestTracker::leveldbGet(chrono::steady_clock::now() - start);
+    return s;
+}
+
+leveldb::Iterator* VtcBlockIndexer::InstrumentedDB::NewIterator(const leveldb::ReadOptions& options) {
+    if(!VtcBlockIndexer::RequestTracker::tracing()) {
+        return db->NewIterator(options);
+    }
+    return new InstrumentedIterator(db->NewIterator(options));
+}
+
+const leveldb::Snapshot* VtcBlockIndexer::InstrumentedDB::GetSnapshot() {
+    return db->GetSnapshot();
+}
+
+void VtcBlockIndexer::InstrumentedDB::ReleaseSnapshot(const leveldb::Snapshot* snapshot) {
+    db->ReleaseSnapshot(snapshot);
+}
+
+bool VtcBlockIndexer::InstrumentedDB::GetProperty(const leveldb::Slice& property, std::string* value) {
+    return db->GetProperty(property, value);
+}
+
+void VtcBlockIndexer::InstrumentedDB::GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes) {
+    db->GetApproximateSizes(range, n, sizes);
+}
+
+void VtcBlockIndexer::InstrumentedDB::CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end) {
+    db->CompactRange(begin, end);
+}
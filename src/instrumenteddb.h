@@ -0,0 +1,60 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INSTRUMENTEDDB_H_INCLUDED
+#define INSTRUMENTEDDB_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include "leveldb/db.h"
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The InstrumentedDB class wraps a LevelDB database and reports the reads and 
+ * iterator steps done on it to the RequestTracker, so they are counted for the 
+ * request handled on the calling thread. Everything else is passed through.
+ */
+
+class InstrumentedDB : public leveldb::DB {
+public:
+    /** Constructs a wrapper around the given database */
+    InstrumentedDB(const shared_ptr<leveldb::DB> db);
+
+    virtual leveldb::Status Put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value);
+    virtual leveldb::Status Delete(const leveldb::WriteOptions& options, const leveldb::Slice& key);
+    virtual leveldb::Status Write(const leveldb::WriteOptions& options, leveldb::WriteBatch* updates);
+    virtual leveldb::Status Get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value);
+    virtual leveldb::Iterator* NewIterator(const leveldb::ReadOptions& options);
+    virtual const leveldb::Snapshot* GetSnapshot();
+    virtual void ReleaseSnapshot(const leveldb::Snapshot* snapshot);
+    virtual bool GetProperty(const leveldb::Slice& property, std::string* value);
+    virtual void GetApproximateSizes(const leveldb::Range* range, int n, uint64_t* sizes);
+    virtual void CompactRange(const leveldb::Slice* begin, const leveldb::Slice* end);
+
+private:
+    shared_ptr<leveldb::DB> db;
+};
+
+}
+
+#endif // INSTRUMENTEDDB_H_INCLUDED
@@ -36,7 +36,10 @@
 #include "httpserver.h"
 #include "mempoolmonitor.h"
 #include "blockfilewatcher.h"
+#include "electrumserver.h"
 #include <thread>
+#include <signal.h>
+#include <unistd.h>
 #include "cxxopts.hpp"
 #include "coinparams.h"
 
@@ -47,6 +50,8 @@ shared_ptr<leveldb::DB> database;
 shared_ptr<VtcBlockIndexer::HttpServer> httpServer;
 shared_ptr<VtcBlockIndexer::BlockFileWatcher> blockFileWatcher;
 shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor;
+shared_ptr<VtcBlockIndexer::ElectrumServer> electrumServer;
+leveldb::Cache* databaseCache;
 
 void runBlockfileWatcher() {
     cout << "Starting blockfile watcher..." << endl;
@@ -58,12 +63,32 @@ void runMempoolMonitor() {
     mempoolMonitor->startWatcher();
 }
 
-void openDatabase(std::string indexDir) {
+void runElectrumServer(int port, size_t threads) {
+    cout << "Starting Electrum server..." << endl;
+    electrumServer->run(port, threads);
+}
+
+void runMempoolNotificationListener(std::string endpoint) {
+    mempoolMonitor->startNotificationListener(endpoint);
+}
+
+void waitForShutdown(sigset_t signals) {
+    int signal;
+    sigwait(&signals, &signal);
+    cout << "Shutting down, saving mempool..." << endl;
+    mempoolMonitor->persist();
+    // The other threads are still running, exit() would destroy the database under
+    // them. LevelDB recovers an interrupted write from its log on the next start.
+    _exit(0);
+}
+
+void openDatabase(std::string indexDir, size_t cacheSize, int bloomFilterBits) {
     leveldb::DB* db;
     leveldb::Options options;
     options.create_if_missing = true;
-    options.block_cache = leveldb::NewLRUCache(300 * 1024 * 1024);
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    databaseCache = leveldb::NewLRUCache(cacheSize);
+    options.block_cache = databaseCache;
+    options.filter_policy = leveldb::NewBloomFilterPolicy(bloomFilterBits);
     leveldb::Status status = leveldb::DB::Open(options, indexDir, &db);
     assert(status.ok());
     database.reset(db);
@@ -77,6 +102,21 @@ int main(int argc, char* argv[]) {
     ("coinParams", "Coin parameters file", cxxopts::value<std::string>())
     ("indexDir", "Directory to save the indexes [Default: /index]", cxxopts::value<std::string>()->default_value("/index"))
     ("blocksDir", "Directory where the block files are located [Default: /blocks]", cxxopts::value<std::string>()->default_value("/blocks"))
+    ("dbCacheSize", "Size of the LevelDB block cache in MiB [Default: 300]", cxxopts::value<size_t>()->default_value("300"))
+    ("bloomFilterBits", "Bits per key of the LevelDB bloom filters [Default: 10]", cxxopts::value<int>()->default_value("10"))
+    ("pubKeyCacheSize", "Number of public keys to keep the address of in memory [Default: 100000]", cxxopts::value<size_t>()->default_value("100000"))
+    ("scriptStatsRange", "Number of blocks per height range in the script template statistics [Default: 10000]", cxxopts::value<uint64_t>()->default_value("10000"))
+    ("unknownScriptSamples", "Number of unrecognized output scripts to keep for /scriptStats [Default: 100]", cxxopts::value<size_t>()->default_value("100"))
+    ("unknownScriptSampleRate", "Keep one in this many unrecognized output scripts [Default: 1]", cxxopts::value<uint64_t>()->default_value("1"))
+    ("slowRequestMs", "Requests taking longer than this many milliseconds are kept for /debug/slowRequests [Default: 1000]", cxxopts::value<double>()->default_value("1000"))
+    ("slowRequestLog", "Number of slow requests to keep [Default: 100]", cxxopts::value<size_t>()->default_value("100"))
+    ("gapLimit", "Number of consecutive unused addresses after which /walletScan stops scanning [Default: 20]", cxxopts::value<size_t>()->default_value("20"))
+    ("electrumPort", "Port to serve the Electrum protocol on [Default: 0, disabled]", cxxopts::value<int>()->default_value("0"))
+    ("electrumThreads", "Number of event loop threads serving Electrum connections [Default: 2]", cxxopts::value<size_t>()->default_value("2"))
+    ("adminPort", "Port of the admin interface serving /blockNotify and the /debug endpoints [Default: 8889, 0 disables]", cxxopts::value<int>()->default_value("8889"))
+    ("adminBindAddress", "Address the admin interface listens on [Default: 127.0.0.1]", cxxopts::value<std::string>()->default_value("127.0.0.1"))
+    ("mempoolFile", "File to save the mempool to on shutdown [Default: <indexDir>-mempool.dat]", cxxopts::value<std::string>()->default_value(""))
+    ("zmqEndpoint", "ZeroMQ endpoint the coin daemon publishes rawtx and hashblock on, e.g. tcp://vertcoind:28332 [Default: poll only]", cxxopts::value<std::string>()->default_value(""))
     ;
 
     options.parse(argc, argv);
@@ -87,20 +127,52 @@ int main(int argc, char* argv[]) {
     }
 
     // Open the database
-    openDatabase(options["indexDir"].as<string>());
+    openDatabase(options["indexDir"].as<string>(), options["dbCacheSize"].as<size_t>() * 1024 * 1024, options["bloomFilterBits"].as<int>());
 
     // Read coin parameters
     VtcBlockIndexer::CoinParams::readFromFile(options["coinParams"].as<string>());
 
+    VtcBlockIndexer::ScriptSolver::pubKeyCache.setCapacity(options["pubKeyCacheSize"].as<size_t>());
+    VtcBlockIndexer::ScriptSolver::scriptStatistics.setRangeSize(options["scriptStatsRange"].as<uint64_t>());
+    VtcBlockIndexer::ScriptSolver::scriptStatistics.setSampling(options["unknownScriptSamples"].as<size_t>(), options["unknownScriptSampleRate"].as<uint64_t>());
+
+    // Handle SIGINT/SIGTERM on a dedicated thread, all other threads inherit the blocked mask
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, NULL);
+
     // Start memory pool monitor on a separate thread
-    mempoolMonitor = make_shared<VtcBlockIndexer::MempoolMonitor>();
+    // Keep the mempool file out of the LevelDB directory
+    string mempoolFile = options["mempoolFile"].as<string>();
+    if(mempoolFile.empty()) {
+        string indexDir = options["indexDir"].as<string>();
+        while(indexDir.size() > 1 && indexDir.back() == '/') indexDir.pop_back();
+        mempoolFile = indexDir + "-mempool.dat";
+    }
+    mempoolMonitor = make_shared<VtcBlockIndexer::MempoolMonitor>(database, mempoolFile);
     std::thread mempoolThread(runMempoolMonitor);   
+    if(!options["zmqEndpoint"].as<string>().empty()) {
+        std::thread(runMempoolNotificationListener, options["zmqEndpoint"].as<string>()).detach();
+    }
+    std::thread shutdownThread(waitForShutdown, shutdownSignals);
      
     // Start blockfile watcher on separate thread
     blockFileWatcher.reset(new VtcBlockIndexer::BlockFileWatcher(options["blocksDir"].as<string>(), database, mempoolMonitor));
     std::thread watcherThread(runBlockfileWatcher);   
     
+    // Start the Electrum server on a separate thread
+    if(options["electrumPort"].as<int>() != 0) {
+        electrumServer = make_shared<VtcBlockIndexer::ElectrumServer>(database, mempoolMonitor, options["blocksDir"].as<string>());
+        std::thread(runElectrumServer, options["electrumPort"].as<int>(), options["electrumThreads"].as<size_t>()).detach();
+    }
+
     // Start webserver on main thread.
-    httpServer.reset(new VtcBlockIndexer::HttpServer(database, mempoolMonitor, string(argv[1])));
+    httpServer.reset(new VtcBlockIndexer::HttpServer(database, mempoolMonitor, blockFileWatcher, options["blocksDir"].as<string>()));
+    httpServer->setStorageOptions(databaseCache, options["dbCacheSize"].as<size_t>() * 1024 * 1024, options["bloomFilterBits"].as<int>());
+    httpServer->setSlowRequestLog(options["slowRequestMs"].as<double>() / 1000, options["slowRequestLog"].as<size_t>());
+    httpServer->setGapLimit(options["gapLimit"].as<size_t>());
+    httpServer->setAdminInterface(options["adminBindAddress"].as<string>(), options["adminPort"].as<int>());
     httpServer->run(); 
 }
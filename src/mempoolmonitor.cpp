@@ -25,102 +25,571 @@
 #include <chrono>
 #include <thread>
 #include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <zmq.h>
 #include "byte_array_buffer.h"
 using namespace std;
 
-// This map keeps the memorypool transactions deserialized in memory.
+namespace {
+    // Identifies the persisted mempool file format
+    const char persistMagic[8] = {'V', 'T', 'C', 'M', 'E', 'M', 'P', '1'};
 
+    // Seconds between saving the mempool to the persist file
+    const int persistInterval = 60;
 
-VtcBlockIndexer::MempoolMonitor::MempoolMonitor() {
-    httpClient.reset(new jsonrpc::HttpClient("http://middleware:middleware@" + std::string(std::getenv("COIND_HOST")) + ":8332"));
+    // Seconds between polls of the full mempool when push notifications are active
+    const int reconcileInterval = 30;
+
+    // Notifications arriving within this many milliseconds are published as one update
+    const int notificationBatchMillis = 50;
+
+    // Receives all frames of a ZeroMQ message. Returns false on timeout.
+    bool receiveMultipart(void* socket, vector<string>& parts) {
+        do {
+            zmq_msg_t frame;
+            zmq_msg_init(&frame);
+            if(zmq_msg_recv(&frame, socket, 0) < 0) {
+                zmq_msg_close(&frame);
+                return !parts.empty();
+            }
+            parts.push_back(string(static_cast<const char*>(zmq_msg_data(&frame)), zmq_msg_size(&frame)));
+            bool more = zmq_msg_more(&frame);
+            zmq_msg_close(&frame);
+            if(!more) break;
+        } while(true);
+        return true;
+    }
+
+    void writeVarInt(vector<unsigned char>& out, uint64_t value) {
+        if(value < 253) {
+            out.push_back((unsigned char)value);
+            return;
+        }
+        int length = 8;
+        if(value <= 0xFFFF) {
+            out.push_back(253);
+            length = 2;
+        } else if(value <= 0xFFFFFFFF) {
+            out.push_back(254);
+            length = 4;
+        } else {
+            out.push_back(255);
+        }
+        for(int i = 0; i < length; i++) {
+            out.push_back((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    void writeUint(vector<unsigned char>& out, uint64_t value, int length) {
+        for(int i = 0; i < length; i++) {
+            out.push_back((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    void writeBytes(vector<unsigned char>& out, const vector<unsigned char>& bytes) {
+        writeVarInt(out, bytes.size());
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    // Serializes a deserialized transaction back into the network format, so
+    // BlockReader::readTransaction can read it again.
+    vector<unsigned char> serializeTransaction(const VtcBlockIndexer::Transaction& tx) {
+        vector<unsigned char> out;
+        bool segwit = false;
+        for(const VtcBlockIndexer::TransactionInput& txi : tx.inputs) {
+            if(!txi.witnessData.empty()) segwit = true;
+        }
+
+        writeUint(out, tx.version, 4);
+        if(segwit) {
+            out.push_back(0x00);
+            out.push_back(0x01);
+        }
+        
+        writeVarInt(out, tx.inputs.size());
+        for(const VtcBlockIndexer::TransactionInput& txi : tx.inputs) {
+            vector<unsigned char> hash = VtcBlockIndexer::Utility::hexToBytes(txi.txHash);
+            out.insert(out.end(), hash.rbegin(), hash.rend());
+            writeUint(out, txi.txoIndex, 4);
+            writeBytes(out, txi.script);
+            writeUint(out, txi.sequence, 4);
+        }
+
+        writeVarInt(out, tx.outputs.size());
+        for(const VtcBlockIndexer::TransactionOutput& txo : tx.outputs) {
+            writeUint(out, txo.value, 8);
+            writeBytes(out, txo.script);
+        }
+
+        if(segwit) {
+            for(const VtcBlockIndexer::TransactionInput& txi : tx.inputs) {
+                writeVarInt(out, txi.witnessData.size());
+                for(const vector<unsigned char>& witnessItem : txi.witnessData) {
+                    writeBytes(out, witnessItem);
+                }
+            }
+        }
+
+        writeUint(out, tx.lockTime, 4);
+        return out;
+    }
+}
+
+string VtcBlockIndexer::MempoolSnapshot::outpointKey(const string& txid, uint32_t vout) {
+    string key(36, '\0');
+    vector<unsigned char> hash = VtcBlockIndexer::Utility::hexToBytes(txid);
+    std::copy(hash.begin(), hash.begin() + std::min<size_t>(hash.size(), 32), key.begin());
+    for(int i = 0; i < 4; i++) {
+        key[32 + i] = (char)((vout >> (8 * i)) & 0xFF);
+    }
+    return key;
+}
+
+void VtcBlockIndexer::MempoolSnapshot::collectChanges(const VtcBlockIndexer::MempoolSnapshot& older, unordered_set<string>& addresses, unordered_set<string>& outpoints) const {
+    // The transactions that were added or removed, with the version that has them
+    vector<pair<shared_ptr<const VtcBlockIndexer::Transaction>, const MempoolSnapshot*>> changed;
+    transactions.forEachDifference(older.transactions, [this, &older, &changed](const string& txid, const shared_ptr<const VtcBlockIndexer::Transaction>* tx, const shared_ptr<const VtcBlockIndexer::Transaction>* olderTx) {
+        if(tx != NULL) changed.push_back({ *tx, this });
+        if(olderTx != NULL) changed.push_back({ *olderTx, &older });
+    });
+
+    auto addAddresses = [&addresses](const MempoolSnapshot& snapshot, const string& txid) {
+        const shared_ptr<const vector<string>>* txAddresses = snapshot.transactionAddresses.find(txid);
+        if(txAddresses != NULL) {
+            addresses.insert((*txAddresses)->begin(), (*txAddresses)->end());
+        }
+    };
+    auto addSpends = [&outpoints](const VtcBlockIndexer::Transaction& tx) {
+        for(const VtcBlockIndexer::TransactionInput& txi : tx.inputs) {
+            if(!txi.coinbase) outpoints.insert(outpointKey(txi.txHash, txi.txoIndex));
+        }
+    };
+
+    for(const auto& change : changed) {
+        const VtcBlockIndexer::Transaction& tx = *change.first;
+        addAddresses(*change.second, tx.txHash);
+        addSpends(tx);
+
+        // Parents: their outputs are spent or unspent now
+        for(const VtcBlockIndexer::TransactionInput& txi : tx.inputs) {
+            if(txi.coinbase) continue;
+            addAddresses(*this, txi.txHash);
+            addAddresses(older, txi.txHash);
+        }
+
+        // Children: they spend an unconfirmed output or not anymore
+        for(size_t i = 0; i < tx.outputs.size(); i++) {
+            string spender = outpointSpend(tx.txHash, i);
+            if(spender.empty()) continue;
+            shared_ptr<const VtcBlockIndexer::Transaction> child = getTransaction(spender);
+            if(!child) continue;
+            addAddresses(*this, spender);
+            addSpends(*child);
+        }
+    }
+}
+
+string VtcBlockIndexer::MempoolSnapshot::outpointSpend(const string& txid, uint32_t vout) const {
+    const string* spender = outpointSpenders.find(outpointKey(txid, vout));
+    if(spender == NULL) {
+        return "";
+    }
+    return *spender;
+}
+
+vector<VtcBlockIndexer::TransactionOutput> VtcBlockIndexer::MempoolSnapshot::getTxos(const string& address) const {
+    const shared_ptr<const vector<VtcBlockIndexer::TransactionOutput>>* txos = addressTransactions.find(address);
+    if(txos == NULL) {
+        return {};
+    }
+    return **txos;
+}
+
+bool VtcBlockIndexer::MempoolSnapshot::hasTransaction(const string& txid) const {
+    return transactions.find(txid) != NULL;
+}
+
+shared_ptr<const VtcBlockIndexer::Transaction> VtcBlockIndexer::MempoolSnapshot::getTransaction(const string& txid) const {
+    const shared_ptr<const VtcBlockIndexer::Transaction>* tx = transactions.find(txid);
+    return tx == NULL ? nullptr : *tx;
+}
+
+string VtcBlockIndexer::MempoolSnapshot::scriptHashAddress(const string& scriptHash) const {
+    const string* address = scriptHashAddresses.find(scriptHash);
+    return address == NULL ? "" : *address;
+}
+
+VtcBlockIndexer::MempoolMonitor::MempoolMonitor(const shared_ptr<leveldb::DB> db, string persistFile) {
+    this->db = db;
+    this->persistFile = persistFile;
+    this->pushActive = false;
+    this->reconcileRequested = false;
+    httpClient.reset(new VtcBlockIndexer::PersistentHttpClient("http://middleware:middleware@" + std::string(std::getenv("COIND_HOST")) + ":8332"));
     vertcoind.reset(new VertcoinClient(*httpClient));
     blockReader.reset(new VtcBlockIndexer::BlockReader(""));
     scriptSolver.reset(new VtcBlockIndexer::ScriptSolver());
+    snapshot = make_shared<const VtcBlockIndexer::MempoolSnapshot>();
+}
+
+shared_ptr<const VtcBlockIndexer::MempoolSnapshot> VtcBlockIndexer::MempoolMonitor::getSnapshot() const {
+    return atomic_load(&snapshot);
+}
+
+void VtcBlockIndexer::MempoolMonitor::publish(const shared_ptr<const VtcBlockIndexer::MempoolSnapshot>& newSnapshot) {
+    atomic_store(&snapshot, newSnapshot);
+}
+
+void VtcBlockIndexer::MempoolMonitor::addTransactions(VtcBlockIndexer::MempoolSnapshot& newSnapshot, const vector<shared_ptr<const VtcBlockIndexer::Transaction>>& txs) {
+    // Collect the outputs per address first, so each address list is copied once
+    unordered_map<string, vector<VtcBlockIndexer::TransactionOutput>> newTxos;
+    for(const auto& tx : txs) {
+        newSnapshot.transactions[tx->txHash] = tx;
+
+        for(const VtcBlockIndexer::TransactionInput& txi : tx->inputs) {
+            if(!txi.coinbase) {
+                newSnapshot.outpointSpenders[MempoolSnapshot::outpointKey(txi.txHash, txi.txoIndex)] = tx->txHash;
+            }
+        }
+
+        shared_ptr<vector<string>> txAddresses = make_shared<vector<string>>();
+        for(VtcBlockIndexer::TransactionOutput out : tx->outputs) {
+            out.txHash = tx->txHash;
+            vector<string> addresses = scriptSolver->getAddressesFromScript(out.script, out.txHash, out.index);
+            for(const string& address : addresses) {
+                newTxos[address].push_back(out);
+                txAddresses->push_back(address);
+            }
+        }
+        newSnapshot.transactionAddresses[tx->txHash] = txAddresses;
+    }
+
+    for(auto& kvp : newTxos) {
+        shared_ptr<const vector<VtcBlockIndexer::TransactionOutput>>& addressTxos = newSnapshot.addressTransactions[kvp.first];
+        shared_ptr<vector<VtcBlockIndexer::TransactionOutput>> txos;
+        if(addressTxos) {
+            txos = make_shared<vector<VtcBlockIndexer::TransactionOutput>>(*addressTxos);
+            txos->insert(txos->end(), kvp.second.begin(), kvp.second.end());
+        } else {
+            txos = make_shared<vector<VtcBlockIndexer::TransactionOutput>>(std::move(kvp.second));
+            vector<unsigned char> addressScript = VtcBlockIndexer::Utility::addressToScript(kvp.first);
+            if(!addressScript.empty()) {
+                newSnapshot.scriptHashAddresses[VtcBlockIndexer::Utility::scriptHash(addressScript)] = kvp.first;
+            }
+        }
+        addressTxos = txos;
+    }
+}
+
+bool VtcBlockIndexer::MempoolMonitor::persist() {
+    if(persistFile.empty()) return false;
+
+    lock_guard<mutex> lock(persistMutex);
+    shared_ptr<const VtcBlockIndexer::MempoolSnapshot> current = getSnapshot();
+    if(current == persistedSnapshot) return true;
+
+    vector<unsigned char> contents(persistMagic, persistMagic + sizeof(persistMagic));
+    writeUint(contents, current->transactions.size(), 4);
+    current->transactions.forEach([&contents](const string& txid, const shared_ptr<const VtcBlockIndexer::Transaction>& tx) {
+        vector<unsigned char> rawTx = serializeTransaction(*tx);
+        writeUint(contents, rawTx.size(), 4);
+        contents.insert(contents.end(), rawTx.begin(), rawTx.end());
+    });
+
+    // Write to a temporary file first, so a crash never leaves a partial file behind
+    const string tempFile = persistFile + ".tmp";
+    ofstream file(tempFile, ios_base::out | ios_base::binary | ios_base::trunc);
+    file.write(reinterpret_cast<const char*>(&contents[0]), contents.size());
+    file.close();
+    if(file.fail() || rename(tempFile.c_str(), persistFile.c_str()) != 0) {
+        cout << "Could not write mempool to " << persistFile << endl;
+        return false;
+    }
+
+    persistedSnapshot = current;
+    return true;
+}
+
+void VtcBlockIndexer::MempoolMonitor::loadPersisted() {
+    if(persistFile.empty()) return;
+
+    ifstream file(persistFile, ios_base::in | ios_base::binary);
+    if(!file.is_open()) return;
+    vector<unsigned char> contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+
+    if(contents.size() < sizeof(persistMagic) + 4 || !std::equal(persistMagic, persistMagic + sizeof(persistMagic), contents.begin())) {
+        cout << "Ignoring invalid mempool file " << persistFile << endl;
+        return;
+    }
+
+    size_t pos = sizeof(persistMagic);
+    uint32_t count = contents[pos] | (contents[pos+1] << 8) | (contents[pos+2] << 16) | ((uint32_t)contents[pos+3] << 24);
+    pos += 4;
+
+    vector<shared_ptr<const VtcBlockIndexer::Transaction>> transactions;
+    try {
+        for(uint32_t i = 0; i < count && pos + 4 <= contents.size(); i++) {
+            uint32_t length = contents[pos] | (contents[pos+1] << 8) | (contents[pos+2] << 16) | ((uint32_t)contents[pos+3] << 24);
+            pos += 4;
+            if(length == 0 || length > contents.size() - pos) break;
+
+            byte_array_buffer streambuf(&contents[pos], length);
+            std::istream stream(&streambuf);
+            transactions.push_back(make_shared<const VtcBlockIndexer::Transaction>(blockReader->readTransaction(stream)));
+            pos += length;
+        }
+    } catch(const std::exception& e) {
+        cout << "Ignoring corrupt mempool file " << persistFile << endl;
+        return;
+    }
+
+    // The notification listener and the block indexer may have changed the mempool
+    // already, so the transactions are added to it, skipping those indexed since
+    update(transactions, {});
+    cout << "Restored " << transactions.size() << " mempool transactions from " << persistFile << endl;
+}
+
+bool VtcBlockIndexer::MempoolMonitor::isIndexed(const string& txid) {
+    string filePosition;
+    return this->db->Get(leveldb::ReadOptions(), "tx-filePosition-" + txid, &filePosition).ok();
+}
+
+void VtcBlockIndexer::MempoolMonitor::update(const vector<shared_ptr<const VtcBlockIndexer::Transaction>>& newTransactions, const unordered_set<string>& removedTxids) {
+    if(newTransactions.empty() && removedTxids.empty()) return;
+
+    lock_guard<mutex> lock(writeMutex);
+    shared_ptr<VtcBlockIndexer::MempoolSnapshot> newSnapshot = make_shared<VtcBlockIndexer::MempoolSnapshot>(*getSnapshot());
+    removeTransactions(*newSnapshot, removedTxids);
+    vector<shared_ptr<const VtcBlockIndexer::Transaction>> addedTransactions;
+    unordered_set<string> addedTxids;
+    for(const auto& tx : newTransactions) {
+        // The block indexer writes the transaction before taking writeMutex to remove
+        // it, so anything indexed by now would never be removed again
+        if(!newSnapshot->hasTransaction(tx->txHash) && addedTxids.insert(tx->txHash).second && !isIndexed(tx->txHash)) {
+            addedTransactions.push_back(tx);
+        }
+    }
+    addTransactions(*newSnapshot, addedTransactions);
+    publish(newSnapshot);
+}
+
+void VtcBlockIndexer::MempoolMonitor::requestReconcile() {
+    lock_guard<mutex> lock(reconcileMutex);
+    reconcileRequested = true;
+    reconcileCondition.notify_one();
 }
 
 void VtcBlockIndexer::MempoolMonitor::startWatcher() {
+    loadPersisted();
+    time_t lastPersist = time(NULL);
+
     while(true) {
+        if(difftime(time(NULL), lastPersist) >= persistInterval) {
+            persist();
+            lastPersist = time(NULL);
+        }
+
         try {
+            // Only transactions we had before listing the node's mempool are candidates
+            // for eviction. Anything pushed in the meantime is newer than the listing.
+            shared_ptr<const VtcBlockIndexer::MempoolSnapshot> current = getSnapshot();
             const Json::Value mempool = vertcoind->getrawmempool();
+            vector<string> newTxids;
+            unordered_set<string> nodeTxids;
             for ( uint index = 0; index < mempool.size(); ++index )
             {
-                if(mempoolTransactions.find(mempool[index].asString()) == mempoolTransactions.end()) {
-                    const Json::Value rawTx = vertcoind->getrawtransaction(mempool[index].asString(), false);
-                    std::vector<unsigned char> rawTxBytes = VtcBlockIndexer::Utility::hexToBytes(rawTx.asString());
-
-                    byte_array_buffer streambuf(&rawTxBytes[0], rawTxBytes.size());
-                    std::istream stream(&streambuf);
-
-                    VtcBlockIndexer::Transaction tx = blockReader->readTransaction(stream);
-                    mempoolTransactions[mempool[index].asString()] = tx;
-
-                  
-                    for(VtcBlockIndexer::TransactionOutput out : tx.outputs) {
-                        out.txHash = tx.txHash;
-                        vector<string> addresses = scriptSolver->getAddressesFromScript(out.script);
-                        for(string address : addresses) {
-                            if(addressMempoolTransactions.find(address) == addressMempoolTransactions.end())
-                            {
-                                addressMempoolTransactions[address] = {};
-                            }
-                            addressMempoolTransactions[address].push_back(out);
-                        }
-                    }
+                nodeTxids.insert(mempool[index].asString());
+                if(!current->hasTransaction(mempool[index].asString())) {
+                    newTxids.push_back(mempool[index].asString());
                 }
             }
+
+            // Fetch all new transactions in batch requests instead of one call per txid.
+            // Transactions that left the mempool in the meantime are simply not returned.
+            unordered_map<string, string> rawTransactions = vertcoind->getrawtransactions(newTxids);
+            vector<shared_ptr<const VtcBlockIndexer::Transaction>> newTransactions;
+            for(const string& txid : newTxids) {
+                auto rawTx = rawTransactions.find(txid);
+                if(rawTx == rawTransactions.end()) continue;
+
+                std::vector<unsigned char> rawTxBytes = VtcBlockIndexer::Utility::hexToBytes(rawTx->second);
+                if(rawTxBytes.empty()) continue;
+
+                byte_array_buffer streambuf(&rawTxBytes[0], rawTxBytes.size());
+                std::istream stream(&streambuf);
+
+                newTransactions.push_back(make_shared<const VtcBlockIndexer::Transaction>(blockReader->readTransaction(stream)));
+            }
+
+            // Transactions the node no longer has were evicted, replaced or mined
+            unordered_set<string> removedTxids;
+            current->transactions.forEach([&nodeTxids, &removedTxids](const string& txid, const shared_ptr<const VtcBlockIndexer::Transaction>& tx) {
+                if(nodeTxids.find(txid) == nodeTxids.end()) {
+                    removedTxids.insert(txid);
+                }
+            });
+
+            update(newTransactions, removedTxids);
         } catch(const jsonrpc::JsonRpcException& e) {
             const std::string message(e.what());
             cout << "Error reading mempool " << message << endl;
         }
         
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        // With push notifications active, polling is only a fallback to reconcile
+        // with the node. New blocks and missed notifications trigger it early.
+        unique_lock<mutex> lock(reconcileMutex);
+        reconcileCondition.wait_for(lock, std::chrono::seconds(pushActive ? reconcileInterval : 1), [this] { return reconcileRequested; });
+        reconcileRequested = false;
     }
 }
 
-string VtcBlockIndexer::MempoolMonitor::outpointSpend(string txid, uint32_t vout) {
-    for (auto kvp : mempoolTransactions) {
-        VtcBlockIndexer::Transaction tx = kvp.second;
-        for (VtcBlockIndexer::TransactionInput txi : tx.inputs) {
-            if(txi.txHash.compare(txid) == 0 && txi.txoIndex == vout) {
-                return tx.txHash;
+void VtcBlockIndexer::MempoolMonitor::startNotificationListener(string endpoint) {
+    void* context = zmq_ctx_new();
+    void* socket = zmq_socket(context, ZMQ_SUB);
+    zmq_setsockopt(socket, ZMQ_SUBSCRIBE, "rawtx", 5);
+    zmq_setsockopt(socket, ZMQ_SUBSCRIBE, "hashblock", 9);
+    int timeout = notificationBatchMillis;
+    zmq_setsockopt(socket, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+    if(zmq_connect(socket, endpoint.c_str()) != 0) {
+        cout << "Could not connect to notification endpoint " << endpoint << ", relying on polling" << endl;
+        zmq_close(socket);
+        zmq_ctx_term(context);
+        return;
+    }
+    cout << "Listening for transactions on " << endpoint << endl;
+    pushActive = true;
+
+    unordered_map<string, uint32_t> lastSequence;
+    vector<shared_ptr<const VtcBlockIndexer::Transaction>> pending;
+    auto batchStart = std::chrono::steady_clock::now();
+
+    while(true) {
+        vector<string> parts;
+        bool received = receiveMultipart(socket, parts);
+
+        if(received && parts.size() >= 2) {
+            const string& topic = parts[0];
+            const string& body = parts[1];
+
+            // The node numbers the messages per topic, a gap means we missed some
+            if(parts.size() >= 3 && parts[2].size() == 4) {
+                const unsigned char* seq = reinterpret_cast<const unsigned char*>(parts[2].data());
+                uint32_t sequence = seq[0] | (seq[1] << 8) | (seq[2] << 16) | ((uint32_t)seq[3] << 24);
+                auto last = lastSequence.find(topic);
+                if(last != lastSequence.end() && sequence != last->second + 1) {
+                    requestReconcile();
+                }
+                lastSequence[topic] = sequence;
+            }
+
+            if(topic == "rawtx" && !body.empty()) {
+                // Transactions in a newly connected block are announced too. The coinbase
+                // never enters the mempool, and update() skips the ones already indexed.
+                byte_array_buffer streambuf(reinterpret_cast<const uint8_t*>(body.data()), body.size());
+                std::istream stream(&streambuf);
+                try {
+                    shared_ptr<const VtcBlockIndexer::Transaction> tx = make_shared<const VtcBlockIndexer::Transaction>(blockReader->readTransaction(stream));
+                    if(tx->inputs.empty() || !tx->inputs[0].coinbase) {
+                        pending.push_back(tx);
+                    }
+                } catch(const std::exception& e) {
+                    cout << "Ignoring undecodable transaction notification" << endl;
+                }
+            } else if(topic == "hashblock") {
+                // Publish the block's transactions before reconciling, so the poll
+                // removes any that were not caught by the index check
+                update(pending, {});
+                pending.clear();
+                requestReconcile();
             }
         }
+
+        // Publish what arrived as one update, at most every notificationBatchMillis
+        auto now = std::chrono::steady_clock::now();
+        if(!pending.empty() && (!received || now - batchStart >= std::chrono::milliseconds(notificationBatchMillis))) {
+            update(pending, {});
+            pending.clear();
+        }
+        if(pending.empty()) {
+            batchStart = now;
+        }
     }
-    return "";
+}
+
+string VtcBlockIndexer::MempoolMonitor::outpointSpend(string txid, uint32_t vout) {
+    return getSnapshot()->outpointSpend(txid, vout);
 }
  
 vector<VtcBlockIndexer::TransactionOutput> VtcBlockIndexer::MempoolMonitor::getTxos(std::string address) {
-    if(addressMempoolTransactions.find(address) == addressMempoolTransactions.end())
-    {
-        return {};
-    } 
-    return vector<VtcBlockIndexer::TransactionOutput>(addressMempoolTransactions[address]);
+    return getSnapshot()->getTxos(address);
 }
 
-void VtcBlockIndexer::MempoolMonitor::transactionIndexed(std::string txid) {
-    if(mempoolTransactions.find(txid) != mempoolTransactions.end()) {
-        mempoolTransactions.erase(txid);
-
-        unordered_map<string, std::vector<VtcBlockIndexer::TransactionOutput>> changedMempoolAddressTxes;
-        for (auto kvp : addressMempoolTransactions) {
-
-            vector<VtcBlockIndexer::TransactionOutput> newVector = {};
-            bool itemsRemoved = false;
-            for (VtcBlockIndexer::TransactionOutput txo : kvp.second) {
-                if(txo.txHash.compare(txid) != 0) {
-                    newVector.push_back(txo);
-                } else {
-                    itemsRemoved = true;
-                }
+void VtcBlockIndexer::MempoolMonitor::removeTransactions(VtcBlockIndexer::MempoolSnapshot& newSnapshot, const unordered_set<string>& txids) {
+    unordered_set<string> touchedAddresses;
+    for(const string& txid : txids) {
+        // Values found in a map are copied out before it is changed, since changing
+        // a shared shard replaces it
+        shared_ptr<const VtcBlockIndexer::Transaction> tx = newSnapshot.getTransaction(txid);
+        if(!tx) continue;
+        newSnapshot.transactions.erase(txid);
+
+        for(const VtcBlockIndexer::TransactionInput& txi : tx->inputs) {
+            const string outpoint = MempoolSnapshot::outpointKey(txi.txHash, txi.txoIndex);
+            const string* spender = newSnapshot.outpointSpenders.find(outpoint);
+            if(spender != NULL && *spender == tx->txHash) {
+                newSnapshot.outpointSpenders.erase(outpoint);
             }
+        }
+
+        const shared_ptr<const vector<string>>* txAddresses = newSnapshot.transactionAddresses.find(txid);
+        if(txAddresses != NULL) {
+            touchedAddresses.insert((*txAddresses)->begin(), (*txAddresses)->end());
+            newSnapshot.transactionAddresses.erase(txid);
+        }
+    }
 
-            if(itemsRemoved) {
-                changedMempoolAddressTxes[kvp.first] = newVector;
+    // Each address is filtered once, even when several removed transactions pay to it
+    for(const string& address : touchedAddresses) {
+        const shared_ptr<const vector<VtcBlockIndexer::TransactionOutput>>* addressTxos = newSnapshot.addressTransactions.find(address);
+        if(addressTxos == NULL) continue;
+
+        shared_ptr<vector<VtcBlockIndexer::TransactionOutput>> txos = make_shared<vector<VtcBlockIndexer::TransactionOutput>>();
+        for(const VtcBlockIndexer::TransactionOutput& txo : **addressTxos) {
+            if(txids.find(txo.txHash) == txids.end()) {
+                txos->push_back(txo);
             }
         }
 
-        for (auto kvp : changedMempoolAddressTxes) {
-            addressMempoolTransactions[kvp.first] = kvp.second;
+        if(txos->empty()) {
+            newSnapshot.addressTransactions.erase(address);
+            vector<unsigned char> addressScript = VtcBlockIndexer::Utility::addressToScript(address);
+            if(!addressScript.empty()) {
+                newSnapshot.scriptHashAddresses.erase(VtcBlockIndexer::Utility::scriptHash(addressScript));
+            }
+        } else {
+            newSnapshot.addressTransactions[address] = txos;
         }
     }
 }
+
+void VtcBlockIndexer::MempoolMonitor::transactionIndexed(std::string txid) {
+    transactionsIndexed({txid});
+}
+
+void VtcBlockIndexer::MempoolMonitor::transactionsIndexed(const vector<string>& txids) {
+    // Skip the copy when none of the transactions were seen in the mempool. The check
+    // is done under writeMutex so it can not miss an update that is being published.
+    lock_guard<mutex> lock(writeMutex);
+    shared_ptr<const VtcBlockIndexer::MempoolSnapshot> current = getSnapshot();
+    unordered_set<string> mempoolTxids;
+    for(const string& txid : txids) {
+        if(current->hasTransaction(txid)) mempoolTxids.insert(txid);
+    }
+    if(mempoolTxids.empty()) return;
+
+    shared_ptr<VtcBlockIndexer::MempoolSnapshot> newSnapshot = make_shared<VtcBlockIndexer::MempoolSnapshot>(*current);
+    removeTransactions(*newSnapshot, mempoolTxids);
+    publish(newSnapshot);
+}
@@ -19,11 +19,17 @@
 */
 
 #include "vertcoinrpc.h"
-#include <jsonrpccpp/client/connectors/httpclient.h>
+#include "persistenthttpclient.h"
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "blockreader.h"
 #include "scriptsolver.h"
+#include "leveldb/db.h"
+#include "shardedmap.h"
 #include <unordered_map>
+#include <unordered_set>
 #ifndef MEMPOOLMONITOR_H_INCLUDED
 #define MEMPOOLMONITOR_H_INCLUDED
 
@@ -32,22 +38,103 @@ using namespace std;
 namespace VtcBlockIndexer {
 
 /**
- * The BlockFileWatcher class provides methods to watch and scan a blocks directory
- * and process the blockfiles when changes occur.
+ * The MempoolSnapshot class holds one immutable version of the memory pool state. 
+ * Once published by the MempoolMonitor a snapshot is never modified, so it can be
+ * read from any thread without locking. A new version is a copy that shares all
+ * parts of the maps the change does not touch (see ShardedMap).
+ */
+
+class MempoolSnapshot {
+public:
+    /** Returns the spender txid if an outpoint is spent */
+    string outpointSpend(const string& txid, uint32_t vout) const;
+
+    /** Returns TXOs in the memorypool matching an address */
+    vector<VtcBlockIndexer::TransactionOutput> getTxos(const string& address) const;
+
+    /** Returns true if the transaction is in this version of the memorypool */
+    bool hasTransaction(const string& txid) const;
+
+    /** Returns the transaction, or NULL if it is not in this version of the memorypool */
+    shared_ptr<const VtcBlockIndexer::Transaction> getTransaction(const string& txid) const;
+
+    /** Returns the address of an Electrum script hash, or an empty string if no
+     * output in the memorypool pays to it */
+    string scriptHashAddress(const string& scriptHash) const;
+
+    /** Collects what changed since an older version of the memorypool: the addresses
+     * whose unconfirmed history may be different, and the outpoints (see outpointKey)
+     * that the transactions involved spend. A confirmed output can only have changed
+     * if it is one of those outpoints. Besides the added and removed transactions,
+     * this includes their parents and children in the memorypool, since whether a
+     * transaction spends unconfirmed outputs changes with them. */
+    void collectChanges(const MempoolSnapshot& older, unordered_set<string>& addresses, unordered_set<string>& outpoints) const;
+
+    /** Returns the key used in outpointSpenders: the 32 byte binary txid
+     * followed by the 4 byte output index */
+    static string outpointKey(const string& txid, uint32_t vout);
+
+    /** The deserialized transactions, keyed by txid. The transactions are shared
+     * between snapshots, since they never change. */
+    ShardedMap<shared_ptr<const VtcBlockIndexer::Transaction>> transactions;
+
+    /** The outputs in the memorypool per address. A changed list is replaced,
+     * so the lists of other addresses stay shared between snapshots. */
+    ShardedMap<shared_ptr<const vector<VtcBlockIndexer::TransactionOutput>>> addressTransactions;
+
+    /** The spending transaction per outpoint (see outpointKey) */
+    ShardedMap<string> outpointSpenders;
+
+    /** The addresses each transaction pays to, so removing a transaction only
+     * touches its own entries in addressTransactions */
+    ShardedMap<shared_ptr<const vector<string>>> transactionAddresses;
+
+    /** The address per Electrum script hash (see Utility::scriptHash) of the
+     * addresses in addressTransactions */
+    ShardedMap<string> scriptHashAddresses;
+};
+
+/**
+ * The MempoolMonitor class watches the memory pool of the coin daemon and keeps
+ * the unconfirmed transactions deserialized in memory. Changes are made on a copy
+ * of the current MempoolSnapshot which is then published atomically, so readers
+ * never block on ingestion and always see a consistent state.
  */
 
 class MempoolMonitor {
 public:
     /** Constructs a MempoolMonitor instance
+     * 
+     * @param db Index database, used to skip transactions that are already confirmed
+     * @param persistFile File to save the memorypool to, so it can be restored on
+     * startup without fetching every transaction again. Empty to disable.
      */
-    MempoolMonitor();
+    MempoolMonitor(const shared_ptr<leveldb::DB> db, string persistFile = "");
 
-    /** Starts watching the mempool for new transactions */
+    /** Writes the current memorypool to the persist file. Called periodically
+     * by the watcher and on shutdown. */
+    bool persist();
+
+    /** Starts watching the mempool. Every poll adds the new transactions and removes
+     * the ones that the node no longer has (evicted, replaced or confirmed) */
     void startWatcher();
 
+    /** Listens for transactions pushed by the node over ZeroMQ (-zmqpubrawtx and 
+     * -zmqpubhashblock on the passed endpoint). While active, the watcher only
+     * polls every 30 seconds to reconcile, or when a block or gap is announced. */
+    void startNotificationListener(string endpoint);
+
     /** Notify a transaction has been indexed - remove it from the mempool */
     void transactionIndexed(string txid);
 
+    /** Notify a set of transactions (i.e. a block) has been indexed - remove
+     * them from the mempool in a single update */
+    void transactionsIndexed(const vector<string>& txids);
+
+    /** Returns the current version of the memorypool. Use a single snapshot for 
+     * all lookups that need to be consistent with each other. */
+    shared_ptr<const MempoolSnapshot> getSnapshot() const;
+
     /** Returns the spender txid if an outpoint is spent */
     string outpointSpend(string txid, uint32_t vout);
 
@@ -55,12 +142,55 @@ public:
     vector<VtcBlockIndexer::TransactionOutput> getTxos(string address);
 
 private:
+    /** Adds the memorypool saved by persist() to the current snapshot. The first
+     * poll then only fetches what changed on the node in the meantime. */
+    void loadPersisted();
+
+    /** Adds deserialized transactions to a snapshot that is being built */
+    void addTransactions(MempoolSnapshot& snapshot, const vector<shared_ptr<const VtcBlockIndexer::Transaction>>& txs);
+
+    /** Removes transactions and all their address and outpoint entries from a
+     * snapshot that is being built */
+    void removeTransactions(MempoolSnapshot& snapshot, const unordered_set<string>& txids);
+
+    /** Returns true if the transaction is already in the index, i.e. confirmed */
+    bool isIndexed(const string& txid);
+
+    /** Applies new and removed transactions to a copy of the latest snapshot and publishes it.
+     * New transactions that are already indexed are skipped. */
+    void update(const vector<shared_ptr<const VtcBlockIndexer::Transaction>>& newTransactions, const unordered_set<string>& removedTxids);
+
+    /** Wakes up the watcher to poll and reconcile with the node right away */
+    void requestReconcile();
+
+    /** Publishes a new version of the memorypool */
+    void publish(const shared_ptr<const MempoolSnapshot>& snapshot);
+
+    shared_ptr<leveldb::DB> db;
     unique_ptr<VertcoinClient> vertcoind;
-    unique_ptr<jsonrpc::HttpClient> httpClient;
-    unordered_map<string, VtcBlockIndexer::Transaction> mempoolTransactions;
-    unordered_map<string, vector<VtcBlockIndexer::TransactionOutput>> addressMempoolTransactions;
+    unique_ptr<VtcBlockIndexer::PersistentHttpClient> httpClient;
     unique_ptr<VtcBlockIndexer::BlockReader> blockReader;
     unique_ptr<VtcBlockIndexer::ScriptSolver> scriptSolver;
+
+    /** The current version of the memorypool, only accessed through atomic_load/atomic_store */
+    shared_ptr<const MempoolSnapshot> snapshot;
+
+    /** Serializes the writers (mempool thread and block indexer). Held while checking
+     * new transactions against the index, so a block indexed meanwhile always removes them. */
+    mutex writeMutex;
+
+    string persistFile;
+
+    /** Set when push notifications are received, polling then falls back to reconciliation */
+    atomic<bool> pushActive;
+
+    mutex reconcileMutex;
+    condition_variable reconcileCondition;
+    bool reconcileRequested;
+
+    /** Serializes writing the persist file, and remembers what was written last */
+    mutex persistMutex;
+    shared_ptr<const MempoolSnapshot> persistedSnapshot;
 }; 
 
 }
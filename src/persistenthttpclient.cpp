@@ -0,0 +1,297 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "persistenthttpclient.h"
+#include <iostream>
+#include <sstream>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+
+namespace {
+    // Socket send and receive timeout in seconds
+    const int socketTimeout = 60;
+
+    string base64(const string& in) {
+        static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        string out;
+        int val = 0;
+        int bits = -6;
+        for(unsigned char c : in) {
+            val = (val << 8) + c;
+            bits += 8;
+            while(bits >= 0) {
+                out.push_back(alphabet[(val >> bits) & 0x3F]);
+                bits -= 6;
+            }
+        }
+        if(bits > -6) out.push_back(alphabet[((val << 8) >> (bits + 8)) & 0x3F]);
+        while(out.size() % 4) out.push_back('=');
+        return out;
+    }
+
+    // Reads from the socket until buffer contains at least size bytes
+    bool fill(int fd, string& buffer, size_t size) {
+        char chunk[16384];
+        while(buffer.size() < size) {
+            ssize_t bytesRead = recv(fd, chunk, sizeof(chunk), 0);
+            if(bytesRead <= 0) return false;
+            buffer.append(chunk, bytesRead);
+        }
+        return true;
+    }
+
+    // Reads from the socket until buffer contains the delimiter, returns its position
+    size_t fillUntil(int fd, string& buffer, const string& delimiter, size_t from) {
+        char chunk[16384];
+        size_t found;
+        while((found = buffer.find(delimiter, from)) == string::npos) {
+            ssize_t bytesRead = recv(fd, chunk, sizeof(chunk), 0);
+            if(bytesRead <= 0) return string::npos;
+            buffer.append(chunk, bytesRead);
+        }
+        return found;
+    }
+}
+
+VtcBlockIndexer::PersistentHttpClient::PersistentHttpClient(const string& url, size_t maxIdleConnections) {
+    this->maxIdleConnections = maxIdleConnections;
+    
+    string rest = url;
+    size_t schemeEnd = rest.find("://");
+    if(schemeEnd != string::npos) rest = rest.substr(schemeEnd + 3);
+
+    size_t pathStart = rest.find('/');
+    this->path = (pathStart == string::npos) ? "/" : rest.substr(pathStart);
+    rest = rest.substr(0, pathStart);
+
+    size_t credentialsEnd = rest.rfind('@');
+    if(credentialsEnd != string::npos) {
+        this->authorization = base64(rest.substr(0, credentialsEnd));
+        rest = rest.substr(credentialsEnd + 1);
+    }
+
+    size_t portStart = rest.rfind(':');
+    if(portStart == string::npos) {
+        this->host = rest;
+        this->port = "80";
+    } else {
+        this->host = rest.substr(0, portStart);
+        this->port = rest.substr(portStart + 1);
+    }
+}
+
+VtcBlockIndexer::PersistentHttpClient::~PersistentHttpClient() {
+    closeIdleConnections();
+}
+
+void VtcBlockIndexer::PersistentHttpClient::closeIdleConnections() {
+    lock_guard<mutex> lock(poolMutex);
+    for(int fd : idleConnections) {
+        close(fd);
+    }
+    idleConnections.clear();
+}
+
+int VtcBlockIndexer::PersistentHttpClient::acquireConnection(bool& reused, bool fresh) {
+    if(!fresh) {
+        lock_guard<mutex> lock(poolMutex);
+        if(!idleConnections.empty()) {
+            int fd = idleConnections.back();
+            idleConnections.pop_back();
+            reused = true;
+            return fd;
+        }
+    }
+    reused = false;
+
+    struct addrinfo hints;
+    struct addrinfo* addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for(struct addrinfo* address = addresses; address != NULL; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if(fd < 0) continue;
+        if(connect(fd, address->ai_addr, address->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(addresses);
+    if(fd < 0) return -1;
+
+    struct timeval timeout;
+    timeout.tv_sec = socketTimeout;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+void VtcBlockIndexer::PersistentHttpClient::releaseConnection(int fd) {
+    lock_guard<mutex> lock(poolMutex);
+    if(idleConnections.size() < maxIdleConnections) {
+        idleConnections.push_back(fd);
+    } else {
+        close(fd);
+    }
+}
+
+bool VtcBlockIndexer::PersistentHttpClient::roundTrip(int fd, const string& request, int& status, string& body, bool& keepAlive, bool& retryable) {
+    retryable = false;
+    size_t sent = 0;
+    while(sent < request.size()) {
+        ssize_t bytesSent = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if(bytesSent <= 0) {
+            // An incomplete request is never processed, unless we just stopped waiting
+            retryable = (errno != EAGAIN && errno != EWOULDBLOCK);
+            return false;
+        }
+        sent += bytesSent;
+    }
+
+    // Once the request is out the server may have executed it, so only a connection
+    // that was closed without a single response byte is safe to try again
+    string buffer;
+    errno = 0;
+    size_t headerEnd = fillUntil(fd, buffer, "\r\n\r\n", 0);
+    if(headerEnd == string::npos) {
+        retryable = buffer.empty() && (errno == 0 || errno == ECONNRESET);
+        return false;
+    }
+
+    // Parse the status line and the headers we need
+    istringstream headers(buffer.substr(0, headerEnd));
+    string line;
+    getline(headers, line);
+    if(line.size() < 12 || line.compare(0, 5, "HTTP/") != 0) return false;
+    status = atoi(line.substr(9, 3).c_str());
+    keepAlive = (line.compare(0, 8, "HTTP/1.1") == 0);
+
+    long long contentLength = -1;
+    bool chunked = false;
+    while(getline(headers, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        size_t colon = line.find(':');
+        if(colon == string::npos) continue;
+        string name = line.substr(0, colon);
+        string value = line.substr(colon + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        if(strcasecmp(name.c_str(), "Content-Length") == 0) {
+            contentLength = atoll(value.c_str());
+        } else if(strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+            chunked = (strcasecmp(value.c_str(), "chunked") == 0);
+        } else if(strcasecmp(name.c_str(), "Connection") == 0) {
+            if(strcasecmp(value.c_str(), "close") == 0) keepAlive = false;
+            if(strcasecmp(value.c_str(), "keep-alive") == 0) keepAlive = true;
+        }
+    }
+
+    size_t pos = headerEnd + 4;
+    body.clear();
+    if(chunked) {
+        while(true) {
+            size_t lineEnd = fillUntil(fd, buffer, "\r\n", pos);
+            if(lineEnd == string::npos) return false;
+            size_t chunkSize = strtoul(buffer.substr(pos, lineEnd - pos).c_str(), NULL, 16);
+            pos = lineEnd + 2;
+            if(!fill(fd, buffer, pos + chunkSize + 2)) return false;
+            body.append(buffer, pos, chunkSize);
+            pos += chunkSize + 2;
+            if(chunkSize == 0) break;
+        }
+    } else if(contentLength >= 0) {
+        if(!fill(fd, buffer, pos + contentLength)) return false;
+        body.assign(buffer, pos, contentLength);
+    } else {
+        // No length given, the body ends when the server closes the connection
+        char chunk[16384];
+        ssize_t bytesRead;
+        while((bytesRead = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+            buffer.append(chunk, bytesRead);
+        }
+        body.assign(buffer, pos, string::npos);
+        keepAlive = false;
+    }
+    return true;
+}
+
+void VtcBlockIndexer::PersistentHttpClient::SendRPCMessage(const string& message, string& result) throw (jsonrpc::JsonRpcException) {
+    stringstream request;
+    request << "POST " << path << " HTTP/1.1\r\n"
+            << "Host: " << host << ":" << port << "\r\n"
+            << "Content-Type: application/json\r\n"
+            << "Content-Length: " << message.size() << "\r\n"
+            << "Connection: keep-alive\r\n";
+    if(!authorization.empty()) {
+        request << "Authorization: Basic " << authorization << "\r\n";
+    }
+    request << "\r\n" << message;
+    const string requestString = request.str();
+
+    // A pooled connection may have been closed by the server in the meantime. Then
+    // the others probably were too (i.e. the node restarted), so they are all closed
+    // and the request is retried once on a new connection, if it was not processed.
+    for(int attempt = 0; attempt < 2; attempt++) {
+        bool reused = false;
+        int fd = acquireConnection(reused, attempt > 0);
+        if(fd < 0) {
+            throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "Could not connect to " + host + ":" + port);
+        }
+
+        int status = 0;
+        bool keepAlive = false;
+        bool retryable = false;
+        if(!roundTrip(fd, requestString, status, result, keepAlive, retryable)) {
+            close(fd);
+            if(reused) closeIdleConnections();
+            if(reused && retryable) continue;
+            throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "Connection to " + host + ":" + port + " failed");
+        }
+
+        if(keepAlive) {
+            releaseConnection(fd);
+        } else {
+            close(fd);
+        }
+
+        // The node reports RPC errors with a JSON body and a non-200 status, leave those
+        // to the client. Anything without a body is a transport problem.
+        if(status != 200 && result.empty()) {
+            throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "HTTP status " + to_string(status));
+        }
+        return;
+    }
+    throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "Connection to " + host + ":" + port + " failed");
+}
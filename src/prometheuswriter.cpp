@@ -0,0 +1,89 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "prometheuswriter.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+VtcBlockIndexer::PrometheusWriter::PrometheusWriter(ostream& out) : out(out) {
+}
+
+void VtcBlockIndexer::PrometheusWriter::family(const string& name, const string& type, const string& help) {
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+void VtcBlockIndexer::PrometheusWriter::sample(const string& name, double value, const Labels& labels) {
+    out << name;
+    writeLabels(labels);
+    out << " ";
+    writeValue(value);
+    out << "\n";
+}
+
+void VtcBlockIndexer::PrometheusWriter::histogram(const string& name, const Histogram::Snapshot& snapshot, const Labels& labels) {
+    uint64_t cumulative = 0;
+    for(size_t i = 0; i < snapshot.bucketCounts.size(); i++) {
+        cumulative += snapshot.bucketCounts[i];
+
+        Labels bucketLabels(labels);
+        if(i < snapshot.upperBounds.size()) {
+            char bound[32];
+            snprintf(bound, sizeof(bound), "%g", snapshot.upperBounds[i]);
+            bucketLabels.push_back({ "le", bound });
+        } else {
+            bucketLabels.push_back({ "le", "+Inf" });
+        }
+        sample(name + "_bucket", cumulative, bucketLabels);
+    }
+    sample(name + "_sum", snapshot.sum, labels);
+    sample(name + "_count", snapshot.count, labels);
+}
+
+void VtcBlockIndexer::PrometheusWriter::writeLabels(const Labels& labels) {
+    if(labels.empty()) return;
+
+    out << "{";
+    for(size_t i = 0; i < labels.size(); i++) {
+        if(i > 0) out << ",";
+        out << labels[i].first << "=\"";
+        for(char c : labels[i].second) {
+            if(c == '\\') out << "\\\\";
+            else if(c == '"') out << "\\\"";
+            else if(c == '\n') out << "\\n";
+            else out << c;
+        }
+        out << "\"";
+    }
+    out << "}";
+}
+
+void VtcBlockIndexer::PrometheusWriter::writeValue(double value) {
+    if(std::isnan(value)) {
+        out << "NaN";
+    } else if(std::isinf(value)) {
+        out << (value > 0 ? "+Inf" : "-Inf");
+    } else {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.15g", value);
+        out << buffer;
+    }
+}
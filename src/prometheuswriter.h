@@ -0,0 +1,66 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROMETHEUSWRITER_H_INCLUDED
+#define PROMETHEUSWRITER_H_INCLUDED
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <utility>
+#include "histogram.h"
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The PrometheusWriter class writes metrics in the Prometheus text exposition format
+ * (version 0.0.4). Each metric family starts with a call to family(), followed by
+ * its samples.
+ */
+
+class PrometheusWriter {
+public:
+    typedef vector<pair<string, string>> Labels;
+
+    /** Constructs a writer that appends to the given stream */
+    PrometheusWriter(ostream& out);
+
+    /** Writes the HELP and TYPE lines of a metric family. Type is counter, gauge
+     * or histogram. */
+    void family(const string& name, const string& type, const string& help);
+
+    /** Writes a single sample of a counter or gauge */
+    void sample(const string& name, double value, const Labels& labels = {});
+
+    /** Writes the cumulative buckets, sum and count of a histogram */
+    void histogram(const string& name, const Histogram::Snapshot& snapshot, const Labels& labels = {});
+
+private:
+    void writeLabels(const Labels& labels);
+    void writeValue(double value);
+
+    ostream& out;
+};
+
+}
+
+#endif // PROMETHEUSWRITER_H_INCLUDED
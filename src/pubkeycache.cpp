@@ -0,0 +1,89 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "pubkeycache.h"
+#include "utility.h"
+
+using namespace std;
+
+VtcBlockIndexer::PubKeyCache::PubKeyCache(size_t capacity) : hits(0), misses(0) {
+    setCapacity(capacity);
+}
+
+void VtcBlockIndexer::PubKeyCache::setCapacity(size_t capacity) {
+    shardCapacity = (capacity + shardCount - 1) / shardCount;
+}
+
+string VtcBlockIndexer::PubKeyCache::getAddress(const unsigned char* publicKey, size_t size) {
+    string key(reinterpret_cast<const char*>(publicKey), size);
+
+    // The first byte is the key type (02, 03, 04), the next one is already uniformly distributed
+    Shard& shard = shards[(size > 1 ? publicKey[1] : 0) % shardCount];
+
+    {
+        lock_guard<mutex> lock(shard.shardMutex);
+        auto it = shard.index.find(key);
+        if(it != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            hits++;
+            return it->second->address;
+        }
+    }
+
+    // Hash outside of the lock, another thread may insert the same key meanwhile
+    misses++;
+    Entry entry;
+    entry.publicKey = key;
+    entry.address = VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(VtcBlockIndexer::Utility::ripeMD160(VtcBlockIndexer::Utility::sha256(vector<unsigned char>(publicKey, publicKey + size))));
+    string address = entry.address;
+
+    lock_guard<mutex> lock(shard.shardMutex);
+    if(shard.index.find(key) != shard.index.end()) return address;
+
+    shard.entries.push_front(std::move(entry));
+    shard.index[key] = shard.entries.begin();
+    while(shard.entries.size() > shardCapacity) {
+        shard.index.erase(shard.entries.back().publicKey);
+        shard.entries.pop_back();
+    }
+    return address;
+}
+
+uint64_t VtcBlockIndexer::PubKeyCache::getHits() const {
+    return hits;
+}
+
+uint64_t VtcBlockIndexer::PubKeyCache::getMisses() const {
+    return misses;
+}
+
+double VtcBlockIndexer::PubKeyCache::getHitRate() const {
+    uint64_t h = hits;
+    uint64_t total = h + misses;
+    return (total == 0) ? 0 : (double)h / (double)total;
+}
+
+size_t VtcBlockIndexer::PubKeyCache::getSize() {
+    size_t size = 0;
+    for(size_t i = 0; i < shardCount; i++) {
+        lock_guard<mutex> lock(shards[i].shardMutex);
+        size += shards[i].entries.size();
+    }
+    return size;
+}
@@ -0,0 +1,91 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PUBKEYCACHE_H_INCLUDED
+#define PUBKEYCACHE_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The PubKeyCache class keeps the P2PKH address of recently seen public keys. Pay-to-pubkey and bare multisig outputs (mostly early coinbases and miners) reuse 
+ * the same keys many times, hashing and encoding them again is the expensive part of 
+ * solving those scripts. The cache is bounded and evicts the least recently used keys. 
+ * It is split in shards with their own lock, so it can be used from all threads.
+ */
+
+class PubKeyCache {
+public:
+    /** Constructs a cache holding at most capacity public keys
+     */
+    PubKeyCache(size_t capacity = 100000);
+
+    /** Changes the maximum number of public keys in the cache. Intended to be
+     * called at startup, before the cache is in use.
+     */
+    void setCapacity(size_t capacity);
+
+    /** Returns the P2PKH address for the public key (33 or 65 bytes) */
+    string getAddress(const unsigned char* publicKey, size_t size);
+
+    /** Number of lookups that were served from the cache */
+    uint64_t getHits() const;
+
+    /** Number of lookups that had to hash the public key */
+    uint64_t getMisses() const;
+
+    /** Fraction of lookups served from the cache, 0 if there were none */
+    double getHitRate() const;
+
+    /** Number of public keys currently in the cache */
+    size_t getSize();
+
+private:
+    struct Entry {
+        string publicKey;
+        string address;
+    };
+
+    struct Shard {
+        mutex shardMutex;
+        // Most recently used entries first
+        list<Entry> entries;
+        unordered_map<string, list<Entry>::iterator> index;
+    };
+
+    static const size_t shardCount = 16;
+
+    Shard shards[shardCount];
+    atomic<size_t> shardCapacity;
+    atomic<uint64_t> hits;
+    atomic<uint64_t> misses;
+};
+
+}
+
+#endif // PUBKEYCACHE_H_INCLUDED
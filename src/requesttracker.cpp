@@ -0,0 +1,184 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "requesttracker.h"
+
+using namespace std;
+
+thread_local shared_ptr<VtcBlockIndexer::RequestTracker::Trace> VtcBlockIndexer::RequestTracker::currentTrace;
+
+VtcBlockIndexer::RequestTracker::Trace::~Trace() {
+    tracker->finish(*this);
+}
+
+VtcBlockIndexer::RequestTracker::Scope::Scope(const shared_ptr<Trace>& trace) : trace(trace), previous(currentTrace) {
+    currentTrace = trace;
+}
+
+VtcBlockIndexer::RequestTracker::Scope::~Scope() {
+    currentTrace = previous;
+}
+
+VtcBlockIndexer::RequestTracker::RpcCall::RpcCall() : start(chrono::steady_clock::now()) {
+}
+
+VtcBlockIndexer::RequestTracker::RpcCall::~RpcCall() {
+    if(currentTrace) {
+        currentTrace->rpcCalls++;
+        currentTrace->rpcTime += chrono::steady_clock::now() - start;
+    }
+}
+
+VtcBlockIndexer::RequestTracker::EndpointStats::EndpointStats() :
+    latency(Histogram::exponentialBounds(0.0001, 2, 18)),
+    leveldbGets(0), iteratorSteps(0), leveldbNanoseconds(0), rpcCalls(0), rpcNanoseconds(0) {
+}
+
+VtcBlockIndexer::RequestTracker::RequestTracker(double slowThreshold, size_t slowLogCapacity) : slowThreshold(slowThreshold), slowLogCapacity(slowLogCapacity), nextSlow(0) {
+}
+
+void VtcBlockIndexer::RequestTracker::setSlowLog(double slowThreshold, size_t slowLogCapacity) {
+    lock_guard<mutex> lock(slowMutex);
+    this->slowThreshold = slowThreshold;
+    this->slowLogCapacity = slowLogCapacity;
+    this->slowRequests.clear();
+    this->nextSlow = 0;
+}
+
+void VtcBlockIndexer::RequestTracker::addEndpoint(const string& endpoint) {
+    if(endpoints.find(endpoint) == endpoints.end()) {
+        endpoints[endpoint].reset(new EndpointStats());
+    }
+}
+
+shared_ptr<VtcBlockIndexer::RequestTracker::Trace> VtcBlockIndexer::RequestTracker::start(const string& endpoint, const string& path) {
+    shared_ptr<Trace> trace = make_shared<Trace>();
+    trace->tracker = this;
+    trace->endpoint = endpoint;
+    trace->path = path;
+    trace->start = chrono::steady_clock::now();
+    trace->leveldbGets = 0;
+    trace->iteratorSteps = 0;
+    trace->leveldbTime = chrono::steady_clock::duration::zero();
+    trace->rpcCalls = 0;
+    trace->rpcTime = chrono::steady_clock::duration::zero();
+    return trace;
+}
+
+shared_ptr<VtcBlockIndexer::RequestTracker::Trace> VtcBlockIndexer::RequestTracker::current() {
+    return currentTrace;
+}
+
+bool VtcBlockIndexer::RequestTracker::tracing() {
+    return currentTrace.get() != NULL;
+}
+
+void VtcBlockIndexer::RequestTracker::leveldbGet(chrono::steady_clock::duration duration) {
+    if(currentTrace) {
+        currentTrace->leveldbGets++;
+        currentTrace->leveldbTime += duration;
+    }
+}
+
+void VtcBlockIndexer::RequestTracker::iteratorStep(chrono::steady_clock::duration duration) {
+    if(currentTrace) {
+        currentTrace->iteratorSteps++;
+        currentTrace->leveldbTime += duration;
+    }
+}
+
+void VtcBlockIndexer::RequestTracker::finish(const Trace& trace) {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - trace.start).count();
+    uint64_t leveldbNanoseconds = chrono::duration_cast<chrono::nanoseconds>(trace.leveldbTime).count();
+    uint64_t rpcNanoseconds = chrono::duration_cast<chrono::nanoseconds>(trace.rpcTime).count();
+
+    auto endpoint = endpoints.find(trace.endpoint);
+    if(endpoint != endpoints.end()) {
+        EndpointStats& stats = *endpoint->second;
+        stats.latency.observe(seconds);
+        stats.leveldbGets += trace.leveldbGets;
+        stats.iteratorSteps += trace.iteratorSteps;
+        stats.leveldbNanoseconds += leveldbNanoseconds;
+        stats.rpcCalls += trace.rpcCalls;
+        stats.rpcNanoseconds += rpcNanoseconds;
+    }
+
+    if(seconds < slowThreshold) return;
+
+    SlowRequest slow;
+    slow.time = time(NULL);
+    slow.endpoint = trace.endpoint;
+    slow.path = trace.path;
+    slow.seconds = seconds;
+    slow.leveldbGets = trace.leveldbGets;
+    slow.iteratorSteps = trace.iteratorSteps;
+    slow.leveldbSeconds = leveldbNanoseconds / 1e9;
+    slow.rpcCalls = trace.rpcCalls;
+    slow.rpcSeconds = rpcNanoseconds / 1e9;
+
+    lock_guard<mutex> lock(slowMutex);
+    if(slowLogCapacity == 0) return;
+    if(slowRequests.size() < slowLogCapacity) {
+        slowRequests.push_back(slow);
+    } else {
+        slowRequests[nextSlow] = slow;
+    }
+    nextSlow = (nextSlow + 1) % slowLogCapacity;
+}
+
+vector<VtcBlockIndexer::RequestTracker::SlowRequest> VtcBlockIndexer::RequestTracker::getSlowRequests() {
+    lock_guard<mutex> lock(slowMutex);
+    vector<SlowRequest> result;
+    for(size_t i = 1; i <= slowRequests.size(); i++) {
+        result.push_back(slowRequests[(nextSlow + slowRequests.size() - i) % slowRequests.size()]);
+    }
+    return result;
+}
+
+double VtcBlockIndexer::RequestTracker::getSlowThreshold() const {
+    return slowThreshold;
+}
+
+void VtcBlockIndexer::RequestTracker::writeMetrics(PrometheusWriter& writer) const {
+    writer.family("vtc_indexer_http_request_seconds", "histogram", "Time to handle a request, per endpoint");
+    for(const auto& endpoint : endpoints) {
+        writer.histogram("vtc_indexer_http_request_seconds", endpoint.second->latency.snapshot(), { { "endpoint", endpoint.first } });
+    }
+
+    writer.family("vtc_indexer_http_leveldb_gets_total", "counter", "LevelDB reads done by requests, per endpoint");
+    for(const auto& endpoint : endpoints) {
+        writer.sample("vtc_indexer_http_leveldb_gets_total", endpoint.second->leveldbGets, { { "endpoint", endpoint.first } });
+    }
+    writer.family("vtc_indexer_http_leveldb_iterator_steps_total", "counter", "LevelDB iterator seeks and steps done by requests, per endpoint");
+    for(const auto& endpoint : endpoints) {
+        writer.sample("vtc_indexer_http_leveldb_iterator_steps_total", endpoint.second->iteratorSteps, { { "endpoint", endpoint.first } });
+    }
+    writer.family("vtc_indexer_http_leveldb_seconds_total", "counter", "Time requests spent in LevelDB reads and iterators, per endpoint");
+    for(const auto& endpoint : endpoints) {
+        writer.sample("vtc_indexer_http_leveldb_seconds_total", endpoint.second->leveldbNanoseconds / 1e9, { { "endpoint", endpoint.first } });
+    }
+    writer.family("vtc_indexer_http_rpc_calls_total", "counter", "RPC calls to the coin daemon done by requests, per endpoint");
+    for(const auto& endpoint : endpoints) {
+        writer.sample("vtc_indexer_http_rpc_calls_total", endpoint.second->rpcCalls, { { "endpoint", endpoint.first } });
+    }
+    writer.family("vtc_indexer_http_rpc_seconds_total", "counter", "Time requests spent waiting for the coin daemon, per endpoint");
+    for(const auto& endpoint : endpoints) {
+        writer.sample("vtc_indexer_http_rpc_seconds_total", endpoint.second->rpcNanoseconds / 1e9, { { "endpoint", endpoint.first } });
+    }
+}
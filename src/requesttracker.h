@@ -0,0 +1,166 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REQUESTTRACKER_H_INCLUDED
+#define REQUESTTRACKER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include "histogram.h"
+#include "prometheuswriter.h"
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The RequestTracker class times the requests to the HTTP server per endpoint, and
+ * counts what each request did: LevelDB reads and iterator steps, and RPC calls to
+ * the coin daemon. Requests that took longer than a threshold are kept, with that
+ * breakdown, in a ring buffer.
+ * 
+ * A request is traced by keeping a Scope on the thread handling it. The LevelDB 
+ * wrapper and the RPC call sites report to the trace of the current thread through
+ * the static hooks, which do nothing outside of a request.
+ */
+
+class RequestTracker {
+public:
+    /** What one request did. Recorded when the last reference to it is released, so
+     * asynchronous handlers can keep it alive until they respond. */
+    struct Trace {
+        ~Trace();
+
+        RequestTracker* tracker;
+        string endpoint;
+        string path;
+        chrono::steady_clock::time_point start;
+        uint64_t leveldbGets;
+        uint64_t iteratorSteps;
+        chrono::steady_clock::duration leveldbTime;
+        uint64_t rpcCalls;
+        chrono::steady_clock::duration rpcTime;
+    };
+
+    /** A request that took longer than the threshold */
+    struct SlowRequest {
+        time_t time;
+        string endpoint;
+        string path;
+        double seconds;
+        uint64_t leveldbGets;
+        uint64_t iteratorSteps;
+        double leveldbSeconds;
+        uint64_t rpcCalls;
+        double rpcSeconds;
+    };
+
+    /** Makes the trace the current request of this thread while in scope */
+    class Scope {
+    public:
+        Scope(const shared_ptr<Trace>& trace);
+        ~Scope();
+
+    private:
+        shared_ptr<Trace> trace;
+        shared_ptr<Trace> previous;
+    };
+
+    /** Times one RPC call of the current request while in scope */
+    class RpcCall {
+    public:
+        RpcCall();
+        ~RpcCall();
+
+    private:
+        chrono::steady_clock::time_point start;
+    };
+
+    /** Constructs a tracker that keeps the last slowLogCapacity requests that took
+     * longer than slowThreshold seconds */
+    RequestTracker(double slowThreshold = 1, size_t slowLogCapacity = 100);
+
+    /** Changes the threshold and the number of slow requests kept. Intended to be 
+     * called at startup. */
+    void setSlowLog(double slowThreshold, size_t slowLogCapacity);
+
+    /** Adds an endpoint to time. All endpoints have to be added before the first
+     * request is started. */
+    void addEndpoint(const string& endpoint);
+
+    /** Starts tracing a request to the endpoint */
+    shared_ptr<Trace> start(const string& endpoint, const string& path);
+
+    /** Returns the trace of the request handled on this thread, or an empty pointer */
+    static shared_ptr<Trace> current();
+
+    /** Returns true when a request is traced on this thread */
+    static bool tracing();
+
+    /** Hooks counting a LevelDB read and an iterator step (seek or next) of the 
+     * current request */
+    static void leveldbGet(chrono::steady_clock::duration duration);
+    static void iteratorStep(chrono::steady_clock::duration duration);
+
+    /** Returns the slow requests, newest first */
+    vector<SlowRequest> getSlowRequests();
+
+    /** The threshold in seconds above which requests are logged */
+    double getSlowThreshold() const;
+
+    /** Writes the per-endpoint metrics in the Prometheus text format */
+    void writeMetrics(PrometheusWriter& writer) const;
+
+private:
+    struct EndpointStats {
+        EndpointStats();
+
+        Histogram latency;
+        atomic<uint64_t> leveldbGets;
+        atomic<uint64_t> iteratorSteps;
+        atomic<uint64_t> leveldbNanoseconds;
+        atomic<uint64_t> rpcCalls;
+        atomic<uint64_t> rpcNanoseconds;
+    };
+
+    /** Records a finished request */
+    void finish(const Trace& trace);
+
+    static thread_local shared_ptr<Trace> currentTrace;
+
+    map<string, unique_ptr<EndpointStats>> endpoints;
+
+    atomic<double> slowThreshold;
+    mutex slowMutex;
+    size_t slowLogCapacity;
+    size_t nextSlow;
+    vector<SlowRequest> slowRequests;
+};
+
+}
+
+#endif // REQUESTTRACKER_H_INCLUDED
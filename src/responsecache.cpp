@@ -0,0 +1,76 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "responsecache.h"
+
+using namespace std;
+
+VtcBlockIndexer::ResponseCache::ResponseCache(size_t maxEntries) : maxEntries(maxEntries), generation(0), hits(0), misses(0) {
+    instance = to_string(chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count());
+}
+
+shared_ptr<const VtcBlockIndexer::ResponseCache::Entry> VtcBlockIndexer::ResponseCache::get(const string& key, uint64_t version, chrono::steady_clock::duration maxAge) {
+    shared_ptr<const Entry> entry;
+    {
+        lock_guard<mutex> lock(entriesMutex);
+        auto found = entries.find(key);
+        if(found != entries.end()) {
+            entry = found->second;
+        }
+    }
+
+    if(!entry || entry->version != version || (maxAge != chrono::steady_clock::duration::zero() && chrono::steady_clock::now() - entry->created > maxAge)) {
+        misses++;
+        return shared_ptr<const Entry>();
+    }
+    hits++;
+    return entry;
+}
+
+shared_ptr<const VtcBlockIndexer::ResponseCache::Entry> VtcBlockIndexer::ResponseCache::put(const string& key, uint64_t version, const string& body) {
+    shared_ptr<Entry> entry = make_shared<Entry>();
+    entry->version = version;
+    entry->created = chrono::steady_clock::now();
+    entry->body = body;
+
+    // The versions and generations start over when the indexer restarts, the instance keeps
+    // ETags from before a restart from matching
+    entry->etag = "\"" + instance + "-" + to_string(version) + "-" + to_string(++generation) + "\"";
+
+    lock_guard<mutex> lock(entriesMutex);
+    auto found = entries.find(key);
+    if(found != entries.end() && found->second->version > version) {
+        // Built concurrently with a newer one, keep the newer one
+        return entry;
+    }
+    if(found == entries.end() && entries.size() >= maxEntries) {
+        // Keys are few (endpoint and normalized parameters), so just start over
+        entries.clear();
+    }
+    entries[key] = entry;
+    return entry;
+}
+
+uint64_t VtcBlockIndexer::ResponseCache::getHits() const {
+    return hits;
+}
+
+uint64_t VtcBlockIndexer::ResponseCache::getMisses() const {
+    return misses;
+}
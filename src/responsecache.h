@@ -0,0 +1,84 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESPONSECACHE_H_INCLUDED
+#define RESPONSECACHE_H_INCLUDED
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <cstdint>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The ResponseCache class keeps serialized HTTP response bodies that only change 
+ * when the indexed chain changes. Every entry is stored with the tip version it was 
+ * built at (see BlockIndexer::getTipVersion), and is only served at that version, so
+ * indexing or disconnecting a block invalidates all entries at once. Entries get an
+ * ETag, so polling clients can revalidate without receiving the body again.
+ */
+
+class ResponseCache {
+public:
+    /** A cached response body */
+    struct Entry {
+        uint64_t version;
+        chrono::steady_clock::time_point created;
+        string body;
+        string etag;
+    };
+
+    /** Constructs a cache that holds at most maxEntries bodies */
+    ResponseCache(size_t maxEntries = 256);
+
+    /** Returns the entry for the key if it was built at the given version (and, when
+     * maxAge is not zero, not longer than maxAge ago). Returns an empty pointer 
+     * otherwise. */
+    shared_ptr<const Entry> get(const string& key, uint64_t version, chrono::steady_clock::duration maxAge = chrono::steady_clock::duration::zero());
+
+    /** Stores the body for the key at the given version and returns the new entry.
+     * The version must have been read before building the body. */
+    shared_ptr<const Entry> put(const string& key, uint64_t version, const string& body);
+
+    /** Number of lookups that were served from the cache */
+    uint64_t getHits() const;
+
+    /** Number of lookups that had to build the body */
+    uint64_t getMisses() const;
+
+private:
+    size_t maxEntries;
+    string instance;
+    mutex entriesMutex;
+    unordered_map<string, shared_ptr<const Entry>> entries;
+    atomic<uint64_t> generation;
+    atomic<uint64_t> hits;
+    atomic<uint64_t> misses;
+};
+
+}
+
+#endif // RESPONSECACHE_H_INCLUDED
@@ -22,290 +22,237 @@
 #include "utility.h"
 #include <iostream>
 #include <sstream>
-#include "leveldb/db.h"
-//#include "hashing.h"
 #include <memory>
 #include <iomanip>
 
 using namespace std;
-VtcBlockIndexer::ScriptSolver::ScriptSolver() {
-
-}
-
-vector<string> VtcBlockIndexer::ScriptSolver::getAddressesFromScript(vector<unsigned char> script) {
-    vector<string> addresses;
-    uint64_t scriptSize = script.size();
-    bool parsed = false;
 
-    // The most common output script type that pays to hash160(pubKey)
-    if(
-        
-            (25==scriptSize                  &&
-            0x76==script.at(0)              &&  // OP_DUP
-            0xA9==script.at(1)              &&  // OP_HASH160
-              20==script.at(2)              &&  // OP_PUSHDATA(20)
-            
-            (0x88==script.at(scriptSize-2)   &&  // OP_EQUALVERIFY
-            0xAC==script.at(scriptSize-1)))      // OP_CHECKSIG
-
-            ||
-// scripts appended with OP_NOP1. Since OP_NOP1 does nothing, this should still be valid.
-
-            (25==scriptSize                  &&
-                0x76==script.at(0)              &&  // OP_DUP
-                0xA9==script.at(1)              &&  // OP_HASH160
-                  20==script.at(2)              &&  // OP_PUSHDATA(20)
-                
-                (0x88==script.at(scriptSize-2)   &&  // OP_EQUALVERIFY
-                0xB0==script.at(scriptSize-1)))      // OP_NOP1
-    
-                ||
-
-            // scripts appended with OP_NOP. Since OP_NOP does nothing, this should still be valid.
-
-            (26==scriptSize                  &&
-            0x76==script.at(0)              &&  // OP_DUP
-            0xA9==script.at(1)              &&  // OP_HASH160
-              20==script.at(2)              &&  // OP_PUSHDATA(20)
-
-            
-            (0x88==script.at(scriptSize-3)   &&  // OP_EQUALVERIFY
-            0xAC==script.at(scriptSize-2)   &&  // OP_CHECKSIG
-            0x61==script.at(scriptSize-1)))     // OP_NOP
-            
-              
-        
-    ) { 
-        addresses.push_back(VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(vector<unsigned char>(&script[3], &script[23])));
-        parsed = true;
-    }
-
-    // Output script commonly found in block reward TX, that pays to an explicit pubKey
-    if(
-            67==scriptSize                &&  
-              65==script.at(0)            &&  // OP_PUSHDATA(65)
-            0xAC==script.at(scriptSize-1) // OP_CHECKSIG
-              
-    ) {
-        addresses.push_back(VtcBlockIndexer::Utility::publicKeyToAddress(vector<unsigned char>(&script[1], &script[66])));
-        parsed = true;
-    }
+namespace
+{
+    /** A fixed size script template: the script has to be exactly size bytes long, start 
+     * with the prefix bytes and end with the suffix bytes. The bytes in between are the payload.
+     */
+    struct FixedTemplate {
+        uint8_t size;
+        VtcBlockIndexer::ScriptTemplate type;
+        uint8_t prefixLength;
+        uint8_t prefix[6];
+        uint8_t suffixLength;
+        uint8_t suffix[3];
+    };
+
+    const FixedTemplate fixedTemplates[] = {
+        // The most common output script type that pays to hash160(pubKey)
+        // OP_DUP OP_HASH160 OP_PUSHDATA(20) <hash> OP_EQUALVERIFY OP_CHECKSIG
+        { 25, VtcBlockIndexer::ScriptTemplate::PubKeyHash, 3, { 0x76, 0xA9, 20 }, 2, { 0x88, 0xAC } },
+
+        // Scripts appended with OP_NOP1. Since OP_NOP1 does nothing, this should still be valid.
+        { 25, VtcBlockIndexer::ScriptTemplate::PubKeyHash, 3, { 0x76, 0xA9, 20 }, 2, { 0x88, 0xB0 } },
+
+        // Scripts appended with OP_NOP. Since OP_NOP does nothing, this should still be valid.
+        { 26, VtcBlockIndexer::ScriptTemplate::PubKeyHash, 3, { 0x76, 0xA9, 20 }, 3, { 0x88, 0xAC, 0x61 } },
+
+        // A modern output script type, that pays to hash160(script)
+        // OP_HASH160 OP_PUSHDATA(20) <hash> OP_EQUAL
+        { 23, VtcBlockIndexer::ScriptTemplate::ScriptHash, 2, { 0xA9, 20 }, 1, { 0x87 } },
+
+        // Output script commonly found in block reward TX, that pays to an explicit pubKey
+        // OP_PUSHDATA(65) <pubKey> OP_CHECKSIG
+        { 67, VtcBlockIndexer::ScriptTemplate::PubKey, 1, { 65 }, 1, { 0xAC } },
+
+        // Pay to compressed pubkey script
+        // OP_PUSHDATA(33) <pubKey> OP_CHECKSIG
+        { 35, VtcBlockIndexer::ScriptTemplate::PubKey, 1, { 33 }, 1, { 0xAC } },
+
+        // P2WPKH: OP_0 OP_PUSHDATA(20) <hash>
+        { 22, VtcBlockIndexer::ScriptTemplate::WitnessPubKeyHash, 2, { 0x00, 0x14 }, 0, { } },
+
+        // P2WSH: OP_0 OP_PUSHDATA(32) <hash>
+        { 34, VtcBlockIndexer::ScriptTemplate::WitnessScriptHash, 2, { 0x00, 0x20 }, 0, { } },
+
+        // OP_PUSHDATA(32) + data only (Found in litecoin chain - nonstandard script)
+        // Public block explorers show these as "unknown" (https://bchain.info/LTC/tx/265278e51d1b29cdce906a858251b7ce15e2dab09de7dede0acb4c629f780b91)
+        { 33, VtcBlockIndexer::ScriptTemplate::NonStandard, 1, { 0x20 }, 0, { } },
+
+        // OP_PUSHDATA(36) + data only (Found in litecoin chain - nonstandard script)
+        // Public block explorers show these as "unknown" (http://explorer.litecoin.net/tx/936e8ed1cfca736320fdced61c2d03886b232497ea975e41d101f1d83bb74c44)
+        { 37, VtcBlockIndexer::ScriptTemplate::NonStandard, 1, { 0x24 }, 0, { } },
+
+        // OP_PUSHDATA(20) + data only. Unparseable (BTC)
+        // Public block explorers show these as "unknown" (https://blockchain.info/tx/b8fd633e7713a43d5ac87266adc78444669b987a56b3a65fb92d58c2c4b0e84d)
+        { 24, VtcBlockIndexer::ScriptTemplate::NonStandard, 1, { 0x14 }, 0, { } },
+
+        // Unknown (seems malformed) output script found on Litecoin in p2pool blocks
+        // For example https://bchain.info/LTC/tx/8f1220670b5d4ade8f9c6a82fde3d88a28d2e1c290f2edc6d7a7a13aa0352fc7 
+        // OP_IFDUP OP_IF OP_2SWAP OP_VERIFY OP_2OVER OP_DEPTH
+        { 6, VtcBlockIndexer::ScriptTemplate::NonStandard, 6, { 0x73, 0x63, 0x72, 0x69, 0x70, 0x74 }, 0, { } },
+    };
+
+    const size_t fixedTemplateCount = sizeof(fixedTemplates) / sizeof(fixedTemplates[0]);
+    const size_t maxFixedTemplateSize = 67;
+
+    /** For every script size, the index of the first template of that size in fixedTemplates
+     * and the number of templates, so matching a script only looks at the candidates for its size.
+     */
+    struct TemplateRange {
+        uint8_t first;
+        uint8_t count;
+    };
+
+    struct TemplateIndex {
+        TemplateRange bySize[maxFixedTemplateSize + 1];
+
+        TemplateIndex() {
+            for(size_t i = 0; i <= maxFixedTemplateSize; i++) {
+                bySize[i] = { 0, 0 };
+            }
+            // Templates of the same size are adjacent in the table
+            for(size_t i = 0; i < fixedTemplateCount; i++) {
+                TemplateRange& range = bySize[fixedTemplates[i].size];
+                if(range.count == 0) range.first = (uint8_t)i;
+                range.count++;
+            }
+        }
+    };
 
-    // Pay to compressed pubkey script
-    if(
-        35==scriptSize                &&
-        0x21==script.at(0)            &&  // OP_PUSHDATA(33)
-        0xAC==script.at(scriptSize-1)     // OP_CHECKSIG
-    ) {
-        addresses.push_back(VtcBlockIndexer::Utility::publicKeyToAddress(vector<unsigned char>(&script[1], &script[34])));
-        parsed = true;
-    }
-    
-    // P2WSH
-    if(
-        22 == scriptSize            &&
-        0x00 == script.at(0)        &&  
-        0x14 == script.at(1)        
-    ) {
-        addresses.push_back(VtcBlockIndexer::Utility::bech32Address(vector<unsigned char>(&script[2], &script[22])));
-        parsed = true;
-    }
+    const TemplateIndex templateIndex;
 
-    // P2WPKH
-    if(
-        34 == scriptSize            &&
-        0x00 == script.at(0)        &&  
-        0x20 == script.at(1)        
-    ) {
-        addresses.push_back(VtcBlockIndexer::Utility::bech32Address(vector<unsigned char>(&script[2], &script[34])));
-        parsed = true;
+    bool matchesFixedTemplate(const FixedTemplate& t, const unsigned char* script, size_t scriptSize) {
+        for(uint8_t i = 0; i < t.prefixLength; i++) {
+            if(script[i] != t.prefix[i]) return false;
+        }
+        const unsigned char* suffix = script + scriptSize - t.suffixLength;
+        for(uint8_t i = 0; i < t.suffixLength; i++) {
+            if(suffix[i] != t.suffix[i]) return false;
+        }
+        return true;
     }
 
-    // NULLDATA script. starts with OP_RETURN followed by arbitrary data and no further opcodes. Not needed to be stored in UTXO database. So Ignore.
-    if(
-        scriptSize > 0        && 
-        0x6A == script.at(0)    
-    ) {
-        uint32_t pos = 1;
-        
-        bool foundOpcodes = false;
-        while(pos < script.size()) {
-            if(script.at(pos) >= 0x01 && script.at(pos) <= 0x4B) { 
-                pos += script.at(pos) + 1;
-            } else {
-                foundOpcodes = true;
+    /** Walks the 33 and 65 byte public key pushes following the first opcode of a multisig
+     * script. Returns the number of bytes covered by the pushes.
+     */
+    size_t multiSigKeysLength(const unsigned char* script, size_t scriptSize) {
+        size_t pos = 1;
+        while(pos + 2 < scriptSize) {
+            size_t keyLength = script[pos];
+            if((keyLength != 33 && keyLength != 65) || pos + 1 + keyLength > scriptSize) {
                 break;
-            } 
+            }
+            pos += keyLength + 1;
         }
-
-        if(!foundOpcodes)
-            parsed = true;
-    }
-
-    // A modern output script type, that pays to hash160(script)
-    if(
-        23 == scriptSize                &&
-            0xA9==script.at(0)             &&  // OP_HASH160
-              20==script.at(1)             &&  // OP_PUSHDATA(20)
-            0x87==script.at(scriptSize-1)      // OP_EQUAL
-              
-        
-    ) {
-        addresses.push_back(VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(vector<unsigned char>(&script[2], &script[22])));
-        parsed = true;
-    }
-
-    // OP_PUSHDATA(32) + data only (Found in litecoin chain - nonstandard script)
-    // Public block explorers show these as "unknown" (https://bchain.info/LTC/tx/265278e51d1b29cdce906a858251b7ce15e2dab09de7dede0acb4c629f780b91)
-    if(
-        
-            33==scriptSize                  &&
-            0x20==script.at(0)             
-            
-        
-    ) {
-        
-        parsed = true;
-    }
-
-    // OP_PUSHDATA(36) + data only (Found in litecoin chain - nonstandard script)
-    // Public block explorers show these as "unknown" (http://explorer.litecoin.net/tx/936e8ed1cfca736320fdced61c2d03886b232497ea975e41d101f1d83bb74c44)
-    if(
-        
-            37==scriptSize                  &&
-            0x24==script.at(0)             
-            
-        
-    ) {
-        
-        parsed = true;
+        return pos - 1;
     }
+}
 
-    // OP_PUSHDATA(20) + data only. Unparseable (BTC)
-    // Public block explorers show these as "unknown" (https://blockchain.info/tx/b8fd633e7713a43d5ac87266adc78444669b987a56b3a65fb92d58c2c4b0e84d)
-    if(
-        
-            24==scriptSize                  &&
-            0x14==script.at(0)             
-            
-        
-    ) {
-        
-        parsed = true;
-    }
+VtcBlockIndexer::PubKeyCache VtcBlockIndexer::ScriptSolver::pubKeyCache;
+VtcBlockIndexer::ScriptStatistics VtcBlockIndexer::ScriptSolver::scriptStatistics;
 
+VtcBlockIndexer::ScriptSolver::ScriptSolver() {
 
-    // Unknown (seems malformed) output script found on Litecoin in p2pool blocks
-    // For example https://bchain.info/LTC/tx/8f1220670b5d4ade8f9c6a82fde3d88a28d2e1c290f2edc6d7a7a13aa0352fc7 
-    if(
-        6 == scriptSize                &&
-            0x73==script.at(0)             &&  // OP_IFDUP
-            0x63==script.at(1)             &&  // OP_IF
-            0x72==script.at(2)             &&  // OP_2SWAP
-            0x69==script.at(3)             &&  // OP_VERIFY
-            0x70==script.at(4)             &&  // OP_2OVER
-            0x74==script.at(5)              // OP_DEPTH
-            
-        
-    ) {
+}
 
-        parsed = true;
-    }
+VtcBlockIndexer::ScriptClassification VtcBlockIndexer::ScriptSolver::classify(const vector<unsigned char>& script) {
+    return classify(script.data(), script.size());
+}
 
-    if(isMultiSig(script)) {
-        uint32_t pos = 1;
-        while(pos < script.size()-2) {
-            if(script.at(pos) == 0x21) {
-                addresses.push_back(VtcBlockIndexer::Utility::publicKeyToAddress(vector<unsigned char>(&script[pos+1], &script[pos+34]))); 
-                pos += 34;
-                parsed = true;
-            }
-            else if(script.at(pos) == 0x41) {
-                addresses.push_back(VtcBlockIndexer::Utility::publicKeyToAddress(vector<unsigned char>(&script[pos+1], &script[pos+66])));
-                pos += 66;
-                parsed = true;
-            }
-            else
-            {
-                pos = script.size();
+VtcBlockIndexer::ScriptClassification VtcBlockIndexer::ScriptSolver::classify(const unsigned char* script, size_t scriptSize) {
+    ScriptClassification result = { ScriptTemplate::Unknown, { script, 0 }, -1 };
+    if(scriptSize == 0) return result;
+
+    if(scriptSize <= maxFixedTemplateSize) {
+        const TemplateRange& range = templateIndex.bySize[scriptSize];
+        for(uint8_t i = range.first; i < range.first + range.count; i++) {
+            const FixedTemplate& t = fixedTemplates[i];
+            if(t.prefix[0] == script[0] && matchesFixedTemplate(t, script, scriptSize)) {
+                result.type = t.type;
+                if(t.type != ScriptTemplate::NonStandard) {
+                    result.payload = { script + t.prefixLength, scriptSize - t.prefixLength - t.suffixLength };
+                }
+                return result;
             }
         }
-        
     }
 
-    // A challenge: anyone who can find X such that 0==RIPEMD160(X) stands to earn a bunch of coins
-    
-    if(
-        0x76==script[0] &&                  // OP_DUP
-        0xA9==script[1] &&                  // OP_HASH160
-        0x00==script[2] &&                  // OP_0
-        0x88==script[3] &&                  // OP_EQUALVERIFY
-        0xAC==script[4]                     // OP_CHECKSIG
-    ) {
-        parsed = true;
+    // NULLDATA script. starts with OP_RETURN followed by arbitrary data and no further opcodes. 
+    // Not needed to be stored in UTXO database. So Ignore.
+    if(script[0] == 0x6A) {
+        size_t pos = 1;
+        while(pos < scriptSize && script[pos] >= 0x01 && script[pos] <= 0x4B) {
+            pos += script[pos] + 1;
+        }
+        if(pos >= scriptSize) {
+            result.type = ScriptTemplate::NullData;
+            return result;
+        }
     }
 
-
-
-
-    if(!parsed) {
-        stringstream ssScript;
-        for(uint64_t i = 0; i < scriptSize; i++)
-        {
-            ssScript << hex << setw(2) << setfill('0') << static_cast<int>(script.at(i));
+    // OP_CHECKMULTISIG: the public keys are pushed after the number of required signatures
+    if(script[scriptSize-1] == 0xAE) {
+        size_t keysLength = multiSigKeysLength(script, scriptSize);
+        if(keysLength > 0) {
+            result.type = ScriptTemplate::MultiSig;
+            result.payload = { script + 1, keysLength };
+            result.requiredSignatures = (int)script[0];
+            return result;
         }
-        cout << "Unrecognized script : [" << ssScript.str() << "]" << endl;
     }
 
-    return addresses;
-/*
-    
-
-    int m = 0;
-    int n = 0;
-    std::vector<uint160_t> addresses;
+    // A challenge: anyone who can find X such that 0==RIPEMD160(X) stands to earn a bunch of coins
+    // OP_DUP OP_HASH160 OP_0 OP_EQUALVERIFY OP_CHECKSIG
     if(
-        isMultiSig(
-            m,
-            n,
-            addresses,
-            script,
-            scriptSize
-        )
+        scriptSize >= 5 &&
+        0x76==script[0] &&
+        0xA9==script[1] &&
+        0x00==script[2] &&
+        0x88==script[3] &&
+        0xAC==script[4]
     ) {
-        packMultiSig(pubKeyHash, addresses, m, n);
-        addrType[0] = 8;
-        return 4;
+        result.type = ScriptTemplate::NonStandard;
     }
 
-    // Broken output scripts that were created by p2pool for a while
-    if(
-        0x73==script[0] &&                  // OP_IFDUP
-        0x63==script[1] &&                  // OP_IF
-        0x72==script[2] &&                  // OP_2SWAP
-        0x69==script[3] &&                  // OP_VERIFY
-        0x70==script[4] &&                  // OP_2OVER
-        0x74==script[5]                     // OP_DEPTH
-    ) {
-        return -2;
-    }
+    return result;
+}
 
-    // A non-functional "comment" script
-    if(isCommentScript(script, scriptSize)) {
-        return -3;
+vector<string> VtcBlockIndexer::ScriptSolver::getAddresses(const ScriptClassification& classification) {
+    vector<string> addresses;
+    const ScriptSpan& payload = classification.payload;
+    
+    switch(classification.type) {
+        case ScriptTemplate::PubKeyHash:
+            addresses.push_back(VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(payload.data, payload.size));
+            break;
+        case ScriptTemplate::ScriptHash:
+            addresses.push_back(VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(payload.data, payload.size));
+            break;
+        case ScriptTemplate::PubKey:
+            addresses.push_back(pubKeyCache.getAddress(payload.data, payload.size));
+            break;
+        case ScriptTemplate::WitnessPubKeyHash:
+        case ScriptTemplate::WitnessScriptHash:
+            addresses.push_back(VtcBlockIndexer::Utility::bech32Address(payload.data, payload.size));
+            break;
+        case ScriptTemplate::MultiSig:
+            for(size_t pos = 0; pos < payload.size; pos += payload.data[pos] + 1) {
+                addresses.push_back(pubKeyCache.getAddress(payload.data + pos + 1, payload.data[pos]));
+            }
+            break;
+        default:
+            break;
     }
 
-    
-    return addresses;*/
+    return addresses;
 }
 
-bool VtcBlockIndexer::ScriptSolver::isMultiSig(vector<unsigned char> script) {
-    if(script.size() == 0) return false;
-    return (script.at(script.size()-1) == 0xAE);
+vector<string> VtcBlockIndexer::ScriptSolver::getAddressesFromScript(const vector<unsigned char>& script) {
+    return getAddressesFromScript(script, "", 0);
 }
 
-int VtcBlockIndexer::ScriptSolver::requiredSignatures(vector<unsigned char> script) {
-    if(!isMultiSig(script)) return -1;
+vector<string> VtcBlockIndexer::ScriptSolver::getAddressesFromScript(const vector<unsigned char>& script, const string& txHash, uint32_t index) {
+    ScriptClassification classification = classify(script);
+
+    if(classification.type == ScriptTemplate::Unknown) {
+        scriptStatistics.recordUnknown(script.data(), script.size(), -1, txHash, index);
+    }
 
-    return (int)script.at(0);
-}
\ No newline at end of file
+    return getAddresses(classification);
+}
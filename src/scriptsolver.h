@@ -24,12 +24,67 @@
 
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <string>
 
 #include "blockchaintypes.h"
+#include "pubkeycache.h"
+#include "scriptstatistics.h"
 using namespace std;
 
 namespace VtcBlockIndexer {
 
+/** The output script templates recognized by the ScriptSolver */
+enum class ScriptTemplate : uint8_t {
+    // Script that does not match any known template
+    Unknown,
+
+    // OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG (and OP_NOP variants)
+    PubKeyHash,
+
+    // OP_HASH160 <20 bytes> OP_EQUAL
+    ScriptHash,
+
+    // <33 or 65 byte public key> OP_CHECKSIG
+    PubKey,
+
+    // OP_0 <20 bytes>
+    WitnessPubKeyHash,
+
+    // OP_0 <32 bytes>
+    WitnessScriptHash,
+
+    // <m> <public keys> <n> OP_CHECKMULTISIG
+    MultiSig,
+
+    // OP_RETURN followed by data pushes only
+    NullData,
+
+    // Known nonstandard scripts that cannot be spent to an address
+    NonStandard
+};
+
+/** A view on a range of bytes inside a script. Does not own the bytes, so it is 
+ * only valid as long as the script it was taken from.
+ */
+struct ScriptSpan {
+    const unsigned char* data;
+    size_t size;
+};
+
+/** The result of classifying an output script */
+struct ScriptClassification {
+    // The template the script matched
+    ScriptTemplate type;
+
+    // The hash (PubKeyHash, ScriptHash, witness programs), the public key (PubKey)
+    // or the public key pushes (MultiSig) inside the script
+    ScriptSpan payload;
+
+    // The number of required signatures (MultiSig only), as found in the script
+    int requiredSignatures;
+};
+
 /**
  * The ScriptSolver class provides methods to parse the bitcoin script language used in
  * transaction outputs and determine the public keys / addresses that can spend it.
@@ -41,17 +96,34 @@ public:
      */
     ScriptSolver();
 
+    /** Determines the template of the script by its size and first opcode, without
+     * allocating or copying any of it.
+     */
+    static ScriptClassification classify(const unsigned char* script, size_t scriptSize);
+    static ScriptClassification classify(const vector<unsigned char>& script);
+
+    /** Renders the addresses that can spend a classified script
+     */
+    vector<string> getAddresses(const ScriptClassification& classification);
+
     /** Read addresses from script
      */
-    vector<string> getAddressesFromScript(vector<unsigned char> scriptString);
+    vector<string> getAddressesFromScript(const vector<unsigned char>& script);
+
+    /** Read addresses from script, attributing an unknown script sample to the
+     * given unconfirmed transaction output
+     */
+    vector<string> getAddressesFromScript(const vector<unsigned char>& script, const string& txHash, uint32_t index);
 
-    /** Returns if the script is multisig
+    /** Addresses of the public keys in pay-to-pubkey and multisig scripts, shared by
+     * all ScriptSolver instances
      */
-    bool isMultiSig(vector<unsigned char> scriptString);
+    static VtcBlockIndexer::PubKeyCache pubKeyCache;
 
-    /** Returns the number of required signatures
+    /** Counts of the script templates seen by the indexer and a sample of the 
+     * unrecognized scripts, shared by all ScriptSolver instances
      */
-    int requiredSignatures(vector<unsigned char> scriptString);
+    static VtcBlockIndexer::ScriptStatistics scriptStatistics;
 };
 
 }
@@ -0,0 +1,139 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scriptstatistics.h"
+#include "scriptsolver.h"
+#include <algorithm>
+
+using namespace std;
+
+static_assert(static_cast<size_t>(VtcBlockIndexer::ScriptTemplate::NonStandard) + 1 == VtcBlockIndexer::ScriptStatistics::templateCount, "templateCount does not match the ScriptTemplate enum");
+
+const size_t VtcBlockIndexer::ScriptStatistics::templateCount;
+const size_t VtcBlockIndexer::ScriptStatistics::rangeCount;
+const size_t VtcBlockIndexer::ScriptStatistics::maxSampleScriptSize;
+
+VtcBlockIndexer::ScriptStatistics::ScriptStatistics(uint64_t rangeSize, size_t sampleCapacity, uint64_t sampleRate) : nextSample(0), unknownSeen(0), unknownDropped(0) {
+    for(size_t range = 0; range < rangeCount; range++) {
+        for(size_t type = 0; type < templateCount; type++) {
+            counts[range][type] = 0;
+        }
+    }
+    setRangeSize(rangeSize);
+    setSampling(sampleCapacity, sampleRate);
+}
+
+void VtcBlockIndexer::ScriptStatistics::setRangeSize(uint64_t rangeSize) {
+    this->rangeSize = max<uint64_t>(rangeSize, 1);
+}
+
+void VtcBlockIndexer::ScriptStatistics::setSampling(size_t sampleCapacity, uint64_t sampleRate) {
+    lock_guard<mutex> lock(sampleMutex);
+    this->sampleCapacity = sampleCapacity;
+    this->sampleRate = max<uint64_t>(sampleRate, 1);
+    samples.clear();
+    nextSample = 0;
+}
+
+void VtcBlockIndexer::ScriptStatistics::record(ScriptTemplate type, uint64_t height) {
+    size_t range = min<uint64_t>(height / rangeSize.load(memory_order_relaxed), rangeCount - 1);
+    counts[range][static_cast<size_t>(type)].fetch_add(1, memory_order_relaxed);
+}
+
+void VtcBlockIndexer::ScriptStatistics::recordUnknown(const unsigned char* script, size_t scriptSize, int64_t height, const string& txHash, uint32_t index) {
+    uint64_t seen = unknownSeen.fetch_add(1, memory_order_relaxed);
+    if(seen % sampleRate.load(memory_order_relaxed) != 0) return;
+
+    // Never wait for the sample, losing one is better than stalling the indexer
+    unique_lock<mutex> lock(sampleMutex, try_to_lock);
+    if(!lock.owns_lock()) {
+        unknownDropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    if(sampleCapacity == 0) return;
+
+    UnknownScript sample;
+    sample.height = height;
+    sample.txHash = txHash;
+    sample.index = index;
+    sample.scriptSize = scriptSize;
+    sample.script.assign(script, script + min(scriptSize, maxSampleScriptSize));
+
+    if(samples.size() < sampleCapacity) {
+        samples.push_back(std::move(sample));
+    } else {
+        samples[nextSample] = std::move(sample);
+    }
+    nextSample = (nextSample + 1) % sampleCapacity;
+}
+
+vector<VtcBlockIndexer::ScriptStatistics::RangeCounts> VtcBlockIndexer::ScriptStatistics::getRangeCounts() const {
+    vector<RangeCounts> result;
+    uint64_t size = rangeSize.load(memory_order_relaxed);
+    for(size_t range = 0; range < rangeCount; range++) {
+        RangeCounts rangeCounts;
+        uint64_t total = 0;
+        for(size_t type = 0; type < templateCount; type++) {
+            rangeCounts.counts[type] = counts[range][type].load(memory_order_relaxed);
+            total += rangeCounts.counts[type];
+        }
+        if(total == 0) continue;
+
+        rangeCounts.fromHeight = range * size;
+        rangeCounts.toHeight = (range == rangeCount - 1) ? UINT64_MAX : (range + 1) * size - 1;
+        result.push_back(rangeCounts);
+    }
+    return result;
+}
+
+vector<VtcBlockIndexer::ScriptStatistics::UnknownScript> VtcBlockIndexer::ScriptStatistics::getUnknownSamples() {
+    lock_guard<mutex> lock(sampleMutex);
+    if(samples.size() < sampleCapacity) return samples;
+
+    vector<UnknownScript> result(samples.begin() + nextSample, samples.end());
+    result.insert(result.end(), samples.begin(), samples.begin() + nextSample);
+    return result;
+}
+
+uint64_t VtcBlockIndexer::ScriptStatistics::getRangeSize() const {
+    return rangeSize;
+}
+
+uint64_t VtcBlockIndexer::ScriptStatistics::getUnknownSeen() const {
+    return unknownSeen;
+}
+
+uint64_t VtcBlockIndexer::ScriptStatistics::getUnknownDropped() const {
+    return unknownDropped;
+}
+
+const char* VtcBlockIndexer::ScriptStatistics::templateName(ScriptTemplate type) {
+    switch(type) {
+        case ScriptTemplate::PubKeyHash: return "pubKeyHash";
+        case ScriptTemplate::ScriptHash: return "scriptHash";
+        case ScriptTemplate::PubKey: return "pubKey";
+        case ScriptTemplate::WitnessPubKeyHash: return "witnessPubKeyHash";
+        case ScriptTemplate::WitnessScriptHash: return "witnessScriptHash";
+        case ScriptTemplate::MultiSig: return "multiSig";
+        case ScriptTemplate::NullData: return "nullData";
+        case ScriptTemplate::NonStandard: return "nonStandard";
+        default: return "unknown";
+    }
+}
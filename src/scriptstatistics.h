@@ -0,0 +1,131 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCRIPTSTATISTICS_H_INCLUDED
+#define SCRIPTSTATISTICS_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+enum class ScriptTemplate : uint8_t;
+
+/**
+ * The ScriptStatistics class counts the output script templates the indexer has seen,
+ * per range of block heights, and keeps a bounded sample of the scripts that did not 
+ * match any template. Counting only touches atomics, and sampling never waits for a 
+ * lock, so both can be called from the indexing hot path. Rendering (hex encoding the 
+ * samples) is left to the reader.
+ */
+
+class ScriptStatistics {
+public:
+    /** Number of values in the ScriptTemplate enum */
+    static const size_t templateCount = 9;
+
+    /** Number of height ranges that are counted. Heights beyond the last range are 
+     * added to the last range. */
+    static const size_t rangeCount = 1024;
+
+    /** Scripts in the sample are cut off after this many bytes */
+    static const size_t maxSampleScriptSize = 1024;
+
+    /** The template counts of one range of block heights */
+    struct RangeCounts {
+        uint64_t fromHeight;
+        uint64_t toHeight;
+        uint64_t counts[templateCount];
+    };
+
+    /** A sampled unrecognized output script */
+    struct UnknownScript {
+        // Height of the block, -1 if the output was not in a block (mempool)
+        int64_t height;
+
+        // Transaction and output index, txHash is empty when not known
+        string txHash;
+        uint32_t index;
+
+        // Size of the full script, the bytes kept may be cut off
+        size_t scriptSize;
+        vector<unsigned char> script;
+    };
+
+    /** Constructs a registry counting ranges of rangeSize heights, keeping at most 
+     * sampleCapacity unknown scripts and sampling one in sampleRate of them.
+     */
+    ScriptStatistics(uint64_t rangeSize = 10000, size_t sampleCapacity = 100, uint64_t sampleRate = 1);
+
+    /** Changes the number of heights per range. Intended to be called at startup, 
+     * before anything was recorded. */
+    void setRangeSize(uint64_t rangeSize);
+
+    /** Changes the number of unknown scripts kept and the sampling rate (1 keeps
+     * every unknown script). Intended to be called at startup. */
+    void setSampling(size_t sampleCapacity, uint64_t sampleRate);
+
+    /** Counts an output script of the given template in a block at the given height */
+    void record(ScriptTemplate type, uint64_t height);
+
+    /** Offers an unrecognized script to the sample. Does not count it in the ranges,
+     * use record() for that. */
+    void recordUnknown(const unsigned char* script, size_t scriptSize, int64_t height, const string& txHash, uint32_t index);
+
+    /** Returns the counts of all ranges in which anything was recorded, lowest first */
+    vector<RangeCounts> getRangeCounts() const;
+
+    /** Returns the sampled unknown scripts, oldest first */
+    vector<UnknownScript> getUnknownSamples();
+
+    /** Number of heights per range */
+    uint64_t getRangeSize() const;
+
+    /** Number of unknown scripts offered to the sample */
+    uint64_t getUnknownSeen() const;
+
+    /** Number of unknown scripts that were selected but not sampled because the sample 
+     * was being written or read at the same time */
+    uint64_t getUnknownDropped() const;
+
+    /** Returns the name of the template as used in the API (e.g. "pubKeyHash") */
+    static const char* templateName(ScriptTemplate type);
+
+private:
+    atomic<uint64_t> rangeSize;
+    atomic<uint64_t> counts[rangeCount][templateCount];
+
+    mutex sampleMutex;
+    vector<UnknownScript> samples;
+    size_t sampleCapacity;
+    size_t nextSample;
+    atomic<uint64_t> sampleRate;
+    atomic<uint64_t> unknownSeen;
+    atomic<uint64_t> unknownDropped;
+};
+
+}
+
+#endif // SCRIPTSTATISTICS_H_INCLUDED
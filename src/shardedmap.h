@@ -0,0 +1,147 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHARDEDMAP_H_INCLUDED
+#define SHARDEDMAP_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The ShardedMap class is a string keyed map split over a fixed number of shards,
+ * which copies share until they are modified. Copying the map only copies the shard
+ * pointers; the first change to a shard after that copies just that shard. This
+ * makes an update to a copy cost the size of the shards it touches rather than
+ * the size of the whole map.
+ *
+ * A map that has been copied from must not be modified anymore, only the copy.
+ */
+
+template <typename Value>
+class ShardedMap {
+public:
+    typedef unordered_map<string, Value> Shard;
+
+    ShardedMap() : shards(shardCount, make_shared<Shard>()), owned(shardCount, false), count(0) {}
+
+    /** Shares all shards with the source map */
+    ShardedMap(const ShardedMap& other) : shards(other.shards), owned(shardCount, false), count(other.count) {}
+
+    ShardedMap& operator=(const ShardedMap& other) {
+        shards = other.shards;
+        owned.assign(shardCount, false);
+        count = other.count;
+        return *this;
+    }
+
+    /** Returns the value for the key, or NULL if it is not in the map */
+    const Value* find(const string& key) const {
+        const Shard& shard = *shards[shardIndex(key)];
+        auto it = shard.find(key);
+        return it == shard.end() ? NULL : &it->second;
+    }
+
+    /** Returns the value for the key for modification, inserting a default value
+     * if it is not in the map */
+    Value& operator[](const string& key) {
+        Shard& shard = mutableShard(shardIndex(key));
+        auto inserted = shard.insert({ key, Value() });
+        if(inserted.second) count++;
+        return inserted.first->second;
+    }
+
+    /** Removes the key, returns false if it was not in the map */
+    bool erase(const string& key) {
+        size_t index = shardIndex(key);
+        if(shards[index]->find(key) == shards[index]->end()) return false;
+        mutableShard(index).erase(key);
+        count--;
+        return true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    /** Calls function(key, value, otherValue) for every key whose value differs from
+     * the one in the other map, with NULL for the side it is missing from. Shards
+     * both maps share are skipped, so comparing two versions of a map costs the
+     * size of the shards that changed in between. */
+    template <typename Function>
+    void forEachDifference(const ShardedMap& other, Function function) const {
+        for(size_t i = 0; i < shardCount; i++) {
+            if(shards[i] == other.shards[i]) continue;
+            for(const auto& kvp : *shards[i]) {
+                auto otherValue = other.shards[i]->find(kvp.first);
+                if(otherValue == other.shards[i]->end()) {
+                    function(kvp.first, &kvp.second, (const Value*)NULL);
+                } else if(!(otherValue->second == kvp.second)) {
+                    function(kvp.first, &kvp.second, &otherValue->second);
+                }
+            }
+            for(const auto& kvp : *other.shards[i]) {
+                if(shards[i]->find(kvp.first) == shards[i]->end()) {
+                    function(kvp.first, (const Value*)NULL, &kvp.second);
+                }
+            }
+        }
+    }
+
+    /** Calls function(key, value) for every entry */
+    template <typename Function>
+    void forEach(Function function) const {
+        for(const shared_ptr<Shard>& shard : shards) {
+            for(const auto& kvp : *shard) {
+                function(kvp.first, kvp.second);
+            }
+        }
+    }
+
+private:
+    static const size_t shardCount = 1024;
+
+    static size_t shardIndex(const string& key) {
+        // Skip the low bits, the unordered_map inside the shard buckets on those
+        return (hash<string>()(key) >> 16) % shardCount;
+    }
+
+    /** Copies the shard on its first change, after that it belongs to this map */
+    Shard& mutableShard(size_t index) {
+        if(!owned[index]) {
+            shards[index] = make_shared<Shard>(*shards[index]);
+            owned[index] = true;
+        }
+        return *shards[index];
+    }
+
+    vector<shared_ptr<Shard>> shards;
+    vector<bool> owned;
+    size_t count;
+};
+
+}
+
+#endif // SHARDEDMAP_H_INCLUDED
@@ -20,16 +20,24 @@
 */
 
 #include <openssl/sha.h>
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
 #include <iostream>
 #include <fstream>
 #include <memory>
 #include <iomanip>
 #include <vector>
+#include <algorithm>
+#include <mutex>
 #include <secp256k1.h>
 #include "crypto/ripemd160.h"
 #include "crypto/bech32.h"
 #include "coinparams.h"
+#include "hash256.h"
 #include <assert.h>     /* assert */
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -37,6 +45,7 @@ namespace
 {
     /* Global secp256k1_context object used for verification. */
     secp256k1_context* secp256k1_context_verify = NULL;
+    once_flag secp256k1_context_verify_once;
 
     typedef std::vector<uint8_t> data;
 
@@ -62,42 +71,247 @@ namespace
         }
         return true;
     }
+
+    const char* base58Alphabet = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+    const int8_t base58AlphabetReverse[128] = {
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+        -1, 0, 1, 2, 3, 4, 5, 6, 7, 8,-1,-1,-1,-1,-1,-1,
+        -1, 9,10,11,12,13,14,15,16,-1,17,18,19,20,21,-1,
+        22,23,24,25,26,27,28,29,30,31,32,-1,-1,-1,-1,-1,
+        -1,33,34,35,36,37,38,39,40,41,42,43,-1,44,45,46,
+        47,48,49,50,51,52,53,54,55,56,57,-1,-1,-1,-1,-1
+    };
+
+    // 58^5, the largest power of 58 for which a limb times 2^32 still fits in 64 bits
+    const uint64_t base58LimbBase = 656356768;
+    const size_t base58LimbDigits = 5;
+    const size_t stackLimbs = 64;
+
+    // The value the checksum of a bech32m (BIP350) string leaves, rather than 1 for bech32
+    const uint32_t bech32mConstant = 0x2bc830a3;
+
+    const char* bech32Charset = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+    const int8_t bech32CharsetReverse[128] = {
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        15, -1, 10, 17, 21, 20, 26, 30,  7,  5, -1, -1, -1, -1, -1, -1,
+        -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+         1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+        -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+         1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1
+    };
+
+    // Witness programs are at most 40 bytes, which is 64 groups of 5 bits
+    const size_t maxWitnessProgram = 40;
+    const size_t maxBech32Values = 1 + (maxWitnessProgram * 8 + 4) / 5;
+
+    /** The multiples of the bech32 generator k(x) for every value of c0, so the
+     * conditional XORs in PolyMod become a single table lookup */
+    struct Bech32Generator {
+        uint32_t multiples[32];
+
+        Bech32Generator() {
+            const uint32_t generator[5] = { 0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3 };
+            for(uint32_t c0 = 0; c0 < 32; c0++) {
+                multiples[c0] = 0;
+                for(int bit = 0; bit < 5; bit++) {
+                    if(c0 & (1 << bit)) multiples[c0] ^= generator[bit];
+                }
+            }
+        }
+    };
+
+    const Bech32Generator bech32Generator;
+
+    /** One step of the bech32 checksum (see PolyMod in crypto/bech32.cpp) */
+    inline uint32_t bech32PolyModStep(uint32_t c, uint8_t value) {
+        return (((c & 0x1ffffff) << 5) ^ value) ^ bech32Generator.multiples[c >> 25];
+    }
+
+    /** Feeds the expanded human readable part into the bech32 checksum. The hrp
+     * has to be lower case. */
+    uint32_t bech32PolyModHrp(const char* hrp, size_t size) {
+        uint32_t c = 1;
+        for(size_t i = 0; i < size; i++) {
+            c = bech32PolyModStep(c, (unsigned char)hrp[i] >> 5);
+        }
+        c = bech32PolyModStep(c, 0);
+        for(size_t i = 0; i < size; i++) {
+            c = bech32PolyModStep(c, (unsigned char)hrp[i] & 0x1f);
+        }
+        return c;
+    }
+
+    const char* hexDigits = "0123456789abcdef";
+
+    /** Lookup tables for the scalar hex codec: the two characters for every byte, and
+     * the value of every hex digit (-1 for other characters) */
+    struct HexTables {
+        char encode[256][2];
+        int8_t decode[256];
+
+        HexTables() {
+            for(int i = 0; i < 256; i++) {
+                encode[i][0] = hexDigits[i >> 4];
+                encode[i][1] = hexDigits[i & 15];
+                decode[i] = -1;
+            }
+            for(int i = 0; i < 10; i++) decode['0' + i] = i;
+            for(int i = 0; i < 6; i++) {
+                decode['a' + i] = 10 + i;
+                decode['A' + i] = 10 + i;
+            }
+        }
+    };
+
+    const HexTables hexTables;
+
+    void hexEncodeScalar(const unsigned char* in, size_t size, char* out) {
+        for(size_t i = 0; i < size; i++) {
+            out[i * 2] = hexTables.encode[in[i]][0];
+            out[i * 2 + 1] = hexTables.encode[in[i]][1];
+        }
+    }
+
+    void hexEncodeReverseScalar(const unsigned char* in, size_t size, char* out) {
+        for(size_t i = 0; i < size; i++) {
+            out[i * 2] = hexTables.encode[in[size - 1 - i]][0];
+            out[i * 2 + 1] = hexTables.encode[in[size - 1 - i]][1];
+        }
+    }
+
+    /** Decodes size bytes from 2 * size hex digits. Stops at the first invalid digit,
+     * returns the number of bytes decoded. */
+    size_t hexDecodeScalar(const char* in, size_t size, unsigned char* out) {
+        for(size_t i = 0; i < size; i++) {
+            int8_t high = hexTables.decode[(unsigned char)in[i * 2]];
+            int8_t low = hexTables.decode[(unsigned char)in[i * 2 + 1]];
+            if((high | low) < 0) return i;
+            out[i] = (unsigned char)((high << 4) | low);
+        }
+        return size;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    /** SSSE3 hex codec: 16 bytes per iteration, the nibbles are translated to
+     * digits with a byte shuffle on a table of the 16 digits */
+    __attribute__((target("ssse3")))
+    inline void hexEncodeBlockSsse3(__m128i bytes, char* out) {
+        const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hexDigits));
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(bytes, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(high, low));
+    }
+
+    __attribute__((target("ssse3")))
+    void hexEncodeSsse3(const unsigned char* in, size_t size, char* out) {
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16) {
+            hexEncodeBlockSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), out + i * 2);
+        }
+        hexEncodeScalar(in + i, size - i, out + i * 2);
+    }
+
+    __attribute__((target("ssse3")))
+    void hexEncodeReverseSsse3(const unsigned char* in, size_t size, char* out) {
+        const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        size_t i = 0;
+        for(; i + 16 <= size; i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + size - i - 16));
+            hexEncodeBlockSsse3(_mm_shuffle_epi8(bytes, reverse), out + i * 2);
+        }
+        hexEncodeReverseScalar(in, size - i, out + i * 2);
+    }
+
+    __attribute__((target("ssse3")))
+    size_t hexDecodeSsse3(const char* in, size_t size, unsigned char* out) {
+        const __m128i zero = _mm_set1_epi8('0' - 1);
+        const __m128i nine = _mm_set1_epi8('9' + 1);
+        const __m128i lowerA = _mm_set1_epi8('a' - 1);
+        const __m128i lowerF = _mm_set1_epi8('f' + 1);
+        const __m128i caseBit = _mm_set1_epi8(0x20);
+        const __m128i weights = _mm_set1_epi16(0x0110);
+
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8) {
+            __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+            __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(chars, zero), _mm_cmplt_epi8(chars, nine));
+            __m128i lower = _mm_or_si128(chars, caseBit);
+            __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, lowerA), _mm_cmplt_epi8(lower, lowerF));
+            if(_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xffff) {
+                break;
+            }
+
+            // '0'-'9' -> 0-9, 'a'-'f' -> 10-15, then combine the digit pairs as high * 16 + low
+            __m128i values = _mm_or_si128(
+                _mm_and_si128(isDigit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+            __m128i pairs = _mm_maddubs_epi16(values, weights);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(pairs, pairs));
+        }
+        return i + hexDecodeScalar(in + i * 2, size - i, out + i);
+    }
+#endif
+
+    /** Picks the fastest hex codec the CPU supports, once at startup */
+    struct HexCodec {
+        void (*encode)(const unsigned char*, size_t, char*);
+        void (*encodeReverse)(const unsigned char*, size_t, char*);
+        size_t (*decode)(const char*, size_t, unsigned char*);
+
+        HexCodec() : encode(hexEncodeScalar), encodeReverse(hexEncodeReverseScalar), decode(hexDecodeScalar) {
+#if defined(__x86_64__) || defined(__i386__)
+            if(__builtin_cpu_supports("ssse3")) {
+                encode = hexEncodeSsse3;
+                encodeReverse = hexEncodeReverseSsse3;
+                decode = hexDecodeSsse3;
+            }
+#endif
+        }
+    };
+
+    const HexCodec hexCodec;
 }
 
-vector<unsigned char> VtcBlockIndexer::Utility::sha256(vector<unsigned char> input)
+vector<unsigned char> VtcBlockIndexer::Utility::sha256(const vector<unsigned char>& input)
 {
-    unique_ptr<unsigned char> hash(new unsigned char [SHA256_DIGEST_LENGTH]);
+    vector<unsigned char> hash(VtcBlockIndexer::Hash256::outputSize);
+    VtcBlockIndexer::Hash256::sha256(input.data(), input.size(), hash.data());
+    return hash;
+}
 
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, &input[0], input.size());
-    SHA256_Final(hash.get(), &sha256);
-    return vector<unsigned char>(hash.get(), hash.get()+SHA256_DIGEST_LENGTH);
+std::string VtcBlockIndexer::Utility::hashToHex(const vector<unsigned char>& hash) {
+    return hashToHex(hash.data(), hash.size());
 }
 
-std::string VtcBlockIndexer::Utility::hashToHex(vector<unsigned char> hash) {
-    stringstream ss;
-    for(uint i = 0; i < hash.size(); i++)
-    {
-        ss << hex << setw(2) << setfill('0') << (int)hash.at(i);
-    }
-    return ss.str();
+std::string VtcBlockIndexer::Utility::hashToHex(const unsigned char* hash, size_t size) {
+    std::string str(size * 2, '0');
+    hexCodec.encode(hash, size, &str[0]);
+    return str;
 }
 
-std::string VtcBlockIndexer::Utility::hashToReverseHex(vector<unsigned char> hash) {
-    if(hash.size() == 0) return "";
-    stringstream ss;
-    for(uint i = hash.size(); i-- > 0;)
-    {
-        ss << hex << setw(2) << setfill('0') << (int)hash.at(i);
-    }
-    return ss.str();
+std::string VtcBlockIndexer::Utility::hashToReverseHex(const vector<unsigned char>& hash) {
+    return hashToReverseHex(hash.data(), hash.size());
+}
+
+std::string VtcBlockIndexer::Utility::hashToReverseHex(const unsigned char* hash, size_t size) {
+    std::string str(size * 2, '0');
+    hexCodec.encodeReverse(hash, size, &str[0]);
+    return str;
 }
 
 void VtcBlockIndexer::Utility::initECCContextIfNeeded() {
-    if(secp256k1_context_verify == NULL) {
+    // Called from the HTTP worker threads concurrently, so only the first call creates it
+    call_once(secp256k1_context_verify_once, []() {
         secp256k1_context_verify = secp256k1_context_create(SECP256K1_FLAGS_TYPE_CONTEXT | SECP256K1_FLAGS_BIT_CONTEXT_VERIFY);
-    }
+    });
 }
 
 VtcBlockIndexer::Utility::~Utility() {
@@ -124,6 +338,42 @@ vector<unsigned char> VtcBlockIndexer::Utility::decompressPubKey(vector<unsigned
 }     
 
 
+bool VtcBlockIndexer::Utility::deriveChildPubKey(const vector<unsigned char>& pubKey, const vector<unsigned char>& chainCode, uint32_t index, vector<unsigned char>& childPubKey, vector<unsigned char>& childChainCode) {
+    if((index & 0x80000000) != 0 || pubKey.size() != 33 || chainCode.size() != 32) {
+        return false;
+    }
+
+    initECCContextIfNeeded();
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, pubKey.data(), 33)) {
+        return false;
+    }
+
+    // I = HMAC-SHA512(chain code, parent key || index), the left half tweaks the key
+    unsigned char data[37];
+    copy(pubKey.begin(), pubKey.end(), data);
+    data[33] = (index >> 24) & 0xff;
+    data[34] = (index >> 16) & 0xff;
+    data[35] = (index >> 8) & 0xff;
+    data[36] = index & 0xff;
+    unsigned char digest[64];
+    unsigned int digestSize = sizeof(digest);
+    if(HMAC(EVP_sha512(), chainCode.data(), 32, data, sizeof(data), digest, &digestSize) == NULL) {
+        return false;
+    }
+
+    // Fails if the tweak is not below the curve order or the result is infinity
+    if (!secp256k1_ec_pubkey_tweak_add(secp256k1_context_verify, &pubkey, digest)) {
+        return false;
+    }
+
+    childPubKey.resize(33);
+    size_t publen = 33;
+    secp256k1_ec_pubkey_serialize(secp256k1_context_verify, childPubKey.data(), &publen, &pubkey, SECP256K1_EC_COMPRESSED);
+    childChainCode.assign(digest + 32, digest + 64);
+    return true;
+}
+
 string VtcBlockIndexer::Utility::publicKeyToAddress(vector<unsigned char> publicKey) {
     vector<unsigned char> hashedKey = sha256(publicKey);    
     vector<unsigned char> ripeMD = ripeMD160(hashedKey);
@@ -131,32 +381,57 @@ string VtcBlockIndexer::Utility::publicKeyToAddress(vector<unsigned char> public
     return ripeMD160ToP2PKAddress(ripeMD);
 }
 
-string VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(vector<unsigned char> ripeMD) {
-    return ripeMD160ToAddress(VtcBlockIndexer::CoinParams::p2pkhVersion, ripeMD);
+string VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(const vector<unsigned char>& ripeMD) {
+    return ripeMD160ToAddress(VtcBlockIndexer::CoinParams::p2pkhVersion, ripeMD.data(), ripeMD.size());
+}
+
+string VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(const unsigned char* ripeMD, size_t size) {
+    return ripeMD160ToAddress(VtcBlockIndexer::CoinParams::p2pkhVersion, ripeMD, size);
+}
+string VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(const vector<unsigned char>& ripeMD) {
+    return ripeMD160ToAddress(VtcBlockIndexer::CoinParams::p2shVersion, ripeMD.data(), ripeMD.size());
 }
-string VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(vector<unsigned char> ripeMD) {
-    return ripeMD160ToAddress(VtcBlockIndexer::CoinParams::p2shVersion, ripeMD);
+
+string VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(const unsigned char* ripeMD, size_t size) {
+    return ripeMD160ToAddress(VtcBlockIndexer::CoinParams::p2shVersion, ripeMD, size);
 }
 
-string VtcBlockIndexer::Utility::ripeMD160ToAddress(unsigned char versionByte, vector<unsigned char> ripeMD) {
-    ripeMD.insert(ripeMD.begin(), versionByte);
-    vector<unsigned char> doubleHashedRipeMD = sha256(sha256(ripeMD));
-    for(int i = 0; i < 4; i++) {
-        ripeMD.push_back(doubleHashedRipeMD.at(i));
+string VtcBlockIndexer::Utility::ripeMD160ToAddress(unsigned char versionByte, const unsigned char* ripeMD, size_t ripeMDSize) {
+    // Version byte, hash and 4 byte checksum. Hashes are 20 bytes, larger input is
+    // only handled for completeness.
+    unsigned char stackPayload[64];
+    vector<unsigned char> heapPayload;
+    unsigned char* payload = stackPayload;
+    size_t size = ripeMDSize + 5;
+    if(size > sizeof(stackPayload)) {
+        heapPayload.resize(size);
+        payload = heapPayload.data();
     }
-   
-    string returnValue = base58(ripeMD);
-    return returnValue;
 
+    payload[0] = versionByte;
+    copy(ripeMD, ripeMD + ripeMDSize, payload + 1);
+
+    unsigned char checksum[SHA256_DIGEST_LENGTH];
+    VtcBlockIndexer::Hash256::hash(payload, ripeMDSize + 1, checksum);
+    copy(checksum, checksum + 4, payload + ripeMDSize + 1);
+
+    return base58(payload, size);
 }
 
-vector<unsigned char> VtcBlockIndexer::Utility::hexToBytes(const std::string hex) {
-    vector<unsigned char> bytes;
+vector<unsigned char> VtcBlockIndexer::Utility::hexToBytes(const std::string& hex) {
+    size_t pairs = hex.length() / 2;
+    vector<unsigned char> bytes((hex.length() + 1) / 2);
   
-    for (unsigned int i = 0; i < hex.length(); i += 2) {
-      string byteString = hex.substr(i, 2);
-      unsigned char byte = (unsigned char) strtol(byteString.c_str(), NULL, 16);
-      bytes.push_back(byte);
+    size_t i = 0;
+    while (i < bytes.size()) {
+      i += hexCodec.decode(hex.data() + i * 2, pairs - i, bytes.data() + i);
+
+      // Invalid characters and a trailing single digit keep the strtol semantics
+      if (i < bytes.size()) {
+        string byteString = hex.substr(i * 2, 2);
+        bytes[i] = (unsigned char) strtol(byteString.c_str(), NULL, 16);
+        i++;
+      }
     }
   
     return bytes;
@@ -168,61 +443,302 @@ vector<unsigned char> VtcBlockIndexer::Utility::ripeMD160(vector<unsigned char>
     return vector<unsigned char>(hash, hash + CRIPEMD160::OUTPUT_SIZE);
 }
 
-static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+std::string VtcBlockIndexer::Utility::base58(const vector<unsigned char>& in) {
+    return base58(in.data(), in.size());
+}
 
-std::string VtcBlockIndexer::Utility::base58(vector<unsigned char> in)
+std::string VtcBlockIndexer::Utility::base58(const unsigned char* in, size_t size)
 {
-    unsigned char* pbegin = &in[0];
-    unsigned char* pend = &in[0] + in.size();
-
-    // Skip & count leading zeroes.
-    int zeroes = 0;
-    int length = 0;
-    while (pbegin != pend && *pbegin == 0) {
-        pbegin++;
+    // Skip & count leading zeroes, they are encoded as '1'
+    size_t zeroes = 0;
+    while(zeroes < size && in[zeroes] == 0) {
         zeroes++;
     }
 
+    // The number is kept in limbs of 5 base58 digits (base 58^5, little endian). A limb 
+    // holds over 29 bits, so (size * 8 / 29) + 2 limbs are always enough.
+    size_t maxLimbs = (size - zeroes) * 8 / 29 + 2;
+    uint32_t limbStorage[stackLimbs];
+    vector<uint32_t> heapLimbs;
+    uint32_t* limbs = limbStorage;
+    if(maxLimbs > stackLimbs) {
+        heapLimbs.resize(maxLimbs);
+        limbs = heapLimbs.data();
+    }
+    size_t limbCount = 0;
+
+    // Apply "number = number * 256^n + next n bytes", up to 4 bytes at a time
+    for(size_t pos = zeroes; pos < size;) {
+        size_t chunk = min<size_t>(4, size - pos);
+        uint64_t multiplier = 1ULL << (8 * chunk);
+        uint64_t carry = 0;
+        for(size_t i = 0; i < chunk; i++) {
+            carry = (carry << 8) | in[pos + i];
+        }
+        pos += chunk;
+
+        for(size_t i = 0; i < limbCount; i++) {
+            uint64_t value = limbs[i] * multiplier + carry;
+            limbs[i] = (uint32_t)(value % base58LimbBase);
+            carry = value / base58LimbBase;
+        }
+        while(carry != 0) {
+            assert(limbCount < maxLimbs);
+            limbs[limbCount++] = (uint32_t)(carry % base58LimbBase);
+            carry /= base58LimbBase;
+        }
+    }
+
+    // All limbs except the most significant one are exactly 5 digits
+    size_t digits = 0;
+    if(limbCount > 0) {
+        digits = (limbCount - 1) * base58LimbDigits;
+        for(uint32_t top = limbs[limbCount - 1]; top != 0; top /= 58) {
+            digits++;
+        }
+    }
 
-    // Allocate enough space in big-endian base58 representation.
-    int size = (in.size()-zeroes) * 138 / 100 + 1; // log(256) / log(58), rounded up.
-
-    std::vector<unsigned char> b58(size);
-    // Process the bytes.
-    while (pbegin != pend) {
-        int carry = *pbegin;
-        int i = 0;
-        // Apply "b58 = b58 * 256 + ch".
-        for (std::vector<unsigned char>::reverse_iterator it = b58.rbegin(); (carry != 0 || i < length) && (it != b58.rend()); it++, i++) {
-            carry += 256 * (*it);
-            *it = carry % 58;
-            carry /= 58;
-        }
-
-        assert(carry == 0);
-        length = i;
-        pbegin++;
-    }
-    // Skip leading zeroes in base58 result.
-    std::vector<unsigned char>::iterator it = b58.begin() + (size - length);
-    while (it != b58.end() && *it == 0)
-        it++;
-    // Translate the result into a string.
-    std::string str;
-    str.reserve(zeroes + (b58.end() - it));
-    str.assign(zeroes, '1');
-    while (it != b58.end())
-        str += pszBase58[*(it++)];
+    std::string str(zeroes + digits, '1');
+    size_t out = str.size();
+    for(size_t i = 0; i < limbCount; i++) {
+        uint32_t limb = limbs[i];
+        if(i + 1 < limbCount) {
+            for(size_t d = 0; d < base58LimbDigits; d++) {
+                str[--out] = base58Alphabet[limb % 58];
+                limb /= 58;
+            }
+        } else {
+            for(; limb != 0; limb /= 58) {
+                str[--out] = base58Alphabet[limb % 58];
+            }
+        }
+    }
     return str;
 }
 
-string VtcBlockIndexer::Utility::bech32Address(vector<unsigned char> in) {
-    vector<unsigned char> enc;
-    enc.push_back(0); // witness version
-    if(convertbits<8, 5, true>(enc, in)) {
-        return bech32::Encode(VtcBlockIndexer::CoinParams::bech32Prefix, enc);
+bool VtcBlockIndexer::Utility::base58Decode(const string& in, vector<unsigned char>& out) {
+    // Leading '1's are leading zero bytes
+    size_t zeroes = 0;
+    while(zeroes < in.size() && in[zeroes] == '1') {
+        zeroes++;
     }
-    else{
-        return "";
+
+    // The number is kept in 32 bit limbs (little endian). Every digit adds less than 6 bits.
+    size_t maxLimbs = (in.size() - zeroes) * 6 / 32 + 2;
+    uint32_t limbStorage[stackLimbs];
+    vector<uint32_t> heapLimbs;
+    uint32_t* limbs = limbStorage;
+    if(maxLimbs > stackLimbs) {
+        heapLimbs.resize(maxLimbs);
+        limbs = heapLimbs.data();
     }
+    size_t limbCount = 0;
+
+    // Apply "number = number * 58^n + next n digits", up to 5 digits at a time
+    for(size_t pos = zeroes; pos < in.size();) {
+        size_t chunk = min<size_t>(base58LimbDigits, in.size() - pos);
+        uint64_t multiplier = 1;
+        uint64_t carry = 0;
+        for(size_t i = 0; i < chunk; i++) {
+            unsigned char c = in[pos + i];
+            int8_t digit = (c < 128) ? base58AlphabetReverse[c] : -1;
+            if(digit < 0) return false;
+            carry = carry * 58 + digit;
+            multiplier *= 58;
+        }
+        pos += chunk;
+
+        for(size_t i = 0; i < limbCount; i++) {
+            uint64_t value = limbs[i] * multiplier + carry;
+            limbs[i] = (uint32_t)value;
+            carry = value >> 32;
+        }
+        while(carry != 0) {
+            assert(limbCount < maxLimbs);
+            limbs[limbCount++] = (uint32_t)carry;
+            carry >>= 32;
+        }
+    }
+
+    // Write the limbs big endian, skipping the leading zero bytes of the top limb
+    out.assign(zeroes, 0);
+    bool significant = false;
+    for(size_t i = limbCount; i-- > 0;) {
+        for(int shift = 24; shift >= 0; shift -= 8) {
+            unsigned char byte = (unsigned char)(limbs[i] >> shift);
+            if(byte != 0) significant = true;
+            if(significant) out.push_back(byte);
+        }
+    }
+    return true;
+}
+
+bool VtcBlockIndexer::Utility::base58CheckDecode(const string& in, vector<unsigned char>& payload) {
+    vector<unsigned char> decoded;
+    if(!base58Decode(in, decoded) || decoded.size() < 4) {
+        return false;
+    }
+
+    unsigned char checksum[SHA256_DIGEST_LENGTH];
+    VtcBlockIndexer::Hash256::hash(decoded.data(), decoded.size() - 4, checksum);
+    if(!equal(checksum, checksum + 4, decoded.end() - 4)) {
+        return false;
+    }
+
+    payload.assign(decoded.begin(), decoded.end() - 4);
+    return true;
+}
+
+vector<unsigned char> VtcBlockIndexer::Utility::addressToScript(const string& address) {
+    vector<unsigned char> payload;
+    if(base58CheckDecode(address, payload) && payload.size() == 21) {
+        if(payload[0] == VtcBlockIndexer::CoinParams::p2pkhVersion) {
+            // OP_DUP OP_HASH160 <hash> OP_EQUALVERIFY OP_CHECKSIG
+            vector<unsigned char> script = { 0x76, 0xa9, 0x14 };
+            script.insert(script.end(), payload.begin() + 1, payload.end());
+            script.push_back(0x88);
+            script.push_back(0xac);
+            return script;
+        } else if(payload[0] == VtcBlockIndexer::CoinParams::p2shVersion) {
+            // OP_HASH160 <hash> OP_EQUAL
+            vector<unsigned char> script = { 0xa9, 0x14 };
+            script.insert(script.end(), payload.begin() + 1, payload.end());
+            script.push_back(0x87);
+            return script;
+        }
+        return {};
+    }
+
+    unsigned char witnessVersion;
+    vector<unsigned char> program;
+    if(bech32Decode(address, witnessVersion, program)) {
+        // OP_0 or OP_1..OP_16, followed by a push of the program
+        vector<unsigned char> script = { (unsigned char)(witnessVersion == 0 ? 0x00 : 0x50 + witnessVersion), (unsigned char)program.size() };
+        script.insert(script.end(), program.begin(), program.end());
+        return script;
+    }
+    return {};
+}
+
+string VtcBlockIndexer::Utility::scriptHash(const vector<unsigned char>& script) {
+    unsigned char hash[VtcBlockIndexer::Hash256::outputSize];
+    VtcBlockIndexer::Hash256::sha256(script.data(), script.size(), hash);
+    return hashToReverseHex(hash, sizeof(hash));
+}
+
+string VtcBlockIndexer::Utility::bech32Address(const vector<unsigned char>& in) {
+    return bech32Address(in.data(), in.size());
+}
+
+string VtcBlockIndexer::Utility::bech32Address(const unsigned char* in, size_t size) {
+    if(size > maxWitnessProgram) {
+        vector<unsigned char> enc;
+        enc.push_back(0); // witness version
+        if(convertbits<8, 5, true>(enc, vector<unsigned char>(in, in + size))) {
+            return bech32::Encode(VtcBlockIndexer::CoinParams::bech32Prefix, enc);
+        }
+        else{
+            return "";
+        }
+    }
+
+    // Witness version followed by the program in groups of 5 bits
+    uint8_t values[maxBech32Values];
+    size_t valueCount = 0;
+    values[valueCount++] = 0; // witness version
+    uint32_t acc = 0;
+    int bits = 0;
+    for(size_t i = 0; i < size; i++) {
+        acc = (acc << 8) | in[i];
+        bits += 8;
+        while(bits >= 5) {
+            bits -= 5;
+            values[valueCount++] = (acc >> bits) & 31;
+        }
+    }
+    if(bits) {
+        values[valueCount++] = (acc << (5 - bits)) & 31;
+    }
+
+    const string& hrp = VtcBlockIndexer::CoinParams::bech32Prefix;
+    uint32_t c = bech32PolyModHrp(hrp.data(), hrp.size());
+    for(size_t i = 0; i < valueCount; i++) {
+        c = bech32PolyModStep(c, values[i]);
+    }
+    for(size_t i = 0; i < 6; i++) {
+        c = bech32PolyModStep(c, 0);
+    }
+    c ^= 1;
+
+    string ret(hrp.size() + 1 + valueCount + 6, '1');
+    copy(hrp.begin(), hrp.end(), ret.begin());
+    size_t pos = hrp.size() + 1;
+    for(size_t i = 0; i < valueCount; i++) {
+        ret[pos++] = bech32Charset[values[i]];
+    }
+    for(size_t i = 0; i < 6; i++) {
+        ret[pos++] = bech32Charset[(c >> (5 * (5 - i))) & 31];
+    }
+    return ret;
+}
+
+bool VtcBlockIndexer::Utility::bech32Decode(const string& address, unsigned char& witnessVersion, vector<unsigned char>& program) {
+    const string& prefix = VtcBlockIndexer::CoinParams::bech32Prefix;
+    size_t separator = address.rfind('1');
+    if(address.size() > 90 || separator == string::npos || separator != prefix.size() || separator + 7 > address.size()) {
+        return false;
+    }
+
+    // Lower or upper case, but not mixed
+    bool lower = false, upper = false;
+    for(unsigned char c : address) {
+        if(c < 33 || c > 126) return false;
+        if(c >= 'a' && c <= 'z') lower = true;
+        if(c >= 'A' && c <= 'Z') upper = true;
+    }
+    if(lower && upper) return false;
+
+    char hrp[90];
+    for(size_t i = 0; i < separator; i++) {
+        unsigned char c = address[i];
+        hrp[i] = (c >= 'A' && c <= 'Z') ? (c - 'A') + 'a' : c;
+        if(hrp[i] != prefix[i]) return false;
+    }
+
+    uint8_t values[90];
+    size_t valueCount = address.size() - separator - 1;
+    uint32_t c = bech32PolyModHrp(hrp, separator);
+    for(size_t i = 0; i < valueCount; i++) {
+        int8_t value = bech32CharsetReverse[(unsigned char)address[separator + 1 + i]];
+        if(value < 0) return false;
+        values[i] = value;
+        c = bech32PolyModStep(c, value);
+    }
+
+    // Strip the checksum, the first value is the witness version
+    valueCount -= 6;
+    if(valueCount < 1 || values[0] > 16) return false;
+
+    // Version 0 programs have a bech32 checksum, later versions a bech32m one (BIP350)
+    if(c != (values[0] == 0 ? 1 : bech32mConstant)) return false;
+    witnessVersion = values[0];
+
+    program.clear();
+    uint32_t acc = 0;
+    int bits = 0;
+    for(size_t i = 1; i < valueCount; i++) {
+        acc = ((acc << 5) | values[i]) & 0xfff;
+        bits += 5;
+        if(bits >= 8) {
+            bits -= 8;
+            program.push_back((acc >> bits) & 0xff);
+        }
+    }
+    if(bits >= 5 || ((acc << (8 - bits)) & 0xff)) {
+        return false;
+    }
+
+    if(program.size() < 2 || program.size() > maxWitnessProgram) return false;
+    if(witnessVersion == 0 && program.size() != 20 && program.size() != 32) return false;
+    return true;
 }
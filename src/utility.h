@@ -20,6 +20,7 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 using namespace std;
 
@@ -35,21 +36,81 @@ namespace VtcBlockIndexer {
              * 
              * @param input the value to hash
              */
-            static vector<unsigned char> sha256(vector<unsigned char> input);
-            static string hashToHex(vector<unsigned char> hash);
-            static string hashToReverseHex(vector<unsigned char> hash);
+            static vector<unsigned char> sha256(const vector<unsigned char>& input);
+            /** Hex encodes the input, byte by byte (hashToHex) or starting at the last
+             * byte (hashToReverseHex, as hashes are displayed)
+             */
+            static string hashToHex(const vector<unsigned char>& hash);
+            static string hashToHex(const unsigned char* hash, size_t size);
+            static string hashToReverseHex(const vector<unsigned char>& hash);
+            static string hashToReverseHex(const unsigned char* hash, size_t size);
             static vector<unsigned char> decompressPubKey(vector<unsigned char> compressedKey);
             static string publicKeyToAddress(vector<unsigned char> publicKey);
             static vector<unsigned char> ripeMD160(vector<unsigned char> in);
-            static string base58(vector<unsigned char> in);
-            static string ripeMD160ToP2PKAddress(vector<unsigned char> ripeMD);
-            static string ripeMD160ToP2SHAddress(vector<unsigned char> ripeMD);
-            static string bech32Address(vector<unsigned char> in);
-            static vector<unsigned char> hexToBytes(string hex);
+            static string base58(const vector<unsigned char>& in);
+            static string base58(const unsigned char* in, size_t size);
+            static string ripeMD160ToP2PKAddress(const vector<unsigned char>& ripeMD);
+            static string ripeMD160ToP2PKAddress(const unsigned char* ripeMD, size_t size);
+            static string ripeMD160ToP2SHAddress(const vector<unsigned char>& ripeMD);
+            static string ripeMD160ToP2SHAddress(const unsigned char* ripeMD, size_t size);
+            static string bech32Address(const vector<unsigned char>& in);
+            static string bech32Address(const unsigned char* in, size_t size);
+
+            /** Decodes a base58 string. Returns false if it contains invalid characters
+             * 
+             * @param in the base58 encoded string
+             * @param out receives the decoded bytes
+             */
+            static bool base58Decode(const string& in, vector<unsigned char>& out);
+
+            /** Decodes a base58check string (i.e. an address) and verifies its checksum.
+             * Returns false if the string is not valid base58 or the checksum does not match
+             * 
+             * @param in the base58check encoded string
+             * @param payload receives the decoded bytes, without the checksum
+             */
+            static bool base58CheckDecode(const string& in, vector<unsigned char>& payload);
+
+            /** Decodes a segwit address with the coin's bech32 prefix. Returns false if the
+             * address is not valid bech32 (bech32m for witness versions 1 and up), has a 
+             * different prefix or an invalid witness program
+             * 
+             * @param address the bech32 address
+             * @param witnessVersion receives the witness version
+             * @param program receives the witness program
+             */
+            static bool bech32Decode(const string& address, unsigned char& witnessVersion, vector<unsigned char>& program);
+            static vector<unsigned char> hexToBytes(const string& hex);
+
+            /** Returns the output script that pays to an address (P2PKH, P2SH or a segwit
+             * program), or an empty vector if the address is not valid for the coin
+             * 
+             * @param address the base58check or bech32 address
+             */
+            static vector<unsigned char> addressToScript(const string& address);
+
+            /** Returns the Electrum script hash of an output script: the SHA-256 of the
+             * script, hex encoded in reverse byte order
+             * 
+             * @param script the output script
+             */
+            static string scriptHash(const vector<unsigned char>& script);
+
+            /** Derives the public key and chain code of a non-hardened child of an
+             * extended public key (BIP32 CKDpub). Returns false for a hardened index,
+             * an invalid parent key or, very rarely, an index that has no valid child
+             * 
+             * @param pubKey the compressed (33 byte) parent public key
+             * @param chainCode the 32 byte parent chain code
+             * @param index the child index, below 2^31
+             * @param childPubKey receives the compressed child public key
+             * @param childChainCode receives the child chain code
+             */
+            static bool deriveChildPubKey(const vector<unsigned char>& pubKey, const vector<unsigned char>& chainCode, uint32_t index, vector<unsigned char>& childPubKey, vector<unsigned char>& childChainCode);
             ~Utility();
             
         private:
-            static string ripeMD160ToAddress(unsigned char versionByte, vector<unsigned char> ripeMD);
+            static string ripeMD160ToAddress(unsigned char versionByte, const unsigned char* ripeMD, size_t ripeMDSize);
             static void initECCContextIfNeeded();
             Utility() {}
     };
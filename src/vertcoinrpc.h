@@ -2,16 +2,92 @@
 #define VERTCOINRPC_INCLUDED_
 
 #include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 #include <jsonrpccpp/client.h>
 
 namespace VtcBlockIndexer {
     class VertcoinClient : public jsonrpc::Client {
         public:
+            /** The maximum number of calls that are sent in a single batch request */
+            static const size_t maxBatchSize = 10000;
+
             VertcoinClient(jsonrpc::IClientConnector &conn,
                            jsonrpc::clientVersion_t type 
                            = jsonrpc::JSONRPC_CLIENT_V1) : 
-                           jsonrpc::Client(conn, type) {}
+                           jsonrpc::Client(conn, type), connector(conn) {}
+
+            /** Calls method once for every entry in params using JSON-RPC batch requests, so 
+             * many calls share a single HTTP round trip. Returns the results in the order 
+             * of params, with a null value for the calls that returned an error.
+             */
+            std::vector<Json::Value> callBatch(const std::string& method, const std::vector<Json::Value>& params)
+            throw (jsonrpc::JsonRpcException) {
+                std::vector<Json::Value> results(params.size());
+                Json::StreamWriterBuilder writerBuilder;
+                writerBuilder["indentation"] = "";
+                Json::CharReaderBuilder readerBuilder;
+
+                for(size_t batchStart = 0; batchStart < params.size(); batchStart += maxBatchSize) {
+                    size_t batchEnd = std::min(params.size(), batchStart + maxBatchSize);
+                    Json::Value batch(Json::arrayValue);
+                    for(size_t i = batchStart; i < batchEnd; i++) {
+                        Json::Value call;
+                        call["jsonrpc"] = "2.0";
+                        call["id"] = (Json::UInt64)i;
+                        call["method"] = method;
+                        call["params"] = params[i];
+                        batch.append(call);
+                    }
+
+                    std::string response;
+                    connector.SendRPCMessage(Json::writeString(writerBuilder, batch), response);
+
+                    Json::Value responses;
+                    std::string errors;
+                    std::istringstream responseStream(response);
+                    if(!Json::parseFromStream(readerBuilder, responseStream, &responses, &errors) || !responses.isArray()) {
+                        throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, response);
+                    }
+
+                    for(const Json::Value& reply : responses) {
+                        if(!reply.isObject() || !reply["id"].isIntegral()) continue;
+                        Json::UInt64 id = reply["id"].asUInt64();
+                        if(id < batchStart || id >= batchEnd) continue;
+                        if(reply["error"].isNull()) {
+                            results[id] = reply["result"];
+                        }
+                    }
+                }
+                return results;
+            }
+
+            /** Fetches the raw (hex) transactions for all ids using batch requests. 
+             * Transactions the node does not know are left out of the result.
+             */
+            std::unordered_map<std::string, std::string> getrawtransactions(const std::vector<std::string>& ids)
+            throw (jsonrpc::JsonRpcException) {
+                std::vector<Json::Value> params;
+                for(const std::string& id : ids) {
+                    Json::Value p;
+                    p.append(id);
+                    p.append(false);
+                    params.push_back(p);
+                }
+
+                std::vector<Json::Value> results = callBatch("getrawtransaction", params);
+                std::unordered_map<std::string, std::string> rawTransactions;
+                for(size_t i = 0; i < ids.size(); i++) {
+                    if(results[i].isString()) {
+                        rawTransactions[ids[i]] = results[i].asString();
+                    }
+                }
+                return rawTransactions;
+            }
                                      
             Json::Value getrawtransaction(const std::string& id, const bool verbose) 
             throw (jsonrpc::JsonRpcException) {
@@ -90,6 +166,9 @@ namespace VtcBlockIndexer {
                                                     result.toStyledString());
                 }
             }
+
+        private:
+            jsonrpc::IClientConnector& connector;
     };
 }
 
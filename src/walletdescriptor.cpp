@@ -0,0 +1,197 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "walletdescriptor.h"
+#include "utility.h"
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    // Extended keys are 78 bytes: version, depth, parent fingerprint, child number, chain code and key
+    const size_t extendedKeySize = 78;
+
+    // Version bytes of the SLIP-132 extended public keys that imply a segwit script
+    const uint32_t ypubVersion = 0x049d7cb2;
+    const uint32_t upubVersion = 0x044a5262;
+    const uint32_t zpubVersion = 0x04b24746;
+    const uint32_t vpubVersion = 0x045f1cf6;
+
+    bool unwrap(const string& input, const string& function, string& inner) {
+        if(input.size() > function.size() + 2 && input.compare(0, function.size() + 1, function + "(") == 0 && input.back() == ')') {
+            inner = input.substr(function.size() + 1, input.size() - function.size() - 2);
+            return true;
+        }
+        return false;
+    }
+}
+
+VtcBlockIndexer::WalletDescriptor::WalletDescriptor(ScriptType scriptType, const vector<unsigned char>& pubKey, const vector<unsigned char>& chainCode, const string& path) {
+    this->scriptType = scriptType;
+    this->pubKey = pubKey;
+    this->chainCode = chainCode;
+    this->path = path;
+}
+
+bool VtcBlockIndexer::WalletDescriptor::parse(const string& input, vector<WalletDescriptor>& branches, string& error) {
+    string descriptor = input.substr(0, input.find('#'));
+    descriptor.erase(remove_if(descriptor.begin(), descriptor.end(), ::isspace), descriptor.end());
+
+    string inner, key;
+    if(unwrap(descriptor, "sh", inner)) {
+        if(!unwrap(inner, "wpkh", key)) {
+            error = "Only sh(wpkh(KEY)) is supported";
+            return false;
+        }
+        return parseKey(key, ScriptHashWitnessPubKeyHash, false, branches, error);
+    } else if(unwrap(descriptor, "wpkh", key)) {
+        return parseKey(key, WitnessPubKeyHash, false, branches, error);
+    } else if(unwrap(descriptor, "pkh", key)) {
+        return parseKey(key, PubKeyHash, false, branches, error);
+    } else if(descriptor.find('(') != string::npos) {
+        error = "Only pkh(KEY), wpkh(KEY) and sh(wpkh(KEY)) descriptors are supported";
+        return false;
+    }
+    return parseKey(descriptor, PubKeyHash, true, branches, error);
+}
+
+bool VtcBlockIndexer::WalletDescriptor::parseKey(const string& key, ScriptType scriptType, bool scriptTypeFromVersion, vector<WalletDescriptor>& branches, string& error) {
+    // The key origin only tells where the key came from, it does not change the addresses
+    string expression = key;
+    if(!expression.empty() && expression[0] == '[') {
+        size_t originEnd = expression.find(']');
+        if(originEnd == string::npos) {
+            error = "Unterminated key origin";
+            return false;
+        }
+        expression = expression.substr(originEnd + 1);
+    }
+
+    vector<string> elements;
+    stringstream ss(expression);
+    string element;
+    while(getline(ss, element, '/')) {
+        elements.push_back(element);
+    }
+    if(elements.empty()) {
+        error = "Missing extended public key";
+        return false;
+    }
+
+    vector<unsigned char> extendedKey;
+    if(!VtcBlockIndexer::Utility::base58CheckDecode(elements[0], extendedKey) || extendedKey.size() != extendedKeySize) {
+        error = "Invalid extended public key";
+        return false;
+    }
+    if(extendedKey[45] != 0x02 && extendedKey[45] != 0x03) {
+        error = "Expected an extended public key, not a private key";
+        return false;
+    }
+
+    if(scriptTypeFromVersion) {
+        uint32_t version = ((uint32_t)extendedKey[0] << 24) | ((uint32_t)extendedKey[1] << 16) | ((uint32_t)extendedKey[2] << 8) | extendedKey[3];
+        if(version == ypubVersion || version == upubVersion) {
+            scriptType = ScriptHashWitnessPubKeyHash;
+        } else if(version == zpubVersion || version == vpubVersion) {
+            scriptType = WitnessPubKeyHash;
+        }
+    }
+
+    vector<unsigned char> chainCode(extendedKey.begin() + 13, extendedKey.begin() + 45);
+    vector<unsigned char> pubKey(extendedKey.begin() + 45, extendedKey.end());
+
+    // A bare key is scanned like a wallet account: its receive and change branches
+    if(elements.size() == 1) {
+        if(!scriptTypeFromVersion) {
+            error = "The key of a descriptor must end in /*";
+            return false;
+        }
+        for(uint32_t change = 0; change <= 1; change++) {
+            vector<unsigned char> branchKey, branchChainCode;
+            if(!VtcBlockIndexer::Utility::deriveChildPubKey(pubKey, chainCode, change, branchKey, branchChainCode)) {
+                error = "The key has no valid branch " + std::to_string(change);
+                return false;
+            }
+            branches.push_back(WalletDescriptor(scriptType, branchKey, branchChainCode, std::to_string(change) + "/*"));
+        }
+        return true;
+    }
+
+    if(elements.back() != "*") {
+        error = "The key must end in /*";
+        return false;
+    }
+
+    string path;
+    for(size_t i = 1; i < elements.size() - 1; i++) {
+        const string& step = elements[i];
+        if(!step.empty() && (step.back() == '\'' || step.back() == 'h' || step.back() == 'H')) {
+            error = "Hardened derivation needs the private key";
+            return false;
+        }
+        if(step.empty() || step.size() > 10 || !all_of(step.begin(), step.end(), ::isdigit) || stoull(step) >= 0x80000000ULL) {
+            error = "Invalid derivation step '" + step + "'";
+            return false;
+        }
+
+        vector<unsigned char> childKey, childChainCode;
+        if(!VtcBlockIndexer::Utility::deriveChildPubKey(pubKey, chainCode, (uint32_t)stoul(step), childKey, childChainCode)) {
+            error = "The key has no valid child at step '" + step + "'";
+            return false;
+        }
+        pubKey = childKey;
+        chainCode = childChainCode;
+        path += step + "/";
+    }
+
+    branches.push_back(WalletDescriptor(scriptType, pubKey, chainCode, path + "*"));
+    return true;
+}
+
+string VtcBlockIndexer::WalletDescriptor::deriveAddress(uint32_t index) const {
+    vector<unsigned char> childKey, childChainCode;
+    if(!VtcBlockIndexer::Utility::deriveChildPubKey(pubKey, chainCode, index, childKey, childChainCode)) {
+        return "";
+    }
+
+    vector<unsigned char> keyHash = VtcBlockIndexer::Utility::ripeMD160(VtcBlockIndexer::Utility::sha256(childKey));
+    switch(scriptType) {
+        case WitnessPubKeyHash:
+            return VtcBlockIndexer::Utility::bech32Address(keyHash);
+        case ScriptHashWitnessPubKeyHash: {
+            // The redeem script is the witness program: OP_0 PUSH20 <key hash>
+            vector<unsigned char> redeemScript = { 0x00, 0x14 };
+            redeemScript.insert(redeemScript.end(), keyHash.begin(), keyHash.end());
+            return VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(VtcBlockIndexer::Utility::ripeMD160(VtcBlockIndexer::Utility::sha256(redeemScript)));
+        }
+        default:
+            return VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(keyHash);
+    }
+}
+
+string VtcBlockIndexer::WalletDescriptor::getPath() const {
+    return path;
+}
+
+VtcBlockIndexer::WalletDescriptor::ScriptType VtcBlockIndexer::WalletDescriptor::getScriptType() const {
+    return scriptType;
+}
@@ -0,0 +1,83 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WALLETDESCRIPTOR_H_INCLUDED
+#define WALLETDESCRIPTOR_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+namespace VtcBlockIndexer {
+
+/**
+ * The WalletDescriptor class describes one branch of addresses of a wallet: an 
+ * extended public key, the unhardened path below it and the script the derived 
+ * keys are used in. It derives the address at any index of that branch, so the
+ * index can be searched for the addresses a wallet has used.
+ */
+
+class WalletDescriptor {
+public:
+    /** The scripts the derived public keys can be used in */
+    enum ScriptType { PubKeyHash, ScriptHashWitnessPubKeyHash, WitnessPubKeyHash };
+
+    /** Parses an extended public key or a descriptor into the branches to scan. Returns
+     * false if the input is not understood, with the reason in error.
+     * 
+     * A bare extended public key gives its receive (0) and change (1) branches, with
+     * the script type following from its version bytes (xpub, ypub or zpub). A descriptor 
+     * gives the one branch it describes; pkh(KEY), wpkh(KEY) and sh(wpkh(KEY)) are 
+     * supported, where KEY is an extended public key with an optional key origin, an 
+     * optional unhardened path and a final wildcard step. A trailing checksum is ignored.
+     * 
+     * @param input the extended public key or descriptor
+     * @param branches receives the branches
+     * @param error receives the reason the input was rejected
+     */
+    static bool parse(const string& input, vector<WalletDescriptor>& branches, string& error);
+
+    /** Derives the address at the given index of the branch. Returns an empty string
+     * if the index has no valid key, which BIP32 wallets skip.
+     * 
+     * @param index the child index, below 2^31
+     */
+    string deriveAddress(uint32_t index) const;
+
+    /** The path of the branch below the extended public key, with a * for the index */
+    string getPath() const;
+
+    ScriptType getScriptType() const;
+
+private:
+    WalletDescriptor(ScriptType scriptType, const vector<unsigned char>& pubKey, const vector<unsigned char>& chainCode, const string& path);
+    static bool parseKey(const string& key, ScriptType scriptType, bool scriptTypeFromVersion, vector<WalletDescriptor>& branches, string& error);
+
+    ScriptType scriptType;
+    vector<unsigned char> pubKey;
+    vector<unsigned char> chainCode;
+    string path;
+};
+
+}
+
+#endif // WALLETDESCRIPTOR_H_INCLUDED
@@ -0,0 +1,579 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*  blockgen - Writes a synthetic chain as blk?????.dat files, in the format the
+    node stores them, so indexing throughput can be measured without a node.
+
+    The mix of output templates, the share of segwit transactions, duplicate 
+    blocks and stale forks are configurable. The chain is deterministic for a
+    given seed. A summary (blockgen.json) is written next to the block files.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+#include <sys/stat.h>
+#include "../src/coinparams.h"
+#include "../src/utility.h"
+#include "../src/hash256.h"
+#include "../src/json.hpp"
+#include "../src/cxxopts.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    typedef array<unsigned char, 32> Hash;
+
+    enum OutputType { PubKeyHash, ScriptHash, WitnessPubKeyHash, MultiSig, NullData, OutputTypeCount };
+    const char* outputTypeNames[] = { "p2pkh", "p2sh", "p2wpkh", "multisig", "nulldata" };
+
+    mt19937_64 rng;
+
+    /** A sample of the addresses and outpoints in the main chain, to replay wallet
+     * traffic against the index with (see loadgen) */
+    struct Workload {
+        size_t capacity = 0;
+        uint64_t addressesSeen = 0;
+        uint64_t outpointsSeen = 0;
+        vector<string> addresses;
+        vector<pair<string, uint32_t>> outpoints;
+
+        // Separate from rng, so the sample size does not change the chain
+        mt19937_64 sampler;
+
+        template<typename T>
+        void sample(vector<T>& samples, uint64_t& seen, const T& value) {
+            // Reservoir sampling, every value has the same chance to end up in the sample
+            seen++;
+            if(samples.size() < capacity) {
+                samples.push_back(value);
+            } else if(capacity > 0) {
+                uint64_t pick = sampler() % seen;
+                if(pick < capacity) samples[pick] = value;
+            }
+        }
+    } workload;
+
+    void writeUint32(vector<unsigned char>& out, uint32_t value) {
+        for(int i = 0; i < 4; i++) out.push_back((value >> (8 * i)) & 0xff);
+    }
+
+    void writeUint64(vector<unsigned char>& out, uint64_t value) {
+        for(int i = 0; i < 8; i++) out.push_back((value >> (8 * i)) & 0xff);
+    }
+
+    void writeVarInt(vector<unsigned char>& out, uint64_t value) {
+        if(value < 0xfd) {
+            out.push_back(value);
+        } else if(value <= 0xffff) {
+            out.push_back(0xfd);
+            out.push_back(value & 0xff);
+            out.push_back(value >> 8);
+        } else {
+            out.push_back(0xfe);
+            writeUint32(out, value);
+        }
+    }
+
+    void writeBytes(vector<unsigned char>& out, const unsigned char* data, size_t size) {
+        out.insert(out.end(), data, data + size);
+    }
+
+    void writeString(vector<unsigned char>& out, const vector<unsigned char>& value) {
+        writeVarInt(out, value.size());
+        writeBytes(out, value.data(), value.size());
+    }
+
+    vector<unsigned char> randomBytes(size_t size) {
+        vector<unsigned char> value(size);
+        for(auto& b : value) b = rng();
+        return value;
+    }
+
+    Hash hash256(const vector<unsigned char>& data) {
+        Hash hash;
+        VtcBlockIndexer::Hash256::hash(data.data(), data.size(), hash.data());
+        return hash;
+    }
+
+    /** Draws the hashes and keys of output scripts from a fixed set of "wallets", 
+     * so addresses are reused like on a real chain */
+    class AddressPool {
+    public:
+        AddressPool(size_t size) {
+            for(size_t i = 0; i < size; i++) {
+                vector<unsigned char> key = randomBytes(33);
+                key[0] = 0x02 + (rng() & 1);
+                keys.push_back(key);
+            }
+        }
+
+        // Skewed towards the start of the pool, a few addresses get most outputs
+        const vector<unsigned char>& key() {
+            double x = uniform_real_distribution<double>(0, 1)(rng);
+            return keys[(size_t)(x * x * x * keys.size()) % keys.size()];
+        }
+
+        /** Returns an output script of the given type. Sets address to the address it
+         * pays to, or leaves it empty for multisig and OP_RETURN outputs. */
+        vector<unsigned char> script(OutputType type, string* address = NULL) {
+            vector<unsigned char> script;
+            const vector<unsigned char>& hashSource = key();
+            switch(type) {
+                case PubKeyHash:
+                    script = { 0x76, 0xa9, 0x14 };
+                    script.insert(script.end(), hashSource.begin() + 1, hashSource.begin() + 21);
+                    script.insert(script.end(), { 0x88, 0xac });
+                    if(address != NULL) *address = VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(vector<unsigned char>(hashSource.begin() + 1, hashSource.begin() + 21));
+                    break;
+                case ScriptHash:
+                    script = { 0xa9, 0x14 };
+                    script.insert(script.end(), hashSource.begin() + 13, hashSource.begin() + 33);
+                    script.push_back(0x87);
+                    if(address != NULL) *address = VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(vector<unsigned char>(hashSource.begin() + 13, hashSource.begin() + 33));
+                    break;
+                case WitnessPubKeyHash:
+                    script = { 0x00, 0x14 };
+                    script.insert(script.end(), hashSource.begin() + 7, hashSource.begin() + 27);
+                    if(address != NULL) *address = VtcBlockIndexer::Utility::bech32Address(&hashSource[7], 20);
+                    break;
+                case MultiSig: {
+                    // 1-of-2 or 2-of-3 bare multisig
+                    int keyCount = 2 + (rng() & 1);
+                    script.push_back(0x50 + keyCount - 1);
+                    for(int i = 0; i < keyCount; i++) {
+                        script.push_back(33);
+                        const vector<unsigned char>& publicKey = key();
+                        script.insert(script.end(), publicKey.begin(), publicKey.end());
+                    }
+                    script.push_back(0x50 + keyCount);
+                    script.push_back(0xae);
+                    break;
+                }
+                default: {
+                    vector<unsigned char> data = randomBytes(1 + rng() % 40);
+                    script = { 0x6a, (unsigned char)data.size() };
+                    script.insert(script.end(), data.begin(), data.end());
+                    break;
+                }
+            }
+            return script;
+        }
+
+    private:
+        vector<vector<unsigned char>> keys;
+    };
+
+    struct Outpoint {
+        Hash txid;
+        uint32_t index;
+    };
+
+    struct Settings {
+        uint32_t txPerBlock;
+        uint32_t maxInputs;
+        uint32_t maxOutputs;
+        double segwitShare;
+        double mix[OutputTypeCount];
+    };
+
+    struct Transaction {
+        vector<unsigned char> raw;
+        Hash txid;
+        bool segwit;
+        size_t outputs;
+    };
+
+    /** Serializes a transaction. Non-witness and full serialization are built together
+     * so the txid can be calculated. */
+    Transaction makeTransaction(const vector<Outpoint>& inputs, const vector<vector<unsigned char>>& scriptSigs, const vector<vector<unsigned char>>& outputs, bool segwit, bool coinbase) {
+        vector<unsigned char> inputsOutputs;
+        writeVarInt(inputsOutputs, inputs.size());
+        for(size_t i = 0; i < inputs.size(); i++) {
+            writeBytes(inputsOutputs, inputs[i].txid.data(), 32);
+            writeUint32(inputsOutputs, inputs[i].index);
+            writeString(inputsOutputs, scriptSigs[i]);
+            writeUint32(inputsOutputs, 0xffffffff);
+        }
+        writeVarInt(inputsOutputs, outputs.size());
+        for(const vector<unsigned char>& script : outputs) {
+            writeUint64(inputsOutputs, script[0] == 0x6a ? 0 : 1000 + rng() % 100000000);
+            writeString(inputsOutputs, script);
+        }
+
+        vector<unsigned char> stripped;
+        writeUint32(stripped, segwit ? 2 : 1);
+        stripped.insert(stripped.end(), inputsOutputs.begin(), inputsOutputs.end());
+        writeUint32(stripped, 0);
+
+        Transaction tx;
+        tx.txid = hash256(stripped);
+        tx.segwit = segwit;
+        tx.outputs = outputs.size();
+        if(!segwit) {
+            tx.raw = stripped;
+            return tx;
+        }
+
+        writeUint32(tx.raw, 2);
+        tx.raw.insert(tx.raw.end(), { 0x00, 0x01 });
+        tx.raw.insert(tx.raw.end(), inputsOutputs.begin(), inputsOutputs.end());
+        for(size_t i = 0; i < inputs.size(); i++) {
+            if(coinbase) {
+                // Witness reserved value
+                writeVarInt(tx.raw, 1);
+                writeString(tx.raw, vector<unsigned char>(32, 0));
+            } else {
+                writeVarInt(tx.raw, 2);
+                writeString(tx.raw, randomBytes(71 + (rng() & 1)));
+                writeString(tx.raw, randomBytes(33));
+            }
+        }
+        writeUint32(tx.raw, 0);
+        return tx;
+    }
+
+    /** Builds the transactions of a block, spending from (and adding to) the set of 
+     * unspent outputs */
+    vector<Transaction> makeTransactions(uint32_t height, const Settings& settings, AddressPool& addresses, vector<Outpoint>& unspent, bool spend) {
+        vector<Transaction> transactions;
+        uint32_t txCount = settings.txPerBlock == 0 ? 0 : rng() % (2 * settings.txPerBlock);
+        bool anySegwit = false;
+        discrete_distribution<int> outputType(settings.mix, settings.mix + OutputTypeCount);
+
+        for(uint32_t t = 0; t < txCount; t++) {
+            bool segwit = uniform_real_distribution<double>(0, 1)(rng) < settings.segwitShare;
+            anySegwit |= segwit;
+
+            vector<Outpoint> inputs;
+            vector<vector<unsigned char>> scriptSigs;
+            uint32_t inputCount = 1 + rng() % settings.maxInputs;
+            for(uint32_t i = 0; i < inputCount; i++) {
+                if(spend && !unspent.empty()) {
+                    size_t pick = rng() % unspent.size();
+                    inputs.push_back(unspent[pick]);
+                    unspent[pick] = unspent.back();
+                    unspent.pop_back();
+                } else {
+                    Outpoint outpoint;
+                    vector<unsigned char> txid = randomBytes(32);
+                    copy(txid.begin(), txid.end(), outpoint.txid.begin());
+                    outpoint.index = rng() % 4;
+                    inputs.push_back(outpoint);
+                }
+                if(segwit) {
+                    scriptSigs.push_back({});
+                } else {
+                    vector<unsigned char> scriptSig = { 71 };
+                    vector<unsigned char> signature = randomBytes(71);
+                    scriptSig.insert(scriptSig.end(), signature.begin(), signature.end());
+                    scriptSig.push_back(33);
+                    const vector<unsigned char>& key = addresses.key();
+                    scriptSig.insert(scriptSig.end(), key.begin(), key.end());
+                    scriptSigs.push_back(scriptSig);
+                }
+            }
+
+            vector<vector<unsigned char>> outputs;
+            vector<string> outputAddresses(1 + rng() % settings.maxOutputs);
+            for(string& address : outputAddresses) {
+                outputs.push_back(addresses.script((OutputType)outputType(rng), &address));
+            }
+
+            transactions.push_back(makeTransaction(inputs, scriptSigs, outputs, segwit, false));
+            if(spend) {
+                string txid = VtcBlockIndexer::Utility::hashToReverseHex(transactions.back().txid.data(), 32);
+                for(uint32_t o = 0; o < outputs.size(); o++) {
+                    if(outputs[o][0] != 0x6a) unspent.push_back({ transactions.back().txid, o });
+                    if(!outputAddresses[o].empty()) workload.sample(workload.addresses, workload.addressesSeen, outputAddresses[o]);
+                    workload.sample(workload.outpoints, workload.outpointsSeen, make_pair(txid, o));
+                }
+            }
+        }
+
+        // Coinbase, with the height (BIP34) so every coinbase has a unique txid
+        vector<unsigned char> scriptSig = { 0x04 };
+        writeUint32(scriptSig, height);
+        vector<unsigned char> extraNonce = randomBytes(8);
+        scriptSig.insert(scriptSig.end(), extraNonce.begin(), extraNonce.end());
+        vector<vector<unsigned char>> outputs = { addresses.script(PubKeyHash) };
+        if(anySegwit) {
+            vector<unsigned char> commitment = { 0x6a, 0x24, 0xaa, 0x21, 0xa9, 0xed };
+            vector<unsigned char> commitmentHash = randomBytes(32);
+            commitment.insert(commitment.end(), commitmentHash.begin(), commitmentHash.end());
+            outputs.push_back(commitment);
+        }
+        Outpoint coinbaseInput = { Hash(), 0xffffffff };
+        coinbaseInput.txid.fill(0);
+        Transaction coinbase = makeTransaction({ coinbaseInput }, { scriptSig }, outputs, anySegwit, true);
+        if(spend) unspent.push_back({ coinbase.txid, 0 });
+        transactions.insert(transactions.begin(), coinbase);
+
+        return transactions;
+    }
+
+    Hash merkleRoot(const vector<Transaction>& transactions) {
+        vector<Hash> level;
+        for(const Transaction& tx : transactions) level.push_back(tx.txid);
+        while(level.size() > 1) {
+            if(level.size() % 2) level.push_back(level.back());
+            vector<Hash> next;
+            for(size_t i = 0; i < level.size(); i += 2) {
+                vector<unsigned char> pair(level[i].begin(), level[i].end());
+                pair.insert(pair.end(), level[i + 1].begin(), level[i + 1].end());
+                next.push_back(hash256(pair));
+            }
+            level = next;
+        }
+        return level[0];
+    }
+
+    struct Block {
+        vector<unsigned char> raw;
+        Hash hash;
+        size_t transactions;
+        size_t outputs;
+    };
+
+    Block makeBlock(const Hash& previousBlockHash, uint32_t height, const vector<Transaction>& transactions) {
+        Block block;
+        writeUint32(block.raw, 0x20000000);
+        writeBytes(block.raw, previousBlockHash.data(), 32);
+        Hash root = merkleRoot(transactions);
+        writeBytes(block.raw, root.data(), 32);
+        writeUint32(block.raw, 1500000000 + height * 150);
+        writeUint32(block.raw, 0x1e0ffff0);
+        writeUint32(block.raw, rng());
+
+        block.hash = hash256(block.raw);
+        writeVarInt(block.raw, transactions.size());
+        block.transactions = transactions.size();
+        block.outputs = 0;
+        for(const Transaction& tx : transactions) {
+            block.raw.insert(block.raw.end(), tx.raw.begin(), tx.raw.end());
+            block.outputs += tx.outputs;
+        }
+        return block;
+    }
+
+    /** Appends blocks to blk?????.dat files, starting a new file when the current
+     * one would grow beyond maxFileSize */
+    class BlockFileWriter {
+    public:
+        BlockFileWriter(const string& directory, size_t maxFileSize) : directory(directory), maxFileSize(maxFileSize), fileNumber(-1), fileSize(0), totalSize(0) {}
+
+        void write(const Block& block) {
+            size_t recordSize = 8 + block.raw.size();
+            if(fileNumber < 0 || fileSize + recordSize > maxFileSize) {
+                if(file.is_open()) file.close();
+                fileNumber++;
+                stringstream fileName;
+                fileName << directory << "/blk" << setw(5) << setfill('0') << fileNumber << ".dat";
+                file.open(fileName.str(), ios_base::out | ios_base::binary | ios_base::trunc);
+                if(!file.is_open()) {
+                    cerr << "Could not create " << fileName.str() << endl;
+                    exit(1);
+                }
+                fileSize = 0;
+            }
+
+            vector<unsigned char> header(VtcBlockIndexer::CoinParams::magic);
+            writeUint32(header, block.raw.size());
+            file.write(reinterpret_cast<const char*>(header.data()), header.size());
+            file.write(reinterpret_cast<const char*>(block.raw.data()), block.raw.size());
+            fileSize += recordSize;
+            totalSize += recordSize;
+        }
+
+        int files() const { return fileNumber + 1; }
+        uint64_t bytes() const { return totalSize; }
+
+    private:
+        string directory;
+        size_t maxFileSize;
+        int fileNumber;
+        size_t fileSize;
+        uint64_t totalSize;
+        ofstream file;
+    };
+
+    bool parseMix(const string& mix, double weights[OutputTypeCount]) {
+        fill(weights, weights + OutputTypeCount, 0.0);
+        stringstream ss(mix);
+        string item;
+        while(getline(ss, item, ',')) {
+            size_t equals = item.find('=');
+            if(equals == string::npos) return false;
+            string name = item.substr(0, equals);
+            auto type = find(outputTypeNames, outputTypeNames + OutputTypeCount, name);
+            if(type == outputTypeNames + OutputTypeCount) return false;
+            weights[type - outputTypeNames] = stod(item.substr(equals + 1));
+        }
+        return any_of(weights, weights + OutputTypeCount, [](double weight) { return weight > 0; });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("blockgen", "Synthetic block file generator");
+    options.add_options()
+    ("coinParams", "Coin parameters file, for the network magic", cxxopts::value<std::string>()->default_value("coins/vertcoin-mainnet.json"))
+    ("output", "Directory to write the block files to", cxxopts::value<std::string>())
+    ("blocks", "Number of blocks in the main chain [Default: 1000]", cxxopts::value<uint32_t>()->default_value("1000"))
+    ("txPerBlock", "Average number of transactions per block, besides the coinbase [Default: 50]", cxxopts::value<uint32_t>()->default_value("50"))
+    ("maxInputs", "Maximum number of inputs per transaction [Default: 3]", cxxopts::value<uint32_t>()->default_value("3"))
+    ("maxOutputs", "Maximum number of outputs per transaction [Default: 4]", cxxopts::value<uint32_t>()->default_value("4"))
+    ("mix", "Relative weights of the output templates [Default: p2pkh=45,p2sh=20,p2wpkh=30,multisig=2,nulldata=3]", cxxopts::value<std::string>()->default_value("p2pkh=45,p2sh=20,p2wpkh=30,multisig=2,nulldata=3"))
+    ("segwitShare", "Fraction of transactions with a witness [Default: 0.5]", cxxopts::value<double>()->default_value("0.5"))
+    ("addresses", "Number of distinct keys outputs are paid to [Default: 100000]", cxxopts::value<size_t>()->default_value("100000"))
+    ("duplicates", "Fraction of blocks that are written to the files a second time [Default: 0.01]", cxxopts::value<double>()->default_value("0.01"))
+    ("staleForks", "Number of stale forks (of one or two blocks) off the main chain [Default: 5]", cxxopts::value<uint32_t>()->default_value("5"))
+    ("maxFileSize", "Maximum size of a block file in MiB [Default: 128]", cxxopts::value<size_t>()->default_value("128"))
+    ("seed", "Seed of the random generator [Default: 1]", cxxopts::value<uint64_t>()->default_value("1"))
+    ("workload", "File to write a sample of the addresses and outpoints to, for loadgen", cxxopts::value<std::string>()->default_value(""))
+    ("workloadSize", "Number of addresses and outpoints in the workload sample [Default: 10000]", cxxopts::value<size_t>()->default_value("10000"))
+    ;
+    options.parse(argc, argv);
+
+    if(options.count("output") == 0) {
+        cerr << "Output directory not specified. Exiting." << endl;
+        return 1;
+    }
+    string outputDir = options["output"].as<string>();
+    mkdir(outputDir.c_str(), 0755);
+
+    VtcBlockIndexer::CoinParams::readFromFile(options["coinParams"].as<string>());
+    rng.seed(options["seed"].as<uint64_t>());
+
+    Settings settings;
+    settings.txPerBlock = options["txPerBlock"].as<uint32_t>();
+    settings.maxInputs = max<uint32_t>(options["maxInputs"].as<uint32_t>(), 1);
+    settings.maxOutputs = max<uint32_t>(options["maxOutputs"].as<uint32_t>(), 1);
+    settings.segwitShare = options["segwitShare"].as<double>();
+    if(!parseMix(options["mix"].as<string>(), settings.mix)) {
+        cerr << "Invalid mix, expected e.g. p2pkh=45,p2sh=20,p2wpkh=30,multisig=2,nulldata=3" << endl;
+        return 1;
+    }
+
+    workload.capacity = options["workloadSize"].as<size_t>();
+
+    uint32_t blockCount = max<uint32_t>(options["blocks"].as<uint32_t>(), 1);
+    double duplicateShare = options["duplicates"].as<double>();
+
+    // Forks start at random heights, leaving the main chain at least three blocks
+    // longer so it stays the longest chain
+    vector<uint32_t> forkHeights;
+    if(blockCount > 4) {
+        for(uint32_t i = 0; i < options["staleForks"].as<uint32_t>(); i++) {
+            forkHeights.push_back(1 + rng() % (blockCount - 4));
+        }
+    }
+
+    AddressPool addresses(max<size_t>(options["addresses"].as<size_t>(), 1));
+    BlockFileWriter writer(outputDir, options["maxFileSize"].as<size_t>() * 1024 * 1024);
+    vector<Outpoint> unspent;
+    vector<pair<uint32_t, Block>> pendingDuplicates;
+
+    Hash previousBlockHash;
+    previousBlockHash.fill(0);
+    uint64_t transactionCount = 0, outputCount = 0, mainChainBytes = 0;
+    uint32_t staleBlocks = 0, duplicateBlocks = 0;
+    string tip;
+
+    for(uint32_t height = 0; height < blockCount; height++) {
+        Block block = makeBlock(previousBlockHash, height, makeTransactions(height, settings, addresses, unspent, true));
+        writer.write(block);
+        transactionCount += block.transactions;
+        outputCount += block.outputs;
+        mainChainBytes += block.raw.size();
+
+        // Competing blocks at this height, that are not built on any further
+        for(uint32_t forkHeight : forkHeights) {
+            if(forkHeight != height) continue;
+            Hash forkPrevious = previousBlockHash;
+            uint32_t forkLength = 1 + rng() % 2;
+            for(uint32_t i = 0; i < forkLength; i++) {
+                Block stale = makeBlock(forkPrevious, height + i, makeTransactions(height + i, settings, addresses, unspent, false));
+                writer.write(stale);
+                forkPrevious = stale.hash;
+                staleBlocks++;
+            }
+        }
+
+        if(uniform_real_distribution<double>(0, 1)(rng) < duplicateShare) {
+            pendingDuplicates.push_back({ height + 1 + (uint32_t)(rng() % 10), block });
+        }
+        for(auto it = pendingDuplicates.begin(); it != pendingDuplicates.end();) {
+            if(it->first <= height) {
+                writer.write(it->second);
+                duplicateBlocks++;
+                it = pendingDuplicates.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        previousBlockHash = block.hash;
+        tip = VtcBlockIndexer::Utility::hashToReverseHex(block.hash.data(), block.hash.size());
+
+        if((height + 1) % 10000 == 0) {
+            cout << "Generated " << (height + 1) << " blocks" << endl;
+        }
+    }
+    for(const auto& duplicate : pendingDuplicates) {
+        writer.write(duplicate.second);
+        duplicateBlocks++;
+    }
+
+    json summary;
+    summary["blocks"] = blockCount;
+    summary["transactions"] = transactionCount;
+    summary["outputs"] = outputCount;
+    summary["mainChainBytes"] = mainChainBytes;
+    summary["staleBlocks"] = staleBlocks;
+    summary["duplicateBlocks"] = duplicateBlocks;
+    summary["files"] = writer.files();
+    summary["bytes"] = writer.bytes();
+    summary["tip"] = tip;
+    ofstream summaryFile(outputDir + "/blockgen.json");
+    summaryFile << summary.dump(2) << endl;
+
+    if(!options["workload"].as<string>().empty()) {
+        json j;
+        j["height"] = blockCount - 1;
+        j["addresses"] = workload.addresses;
+        j["outpoints"] = json::array();
+        for(const auto& outpoint : workload.outpoints) {
+            j["outpoints"].push_back({ { "txid", outpoint.first }, { "vout", outpoint.second } });
+        }
+        ofstream workloadFile(options["workload"].as<string>());
+        workloadFile << j.dump() << endl;
+    }
+
+    cout << "Wrote " << blockCount << " blocks (" << transactionCount << " transactions, " << staleBlocks << " stale, " 
+         << duplicateBlocks << " duplicate) in " << writer.files() << " files, " << writer.bytes() << " bytes. Tip is " << tip << endl;
+    return 0;
+}
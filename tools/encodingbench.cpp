@@ -0,0 +1,273 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*  encodingbench - Compares the address and hex encoders in Utility against the
+    reference implementations they replaced. Verifies the outputs match
+    byte for byte on random input and reports the time per call.
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <openssl/sha.h>
+#include "../src/utility.h"
+#include "../src/coinparams.h"
+#include "../src/crypto/bech32.h"
+#include "../src/cxxopts.hpp"
+
+using namespace std;
+
+namespace reference
+{
+    // The byte-at-a-time base58 encoder previously in Utility::base58
+    string base58(vector<unsigned char> in) {
+        static const char* pszBase58 = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+        unsigned char* pbegin = &in[0];
+        unsigned char* pend = &in[0] + in.size();
+        int zeroes = 0;
+        int length = 0;
+        while (pbegin != pend && *pbegin == 0) {
+            pbegin++;
+            zeroes++;
+        }
+        int size = (in.size()-zeroes) * 138 / 100 + 1;
+        vector<unsigned char> b58(size);
+        while (pbegin != pend) {
+            int carry = *pbegin;
+            int i = 0;
+            for (vector<unsigned char>::reverse_iterator it = b58.rbegin(); (carry != 0 || i < length) && (it != b58.rend()); it++, i++) {
+                carry += 256 * (*it);
+                *it = carry % 58;
+                carry /= 58;
+            }
+            length = i;
+            pbegin++;
+        }
+        vector<unsigned char>::iterator it = b58.begin() + (size - length);
+        while (it != b58.end() && *it == 0)
+            it++;
+        string str;
+        str.reserve(zeroes + (b58.end() - it));
+        str.assign(zeroes, '1');
+        while (it != b58.end())
+            str += pszBase58[*(it++)];
+        return str;
+    }
+
+    // Utility::sha256 as it was used by ripeMD160ToAddress
+    vector<unsigned char> sha256(vector<unsigned char> input) {
+        unique_ptr<unsigned char> hash(new unsigned char [SHA256_DIGEST_LENGTH]);
+        SHA256_CTX sha256;
+        SHA256_Init(&sha256);
+        SHA256_Update(&sha256, &input[0], input.size());
+        SHA256_Final(hash.get(), &sha256);
+        return vector<unsigned char>(hash.get(), hash.get()+SHA256_DIGEST_LENGTH);
+    }
+
+    // The vector based Utility::ripeMD160ToAddress
+    string ripeMD160ToAddress(unsigned char versionByte, vector<unsigned char> ripeMD) {
+        ripeMD.insert(ripeMD.begin(), versionByte);
+        vector<unsigned char> doubleHashedRipeMD = sha256(sha256(ripeMD));
+        for(int i = 0; i < 4; i++) {
+            ripeMD.push_back(doubleHashedRipeMD.at(i));
+        }
+        return base58(ripeMD);
+    }
+
+    // The stringstream based Utility::hashToReverseHex
+    string hashToReverseHex(const vector<unsigned char>& hash) {
+        stringstream ss;
+        for(size_t i = hash.size(); i-- > 0;) {
+            ss << hex << setw(2) << setfill('0') << (int)hash.at(i);
+        }
+        return ss.str();
+    }
+
+    // The substr + strtol based Utility::hexToBytes
+    vector<unsigned char> hexToBytes(const string& hex) {
+        vector<unsigned char> bytes;
+        for(size_t i = 0; i < hex.length(); i += 2) {
+            bytes.push_back((unsigned char)strtol(hex.substr(i, 2).c_str(), NULL, 16));
+        }
+        return bytes;
+    }
+
+    // The convertbits + bech32::Encode based Utility::bech32Address
+    string bech32Address(vector<unsigned char> in) {
+        vector<unsigned char> enc;
+        enc.push_back(0);
+        int acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < in.size(); ++i) {
+            acc = ((acc << 8) | in[i]) & 0xfff;
+            bits += 8;
+            while (bits >= 5) {
+                bits -= 5;
+                enc.push_back((acc >> bits) & 31);
+            }
+        }
+        if (bits) enc.push_back((acc << (5 - bits)) & 31);
+        return bech32::Encode(VtcBlockIndexer::CoinParams::bech32Prefix, enc);
+    }
+}
+
+double timeCalls(size_t iterations, function<void(size_t)> call) {
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < iterations; i++) {
+        call(i);
+    }
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return (double)elapsed / iterations;
+}
+
+void report(const string& name, double referenceNs, double currentNs) {
+    cout << name << ": reference " << referenceNs << " ns, current " << currentNs << " ns, speedup " << (referenceNs / currentNs) << "x" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("encodingbench", "Address encoder benchmark");
+    options.add_options()
+    ("iterations", "Number of calls to time per encoder", cxxopts::value<size_t>()->default_value("200000"))
+    ("bech32Prefix", "Bech32 human readable part", cxxopts::value<string>()->default_value("vtc"))
+    ;
+    options.parse(argc, argv);
+    size_t iterations = options["iterations"].as<size_t>();
+
+    VtcBlockIndexer::CoinParams::bech32Prefix = options["bech32Prefix"].as<string>();
+    VtcBlockIndexer::CoinParams::p2pkhVersion = 0x47;
+    VtcBlockIndexer::CoinParams::p2shVersion = 0x05;
+
+    // Random hashes and payloads, with a share of leading zero bytes
+    mt19937 rng(42);
+    vector<vector<unsigned char>> hashes20, hashes32, payloads;
+    for(size_t i = 0; i < 1024; i++) {
+        vector<unsigned char> h20(20), h32(32), p(1 + rng() % 100);
+        for(auto& b : h20) b = rng();
+        for(auto& b : h32) b = rng();
+        for(auto& b : p) b = rng();
+        for(size_t z = rng() % 8; z < p.size() && z < 3; z++) p[z] = 0;
+        hashes20.push_back(h20);
+        hashes32.push_back(h32);
+        payloads.push_back(p);
+    }
+    payloads.push_back({});
+    payloads.push_back({0, 0, 0});
+
+    // Verify outputs and decoders
+    size_t mismatches = 0;
+    for(const auto& p : payloads) {
+        string encoded = VtcBlockIndexer::Utility::base58(p);
+        vector<unsigned char> decoded;
+        if(encoded != reference::base58(p) || !VtcBlockIndexer::Utility::base58Decode(encoded, decoded) || decoded != p) {
+            mismatches++;
+        }
+    }
+    for(const auto& h : hashes20) {
+        string p2pkh = VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(h);
+        string p2sh = VtcBlockIndexer::Utility::ripeMD160ToP2SHAddress(h);
+        vector<unsigned char> payload;
+        if(p2pkh != reference::ripeMD160ToAddress(0x47, h) || p2sh != reference::ripeMD160ToAddress(0x05, h)
+            || !VtcBlockIndexer::Utility::base58CheckDecode(p2pkh, payload) || payload.size() != 21 
+            || payload[0] != 0x47 || !equal(h.begin(), h.end(), payload.begin() + 1)) {
+            mismatches++;
+        }
+        string corrupted = p2pkh;
+        corrupted[5] = (corrupted[5] == 'z') ? 'y' : 'z';
+        if(VtcBlockIndexer::Utility::base58CheckDecode(corrupted, payload)) {
+            mismatches++;
+        }
+    }
+    for(const auto* hashes : { &hashes20, &hashes32 }) {
+        for(const auto& h : *hashes) {
+            string address = VtcBlockIndexer::Utility::bech32Address(h);
+            unsigned char version;
+            vector<unsigned char> program;
+            if(address != reference::bech32Address(h) || !VtcBlockIndexer::Utility::bech32Decode(address, version, program) 
+                || version != 0 || program != h) {
+                mismatches++;
+            }
+        }
+    }
+    for(const auto& p : payloads) {
+        string hex = VtcBlockIndexer::Utility::hashToReverseHex(p);
+        if(hex != reference::hashToReverseHex(p) || VtcBlockIndexer::Utility::hexToBytes(hex) != reference::hexToBytes(hex)) {
+            mismatches++;
+        }
+    }
+    if(mismatches > 0) {
+        cerr << mismatches << " outputs differ from the reference implementation" << endl;
+        return 1;
+    }
+    cout << "All outputs match the reference implementation" << endl;
+
+    const size_t mask = 1023;
+    report("base58 (25 bytes)", 
+        timeCalls(iterations, [&](size_t i) { reference::ripeMD160ToAddress(0x47, hashes20[i & mask]); }),
+        timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(hashes20[i & mask]); }));
+
+    vector<vector<unsigned char>> xpubs;
+    for(size_t i = 0; i < 1024; i++) {
+        vector<unsigned char> p(82);
+        for(auto& b : p) b = rng();
+        xpubs.push_back(p);
+    }
+    report("base58 (82 bytes)", 
+        timeCalls(iterations, [&](size_t i) { reference::base58(xpubs[i & mask]); }),
+        timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::base58(xpubs[i & mask]); }));
+
+    report("bech32 (20 bytes)", 
+        timeCalls(iterations, [&](size_t i) { reference::bech32Address(hashes20[i & mask]); }),
+        timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::bech32Address(hashes20[i & mask]); }));
+
+    report("bech32 (32 bytes)", 
+        timeCalls(iterations, [&](size_t i) { reference::bech32Address(hashes32[i & mask]); }),
+        timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::bech32Address(hashes32[i & mask]); }));
+
+    report("hashToReverseHex (32 bytes)", 
+        timeCalls(iterations, [&](size_t i) { reference::hashToReverseHex(hashes32[i & mask]); }),
+        timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::hashToReverseHex(hashes32[i & mask]); }));
+
+    string rawTransaction = VtcBlockIndexer::Utility::hashToHex(vector<unsigned char>(hashes32[0].begin(), hashes32[0].end()));
+    while(rawTransaction.size() < 2 * 4096) rawTransaction += rawTransaction;
+    report("hexToBytes (4096 bytes)", 
+        timeCalls(iterations / 100 + 1, [&](size_t i) { reference::hexToBytes(rawTransaction); }),
+        timeCalls(iterations / 100 + 1, [&](size_t i) { VtcBlockIndexer::Utility::hexToBytes(rawTransaction); }));
+
+    vector<string> bech32Addresses;
+    for(const auto& h : hashes20) bech32Addresses.push_back(VtcBlockIndexer::Utility::bech32Address(h));
+    unsigned char version;
+    vector<unsigned char> program;
+    report("bech32 decode", 
+        timeCalls(iterations, [&](size_t i) { bech32::Decode(bech32Addresses[i & mask]); }),
+        timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::bech32Decode(bech32Addresses[i & mask], version, program); }));
+
+    vector<string> addresses;
+    for(const auto& h : hashes20) addresses.push_back(VtcBlockIndexer::Utility::ripeMD160ToP2PKAddress(h));
+    vector<unsigned char> payload;
+    cout << "base58check decode: " << timeCalls(iterations, [&](size_t i) { VtcBlockIndexer::Utility::base58CheckDecode(addresses[i & mask], payload); }) << " ns" << endl;
+
+    return 0;
+}
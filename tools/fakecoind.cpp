@@ -0,0 +1,379 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*  fakecoind - A stand-in for the coin daemon's JSON-RPC interface, serving
+    fixed data so the indexer's RPC paths can be exercised without a node.
+
+    Supports keep-alive connections and JSON-RPC batch requests for
+    getrawmempool, getrawtransaction, getblockcount and sendrawtransaction.
+    Optionally publishes new transactions over ZeroMQ like -zmqpubrawtx.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/sha.h>
+#include <zmq.h>
+#include "../src/json.hpp"
+#include "../src/cxxopts.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    mutex stateMutex;
+    unordered_map<string, string> transactions;
+    vector<string> mempool;
+    long long blockCount = 0;
+    bool verbose = false;
+    atomic<unsigned long long> requestCount(0);
+    atomic<unsigned long long> callCount(0);
+
+    // ZeroMQ publisher, NULL when not enabled
+    void* publisher = NULL;
+    mutex publisherMutex;
+    uint32_t rawTxSequence = 0;
+
+    string toHex(const unsigned char* data, size_t size, bool reverse) {
+        static const char* digits = "0123456789abcdef";
+        string hex(size * 2, '0');
+        for(size_t i = 0; i < size; i++) {
+            unsigned char byte = reverse ? data[size - 1 - i] : data[i];
+            hex[i * 2] = digits[byte >> 4];
+            hex[i * 2 + 1] = digits[byte & 0x0F];
+        }
+        return hex;
+    }
+
+    vector<unsigned char> fromHex(const string& hex) {
+        vector<unsigned char> bytes;
+        for(size_t i = 0; i + 1 < hex.size(); i += 2) {
+            bytes.push_back((unsigned char)strtol(hex.substr(i, 2).c_str(), NULL, 16));
+        }
+        return bytes;
+    }
+
+    // Returns the txid for a raw transaction. Only valid for non-segwit
+    // transactions, which is all the synthetic generator produces.
+    string txidFor(const vector<unsigned char>& rawTx) {
+        unsigned char hash[SHA256_DIGEST_LENGTH];
+        SHA256(rawTx.data(), rawTx.size(), hash);
+        SHA256(hash, SHA256_DIGEST_LENGTH, hash);
+        return toHex(hash, SHA256_DIGEST_LENGTH, true);
+    }
+
+    // Builds a simple one-in one-out P2PKH transaction that is unique for seed
+    vector<unsigned char> syntheticTransaction(uint32_t seed) {
+        unsigned char prevout[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<unsigned char*>(&seed), sizeof(seed), prevout);
+        unsigned char pubKeyHash[SHA256_DIGEST_LENGTH];
+        SHA256(prevout, sizeof(prevout), pubKeyHash);
+
+        vector<unsigned char> tx = {0x01, 0x00, 0x00, 0x00, 0x01};
+        tx.insert(tx.end(), prevout, prevout + sizeof(prevout));
+        tx.insert(tx.end(), {0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0x01});
+        uint64_t value = 100000 + seed;
+        for(int i = 0; i < 8; i++) tx.push_back((value >> (8 * i)) & 0xFF);
+        tx.insert(tx.end(), {0x19, 0x76, 0xa9, 0x14});
+        tx.insert(tx.end(), pubKeyHash, pubKeyHash + 20);
+        tx.insert(tx.end(), {0x88, 0xac, 0x00, 0x00, 0x00, 0x00});
+        return tx;
+    }
+
+    // Publishes a transaction the way the node does for -zmqpubrawtx: topic, 
+    // raw transaction and a little endian sequence number
+    void publishTransaction(const vector<unsigned char>& rawTx) {
+        if(publisher == NULL) return;
+        lock_guard<mutex> lock(publisherMutex);
+        unsigned char sequence[4];
+        for(int i = 0; i < 4; i++) sequence[i] = (rawTxSequence >> (8 * i)) & 0xFF;
+        rawTxSequence++;
+        zmq_send(publisher, "rawtx", 5, ZMQ_SNDMORE);
+        zmq_send(publisher, rawTx.data(), rawTx.size(), ZMQ_SNDMORE);
+        zmq_send(publisher, sequence, sizeof(sequence), 0);
+    }
+
+    // Adds a transaction to the mempool and announces it
+    string addToMempool(const vector<unsigned char>& rawTx, const string& rawTxHex) {
+        string txid = txidFor(rawTx);
+        {
+            lock_guard<mutex> lock(stateMutex);
+            if(transactions.find(txid) != transactions.end()) return txid;
+            transactions[txid] = rawTxHex;
+            mempool.push_back(txid);
+        }
+        publishTransaction(rawTx);
+        return txid;
+    }
+
+    // Adds a new synthetic transaction to the mempool every interval
+    void trickleTransactions(int perSecond, uint32_t firstSeed) {
+        uint32_t seed = firstSeed;
+        while(true) {
+            this_thread::sleep_for(chrono::microseconds(1000000 / perSecond));
+            vector<unsigned char> rawTx = syntheticTransaction(seed++);
+            addToMempool(rawTx, toHex(rawTx.data(), rawTx.size(), false));
+        }
+    }
+
+    void loadFixtures(const string& fileName) {
+        ifstream i(fileName);
+        json fixtures;
+        i >> fixtures;
+        
+        if(fixtures["blockcount"].is_number()) {
+            blockCount = fixtures["blockcount"].get<long long>();
+        }
+        if(fixtures["transactions"].is_object()) {
+            for(auto it = fixtures["transactions"].begin(); it != fixtures["transactions"].end(); ++it) {
+                transactions[it.key()] = it.value().get<string>();
+            }
+        }
+        if(fixtures["mempool"].is_array()) {
+            for(auto& txid : fixtures["mempool"]) {
+                mempool.push_back(txid.get<string>());
+            }
+        } else {
+            for(auto& kvp : transactions) {
+                mempool.push_back(kvp.first);
+            }
+        }
+    }
+
+    json rpcError(int code, const string& message) {
+        json error;
+        error["code"] = code;
+        error["message"] = message;
+        return error;
+    }
+
+    json handleCall(const json& call) {
+        callCount++;
+        json reply;
+        reply["id"] = call.count("id") ? call["id"] : json(nullptr);
+        reply["result"] = nullptr;
+        reply["error"] = nullptr;
+
+        const string method = call.value("method", "");
+        const json params = call.count("params") ? call["params"] : json::array();
+        
+        if(method == "sendrawtransaction" && params.size() > 0 && params[0].is_string()) {
+            vector<unsigned char> rawTx = fromHex(params[0].get<string>());
+            if(rawTx.size() < 10) {
+                reply["error"] = rpcError(-22, "TX decode failed");
+            } else {
+                reply["result"] = addToMempool(rawTx, params[0].get<string>());
+            }
+            return reply;
+        }
+
+        lock_guard<mutex> lock(stateMutex);
+        if(method == "getrawmempool") {
+            reply["result"] = mempool;
+        } else if(method == "getblockcount") {
+            reply["result"] = blockCount;
+        } else if(method == "getrawtransaction" && params.size() > 0 && params[0].is_string()) {
+            auto tx = transactions.find(params[0].get<string>());
+            bool verboseResult = params.size() > 1 && ((params[1].is_boolean() && params[1].get<bool>()) || (params[1].is_number() && params[1].get<int>() != 0));
+            if(tx == transactions.end()) {
+                reply["error"] = rpcError(-5, "No such mempool or blockchain transaction");
+            } else if(verboseResult) {
+                json result;
+                result["txid"] = tx->first;
+                result["hex"] = tx->second;
+                reply["result"] = result;
+            } else {
+                reply["result"] = tx->second;
+            }
+        } else {
+            reply["error"] = rpcError(-32601, "Method not found");
+        }
+        return reply;
+    }
+
+    // Handles the HTTP requests on a single (keep-alive) connection
+    void serveConnection(int fd) {
+        string buffer;
+        char chunk[16384];
+        while(true) {
+            size_t headerEnd;
+            while((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+                ssize_t bytesRead = recv(fd, chunk, sizeof(chunk), 0);
+                if(bytesRead <= 0) {
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, bytesRead);
+            }
+
+            size_t contentLength = 0;
+            bool keepAlive = true;
+            istringstream headers(buffer.substr(0, headerEnd));
+            string line;
+            getline(headers, line);
+            if(line.find("HTTP/1.0") != string::npos) keepAlive = false;
+            while(getline(headers, line)) {
+                if(!line.empty() && line.back() == '\r') line.pop_back();
+                size_t colon = line.find(':');
+                if(colon == string::npos) continue;
+                string name = line.substr(0, colon);
+                string value = line.substr(colon + 1);
+                value.erase(0, value.find_first_not_of(' '));
+                if(strcasecmp(name.c_str(), "Content-Length") == 0) contentLength = strtoul(value.c_str(), NULL, 10);
+                if(strcasecmp(name.c_str(), "Connection") == 0) keepAlive = (strcasecmp(value.c_str(), "close") != 0);
+            }
+
+            while(buffer.size() < headerEnd + 4 + contentLength) {
+                ssize_t bytesRead = recv(fd, chunk, sizeof(chunk), 0);
+                if(bytesRead <= 0) {
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, bytesRead);
+            }
+            string body = buffer.substr(headerEnd + 4, contentLength);
+            buffer.erase(0, headerEnd + 4 + contentLength);
+            requestCount++;
+
+            json response;
+            try {
+                json request = json::parse(body);
+                if(request.is_array()) {
+                    response = json::array();
+                    for(auto& call : request) {
+                        response.push_back(handleCall(call));
+                    }
+                } else {
+                    response = handleCall(request);
+                }
+                if(verbose) {
+                    cout << "Request with " << (request.is_array() ? request.size() : 1) << " call(s)" << endl;
+                }
+            } catch(const exception& e) {
+                response["id"] = nullptr;
+                response["result"] = nullptr;
+                response["error"] = rpcError(-32700, "Parse error");
+            }
+
+            string responseBody = response.dump();
+            stringstream reply;
+            reply << "HTTP/1.1 200 OK\r\n"
+                  << "Content-Type: application/json\r\n"
+                  << "Content-Length: " << responseBody.size() << "\r\n"
+                  << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n\r\n"
+                  << responseBody;
+            const string replyString = reply.str();
+            size_t sent = 0;
+            while(sent < replyString.size()) {
+                ssize_t bytesSent = send(fd, replyString.data() + sent, replyString.size() - sent, MSG_NOSIGNAL);
+                if(bytesSent <= 0) break;
+                sent += bytesSent;
+            }
+
+            if(!keepAlive || sent < replyString.size()) {
+                close(fd);
+                return;
+            }
+        }
+    }
+
+    void reportStatistics() {
+        while(true) {
+            this_thread::sleep_for(chrono::seconds(10));
+            cout << "Served " << callCount << " calls in " << requestCount << " HTTP requests" << endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("fakecoind", "JSON-RPC stand-in for the coin daemon");
+    
+    options.add_options()
+    ("fixtures", "JSON file with blockcount, transactions (txid to hex) and mempool (txids)", cxxopts::value<std::string>())
+    ("synthetic", "Number of synthetic transactions to add to the mempool [Default: 0]", cxxopts::value<int>()->default_value("0"))
+    ("port", "Port to listen on [Default: 8332]", cxxopts::value<int>()->default_value("8332"))
+    ("zmqpub", "Publish new transactions as rawtx on this ZeroMQ endpoint, e.g. tcp://*:28332", cxxopts::value<std::string>()->default_value(""))
+    ("trickle", "Number of new synthetic transactions per second added to the mempool [Default: 0]", cxxopts::value<int>()->default_value("0"))
+    ("verbose", "Log every request")
+    ;
+
+    options.parse(argc, argv);
+
+    if(options.count("fixtures") > 0) {
+        loadFixtures(options["fixtures"].as<string>());
+    }
+
+    for(int i = 0; i < options["synthetic"].as<int>(); i++) {
+        vector<unsigned char> rawTx = syntheticTransaction(i);
+        string txid = txidFor(rawTx);
+        transactions[txid] = toHex(rawTx.data(), rawTx.size(), false);
+        mempool.push_back(txid);
+    }
+    verbose = options.count("verbose") > 0;
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(options["port"].as<int>());
+    if(::bind(listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 128) != 0) {
+        cerr << "Could not listen on port " << options["port"].as<int>() << endl;
+        return -1;
+    }
+
+    if(!options["zmqpub"].as<string>().empty()) {
+        publisher = zmq_socket(zmq_ctx_new(), ZMQ_PUB);
+        if(zmq_bind(publisher, options["zmqpub"].as<string>().c_str()) != 0) {
+            cerr << "Could not bind " << options["zmqpub"].as<string>() << endl;
+            return -1;
+        }
+    }
+
+    if(options["trickle"].as<int>() > 0) {
+        thread(trickleTransactions, options["trickle"].as<int>(), (uint32_t)options["synthetic"].as<int>()).detach();
+    }
+
+    cout << "Serving " << transactions.size() << " transactions (" << mempool.size() << " in mempool) on port " << options["port"].as<int>() << endl;
+    thread(reportStatistics).detach();
+
+    while(true) {
+        int fd = accept(listenFd, NULL, NULL);
+        if(fd < 0) continue;
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        thread(serveConnection, fd).detach();
+    }
+}
@@ -0,0 +1,195 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*  indexbench - Measures full-sync indexing throughput. Indexes a blocks directory
+    (e.g. one written by blockgen) into an empty index with BlockFileWatcher::updateIndex,
+    the same code path the indexer runs, and reports blocks/s, tx/s and bytes/s.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+#include <iomanip>
+#include <stdlib.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include "leveldb/db.h"
+#include "leveldb/cache.h"
+#include "leveldb/filter_policy.h"
+#include "../src/blockfilewatcher.h"
+#include "../src/mempoolmonitor.h"
+#include "../src/scriptsolver.h"
+#include "../src/coinparams.h"
+#include "../src/json.hpp"
+#include "../src/cxxopts.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    // Opens the index with the same options the indexer uses
+    shared_ptr<leveldb::DB> openDatabase(const string& indexDir, size_t cacheSize) {
+        leveldb::DB* db;
+        leveldb::Options options;
+        options.create_if_missing = true;
+        options.block_cache = leveldb::NewLRUCache(cacheSize);
+        options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+        leveldb::Status status = leveldb::DB::Open(options, indexDir, &db);
+        if(!status.ok()) {
+            cerr << "Could not open index in " << indexDir << ": " << status.ToString() << endl;
+            exit(1);
+        }
+        return shared_ptr<leveldb::DB>(db);
+    }
+
+    // Total size of the blk????.dat files, the bytes the indexer has to scan
+    uint64_t blockFileBytes(const string& blocksDir) {
+        uint64_t bytes = 0;
+        DIR* dir = opendir(blocksDir.c_str());
+        if(dir == NULL) return 0;
+        dirent* ent;
+        while((ent = readdir(dir)) != NULL) {
+            string fileName = ent->d_name;
+            struct stat result;
+            if(fileName.compare(0, 3, "blk") == 0 && stat((blocksDir + "/" + fileName).c_str(), &result) == 0) {
+                bytes += result.st_size;
+            }
+        }
+        closedir(dir);
+        return bytes;
+    }
+
+    // Number of indexed blocks and transactions
+    void countIndexed(const shared_ptr<leveldb::DB>& db, uint64_t& blocks, uint64_t& transactions) {
+        string highestBlock;
+        blocks = db->Get(leveldb::ReadOptions(), "highestblock", &highestBlock).ok() ? stoull(highestBlock) + 1 : 0;
+
+        transactions = 0;
+        const string prefix = "tx-filePosition-";
+        unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+        for(it->Seek(prefix); it->Valid() && it->key().ToString().compare(0, prefix.size(), prefix) == 0; it->Next()) {
+            transactions++;
+        }
+    }
+
+    int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+        return remove(path);
+    }
+
+    json measure(const string& name, double seconds, uint64_t blocks, uint64_t transactions, uint64_t bytes) {
+        cout << name << ": " << seconds << " s, " << (uint64_t)(blocks / seconds) << " blocks/s, " << (uint64_t)(transactions / seconds) 
+             << " tx/s, " << (uint64_t)(bytes / seconds / 1024 / 1024) << " MiB/s" << endl;
+
+        json j;
+        j["seconds"] = seconds;
+        j["blocksPerSecond"] = blocks / seconds;
+        j["transactionsPerSecond"] = transactions / seconds;
+        j["bytesPerSecond"] = bytes / seconds;
+        return j;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("indexbench", "Indexing throughput benchmark");
+    options.add_options()
+    ("coinParams", "Coin parameters file", cxxopts::value<std::string>()->default_value("coins/vertcoin-mainnet.json"))
+    ("blocksDir", "Directory with the block files to index", cxxopts::value<std::string>())
+    ("indexDir", "Directory for the index, should be empty [Default: a temporary directory that is removed afterwards]", cxxopts::value<std::string>()->default_value(""))
+    ("cacheSize", "LevelDB block cache in MiB [Default: 300]", cxxopts::value<size_t>()->default_value("300"))
+    ("rescan", "Also time a second update over the complete index (all blocks already indexed)")
+    ("output", "File to write the results to as JSON", cxxopts::value<std::string>()->default_value(""))
+    ;
+    options.parse(argc, argv);
+
+    if(options.count("blocksDir") == 0) {
+        cerr << "Blocks directory not specified. Exiting." << endl;
+        return 1;
+    }
+    string blocksDir = options["blocksDir"].as<string>();
+    VtcBlockIndexer::CoinParams::readFromFile(options["coinParams"].as<string>());
+
+    string indexDir = options["indexDir"].as<string>();
+    bool temporaryIndex = indexDir.empty();
+    if(temporaryIndex) {
+        char indexTemplate[] = "/tmp/indexbench-XXXXXX";
+        if(mkdtemp(indexTemplate) == NULL) {
+            cerr << "Could not create a temporary index directory" << endl;
+            return 1;
+        }
+        indexDir = indexTemplate;
+    }
+
+    // The mempool monitor is not started, but its RPC client needs a host to be constructed
+    setenv("COIND_HOST", "127.0.0.1", 0);
+
+    json results;
+    uint64_t blocks, transactions;
+    uint64_t bytes = blockFileBytes(blocksDir);
+    {
+        shared_ptr<leveldb::DB> db = openDatabase(indexDir, options["cacheSize"].as<size_t>() * 1024 * 1024);
+        shared_ptr<VtcBlockIndexer::MempoolMonitor> mempoolMonitor = make_shared<VtcBlockIndexer::MempoolMonitor>(db);
+        VtcBlockIndexer::BlockFileWatcher blockFileWatcher(blocksDir, db, mempoolMonitor);
+
+        auto start = chrono::steady_clock::now();
+        blockFileWatcher.updateIndex();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        countIndexed(db, blocks, transactions);
+        cout << "Indexed " << blocks << " blocks, " << transactions << " transactions from " << bytes << " bytes of block files" << endl;
+        results["initial"] = measure("Initial sync", seconds, blocks, transactions, bytes);
+
+        // Where the time of the initial sync went, per pipeline stage
+        json stages;
+        cout << "Stages:";
+        for(const auto& stage : VtcBlockIndexer::BlockIndexer::telemetry.getStages()) {
+            stages[stage.first] = { { "count", stage.second.count }, { "seconds", stage.second.sum } };
+            cout << " " << stage.first << " " << fixed << setprecision(2) << stage.second.sum << "s";
+        }
+        cout << endl;
+        results["initial"]["stages"] = stages;
+
+        if(options.count("rescan") > 0) {
+            start = chrono::steady_clock::now();
+            blockFileWatcher.updateIndex();
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            results["rescan"] = measure("Rescan", seconds, blocks, transactions, bytes);
+        }
+    }
+
+    results["blocks"] = blocks;
+    results["transactions"] = transactions;
+    results["bytes"] = bytes;
+    results["pubKeyCacheHitRate"] = VtcBlockIndexer::ScriptSolver::pubKeyCache.getHitRate();
+
+    if(temporaryIndex) {
+        nftw(indexDir.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    string outputFile = options["output"].as<string>();
+    if(!outputFile.empty()) {
+        ofstream o(outputFile);
+        o << results.dump(2) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,343 @@
+/*  VTC Blockindexer - A utility to build additional indexes to the 
+    Vertcoin blockchain by scanning and indexing the blockfiles
+    downloaded by Vertcoin Core.
+    
+    Copyright (C) 2017  Gert-Jaap Glasbergen
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*  loadgen - Replays wallet traffic against the indexer's HTTP API and reports the
+    throughput and latency percentiles per endpoint.
+
+    Requests are made from a number of concurrent clients for a fixed duration. 
+    The addresses and outpoints come from a workload file (written by blockgen 
+    --workload, or by hand: {"height": n, "addresses": [...], "outpoints": 
+    [{"txid": ..., "vout": ...}]}). Run the indexer against fakecoind to test 
+    without a node.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "../src/json.hpp"
+#include "../src/cxxopts.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace {
+    enum Endpoint { Balance, Txos, TxosSince, OutpointSpends, EndpointCount };
+    const char* endpointNames[] = { "balance", "txos", "txosSince", "outpointSpends" };
+
+    struct Workload {
+        long long height;
+        vector<string> addresses;
+        vector<pair<string, uint32_t>> outpoints;
+    };
+
+    struct Request {
+        string method;
+        string path;
+        string body;
+    };
+
+    /** Latencies and failures of one endpoint, per client thread */
+    struct Stats {
+        vector<double> latenciesMs;
+        uint64_t errors = 0;
+        uint64_t bytes = 0;
+    };
+
+    struct Settings {
+        string host;
+        string port;
+        size_t batchSize;
+        bool unconfirmed;
+        double mix[EndpointCount];
+    };
+
+    /** Sends the request on a new connection and reads the response until the server
+     * closes it (or Content-Length bytes were read). Returns false on a connection 
+     * error, status is set to the HTTP status otherwise. */
+    bool httpRequest(const Settings& settings, const Request& request, int& status, size_t& bytes) {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses;
+        if(getaddrinfo(settings.host.c_str(), settings.port.c_str(), &hints, &addresses) != 0) return false;
+
+        int fd = -1;
+        for(addrinfo* address = addresses; address != NULL; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if(fd < 0) continue;
+            if(connect(fd, address->ai_addr, address->ai_addrlen) == 0) break;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addresses);
+        if(fd < 0) return false;
+
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        stringstream message;
+        message << request.method << " " << request.path << " HTTP/1.1\r\n"
+                << "Host: " << settings.host << ":" << settings.port << "\r\n"
+                << "Connection: close\r\n";
+        if(!request.body.empty()) {
+            message << "Content-Type: application/json\r\n"
+                    << "Content-Length: " << request.body.size() << "\r\n";
+        }
+        message << "\r\n" << request.body;
+        string data = message.str();
+        for(size_t sent = 0; sent < data.size();) {
+            ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if(result <= 0) {
+                close(fd);
+                return false;
+            }
+            sent += result;
+        }
+
+        string response;
+        char buffer[16384];
+        size_t expectedSize = string::npos;
+        while(response.size() < expectedSize) {
+            ssize_t result = recv(fd, buffer, sizeof(buffer), 0);
+            if(result <= 0) break;
+            response.append(buffer, result);
+
+            if(expectedSize == string::npos) {
+                size_t headerEnd = response.find("\r\n\r\n");
+                if(headerEnd != string::npos) {
+                    size_t contentLength = response.find("Content-Length: ");
+                    if(contentLength != string::npos && contentLength < headerEnd) {
+                        expectedSize = headerEnd + 4 + stoull(response.substr(contentLength + 16));
+                    }
+                }
+            }
+        }
+        close(fd);
+
+        if(response.compare(0, 5, "HTTP/") != 0 || response.find(' ') == string::npos) return false;
+        status = atoi(response.c_str() + response.find(' ') + 1);
+        bytes = response.size();
+        return true;
+    }
+
+    Request makeRequest(Endpoint endpoint, const Workload& workload, const Settings& settings, mt19937_64& rng) {
+        Request request;
+        const string& address = workload.addresses[rng() % workload.addresses.size()];
+        string query = settings.unconfirmed ? "?unconfirmed=1" : "";
+        switch(endpoint) {
+            case Balance:
+                request = { "GET", "/addressBalance/" + address + query, "" };
+                break;
+            case Txos:
+                request = { "GET", "/addressTxos/" + address + query, "" };
+                break;
+            case TxosSince: {
+                // Wallets ask for what changed since the last block they have seen
+                long long sinceBlock = max<long long>(0, workload.height - (long long)(rng() % 100));
+                request = { "GET", "/addressTxosSince/" + to_string(sinceBlock) + "/" + address + query, "" };
+                break;
+            }
+            default: {
+                json outpoints = json::array();
+                for(size_t i = 0; i < settings.batchSize; i++) {
+                    const auto& outpoint = workload.outpoints[rng() % workload.outpoints.size()];
+                    outpoints.push_back({ { "txid", outpoint.first }, { "vout", outpoint.second } });
+                }
+                request = { "POST", "/outpointSpends" + query, outpoints.dump() };
+                break;
+            }
+        }
+        return request;
+    }
+
+    void runClient(const Workload& workload, const Settings& settings, uint64_t seed, chrono::steady_clock::time_point measureFrom, chrono::steady_clock::time_point until, vector<Stats>& stats) {
+        mt19937_64 rng(seed);
+        discrete_distribution<int> endpoints(settings.mix, settings.mix + EndpointCount);
+        stats.assign(EndpointCount, Stats());
+
+        while(chrono::steady_clock::now() < until) {
+            Endpoint endpoint = (Endpoint)endpoints(rng);
+            Request request = makeRequest(endpoint, workload, settings, rng);
+
+            auto start = chrono::steady_clock::now();
+            int status = 0;
+            size_t bytes = 0;
+            bool ok = httpRequest(settings, request, status, bytes);
+            auto end = chrono::steady_clock::now();
+            if(start < measureFrom) continue;
+
+            Stats& endpointStats = stats[endpoint];
+            if(!ok || status < 200 || status >= 300) {
+                endpointStats.errors++;
+                if(!ok) this_thread::sleep_for(chrono::milliseconds(10));
+                continue;
+            }
+            endpointStats.latenciesMs.push_back(chrono::duration<double, milli>(end - start).count());
+            endpointStats.bytes += bytes;
+        }
+    }
+
+    double percentile(const vector<double>& sorted, double fraction) {
+        if(sorted.empty()) return 0;
+        size_t index = min(sorted.size() - 1, (size_t)(fraction * sorted.size()));
+        return sorted[index];
+    }
+
+    bool parseMix(const string& mix, double weights[EndpointCount]) {
+        fill(weights, weights + EndpointCount, 0.0);
+        stringstream ss(mix);
+        string item;
+        while(getline(ss, item, ',')) {
+            size_t equals = item.find('=');
+            if(equals == string::npos) return false;
+            auto endpoint = find(endpointNames, endpointNames + EndpointCount, item.substr(0, equals));
+            if(endpoint == endpointNames + EndpointCount) return false;
+            weights[endpoint - endpointNames] = stod(item.substr(equals + 1));
+        }
+        return any_of(weights, weights + EndpointCount, [](double weight) { return weight > 0; });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    cxxopts::Options options("loadgen", "HTTP API load generator");
+    options.add_options()
+    ("host", "Indexer host [Default: 127.0.0.1]", cxxopts::value<std::string>()->default_value("127.0.0.1"))
+    ("port", "Indexer port [Default: 8888]", cxxopts::value<std::string>()->default_value("8888"))
+    ("workload", "JSON file with the height, addresses and outpoints to query", cxxopts::value<std::string>())
+    ("clients", "Number of concurrent clients [Default: 8]", cxxopts::value<size_t>()->default_value("8"))
+    ("duration", "Seconds to measure [Default: 10]", cxxopts::value<double>()->default_value("10"))
+    ("warmup", "Seconds of requests before measuring [Default: 1]", cxxopts::value<double>()->default_value("1"))
+    ("mix", "Relative weights of the endpoints [Default: balance=40,txos=10,txosSince=30,outpointSpends=20]", cxxopts::value<std::string>()->default_value("balance=40,txos=10,txosSince=30,outpointSpends=20"))
+    ("batchSize", "Outpoints per outpointSpends request [Default: 20]", cxxopts::value<size_t>()->default_value("20"))
+    ("unconfirmed", "Include the mempool in the queries (unconfirmed=1)")
+    ("seed", "Seed of the random generator [Default: 1]", cxxopts::value<uint64_t>()->default_value("1"))
+    ("output", "File to write the results to as JSON", cxxopts::value<std::string>()->default_value(""))
+    ;
+    options.parse(argc, argv);
+
+    if(options.count("workload") == 0) {
+        cerr << "Workload file not specified. Exiting." << endl;
+        return 1;
+    }
+
+    Workload workload;
+    {
+        ifstream i(options["workload"].as<string>());
+        json j;
+        try {
+            i >> j;
+            workload.height = j["height"].get<long long>();
+            workload.addresses = j["addresses"].get<vector<string>>();
+            for(const json& outpoint : j["outpoints"]) {
+                workload.outpoints.push_back({ outpoint["txid"].get<string>(), outpoint["vout"].get<uint32_t>() });
+            }
+        } catch(const exception& e) {
+            cerr << "Could not read workload " << options["workload"].as<string>() << ": " << e.what() << endl;
+            return 1;
+        }
+    }
+    if(workload.addresses.empty() || workload.outpoints.empty()) {
+        cerr << "The workload needs at least one address and one outpoint" << endl;
+        return 1;
+    }
+
+    Settings settings;
+    settings.host = options["host"].as<string>();
+    settings.port = options["port"].as<string>();
+    settings.batchSize = max<size_t>(options["batchSize"].as<size_t>(), 1);
+    settings.unconfirmed = options.count("unconfirmed") > 0;
+    if(!parseMix(options["mix"].as<string>(), settings.mix)) {
+        cerr << "Invalid mix, expected e.g. balance=40,txos=10,txosSince=30,outpointSpends=20" << endl;
+        return 1;
+    }
+
+    size_t clients = max<size_t>(options["clients"].as<size_t>(), 1);
+    double duration = options["duration"].as<double>();
+    auto measureFrom = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(options["warmup"].as<double>()));
+    auto until = measureFrom + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(duration));
+
+    vector<vector<Stats>> clientStats(clients);
+    vector<thread> threads;
+    for(size_t i = 0; i < clients; i++) {
+        threads.emplace_back(runClient, cref(workload), cref(settings), options["seed"].as<uint64_t>() + i, measureFrom, until, ref(clientStats[i]));
+    }
+    for(thread& t : threads) t.join();
+
+    json results;
+    uint64_t totalRequests = 0;
+    cout << left << setw(16) << "endpoint" << right << setw(10) << "req/s" << setw(9) << "errors" 
+         << setw(10) << "p50 ms" << setw(10) << "p90 ms" << setw(10) << "p99 ms" << setw(10) << "p99.9 ms" << setw(10) << "max ms" << endl;
+    for(int endpoint = 0; endpoint < EndpointCount; endpoint++) {
+        Stats merged;
+        for(const vector<Stats>& stats : clientStats) {
+            merged.latenciesMs.insert(merged.latenciesMs.end(), stats[endpoint].latenciesMs.begin(), stats[endpoint].latenciesMs.end());
+            merged.errors += stats[endpoint].errors;
+            merged.bytes += stats[endpoint].bytes;
+        }
+        if(merged.latenciesMs.empty() && merged.errors == 0) continue;
+        sort(merged.latenciesMs.begin(), merged.latenciesMs.end());
+        totalRequests += merged.latenciesMs.size();
+
+        json j;
+        j["requests"] = merged.latenciesMs.size();
+        j["errors"] = merged.errors;
+        j["requestsPerSecond"] = merged.latenciesMs.size() / duration;
+        j["bytesPerSecond"] = merged.bytes / duration;
+        j["latencyMs"] = {
+            { "mean", merged.latenciesMs.empty() ? 0 : accumulate(merged.latenciesMs.begin(), merged.latenciesMs.end(), 0.0) / merged.latenciesMs.size() },
+            { "p50", percentile(merged.latenciesMs, 0.5) },
+            { "p90", percentile(merged.latenciesMs, 0.9) },
+            { "p99", percentile(merged.latenciesMs, 0.99) },
+            { "p999", percentile(merged.latenciesMs, 0.999) },
+            { "max", merged.latenciesMs.empty() ? 0 : merged.latenciesMs.back() }
+        };
+        results["endpoints"][endpointNames[endpoint]] = j;
+
+        cout << left << setw(16) << endpointNames[endpoint] << right << fixed << setprecision(1) << setw(10) << (merged.latenciesMs.size() / duration) 
+             << setw(9) << merged.errors << setprecision(2) << setw(10) << percentile(merged.latenciesMs, 0.5) << setw(10) << percentile(merged.latenciesMs, 0.9) 
+             << setw(10) << percentile(merged.latenciesMs, 0.99) << setw(10) << percentile(merged.latenciesMs, 0.999) << setw(10) << j["latencyMs"]["max"].get<double>() << endl;
+    }
+    results["clients"] = clients;
+    results["duration"] = duration;
+    results["requestsPerSecond"] = totalRequests / duration;
+    cout << "Total: " << fixed << setprecision(1) << (totalRequests / duration) << " requests/s with " << clients << " clients" << endl;
+
+    string outputFile = options["output"].as<string>();
+    if(!outputFile.empty()) {
+        ofstream o(outputFile);
+        o << results.dump(2) << endl;
+    }
+    return 0;
+}